@@ -0,0 +1,440 @@
+using namespace std;
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "ElementNames.hh"
+#include "MacroCreator.hh"
+#include "StringPool.hh"
+#include "SyntheticGeometry.hh"
+
+// DoppBroadBench
+// regression benchmark for the conversion, synthetic corpora holding a fixed total number of materials are converted one phase at a
+// time and the geometries per second, megabytes of geometry per second and peak resident memory of each phase are recorded
+// the results are compared against a stored baseline and the run fails when a phase got slower or bigger than the threshold allows
+
+// the version of the baseline file layout, baselines of another version are not compared against
+const int baselineVersion = 1;
+
+// the phases of a conversion in the order that they are run on each geometry
+enum BenchPhase {readPhase=0, cropPhase, resolvePhase, writePhase, numPhases};
+static const char *phaseNames[numPhases] = {"read", "crop", "resolve", "write"};
+
+// the measurements of one phase over a whole corpus
+struct PhaseResult
+{
+    long size;
+    string phase;
+    double seconds, filesPerSec, mbPerSec;
+    long peakRss;
+};
+
+// the settings of a benchmark run, results are only compared against a baseline made with the same corpus settings
+struct BenchOptions
+{
+    string workDirName, baselineName;
+    std::vector<long> sizes;
+    int materialsPerGeometry;
+    unsigned int seed;
+    // the percentage that a phase may be slower or use more memory than in the baseline
+    double threshold;
+    // phases that took less time than this in the baseline are too noisy to compare their speed
+    double minSeconds;
+    bool save;
+};
+
+bool ParseOptions(int argc, char **argv, BenchOptions &options);
+bool RunSize(const BenchOptions &options, long size, std::vector<PhaseResult> &results);
+bool ResetPeakRss();
+long ReadPeakRss();
+bool WriteBaseline(string fileName, const BenchOptions &options, const std::vector<PhaseResult> &results);
+int ReadBaseline(string fileName, const BenchOptions &options, std::vector<PhaseResult> &results);
+int CompareBaseline(const BenchOptions &options, const std::vector<PhaseResult> &results, const std::vector<PhaseResult> &baseline);
+void PrintResults(const std::vector<PhaseResult> &results);
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    std::vector<PhaseResult> results, baseline;
+    int status=0;
+
+    if(!ParseOptions(argc, argv, options))
+    {
+        cout << "\nusage: " << argv[0] << " <work directory> [--sizes=1000,10000,100000] [--materials=50] [--seed=1]\n"
+             << "                 [--baseline=<file>] [--threshold=10] [--min-seconds=0.5] [--save]\n\n"
+             << "converts synthetic corpora with the given total numbers of materials, split into geometries of --materials materials,\n"
+             << "and measures each phase of the conversion, the results are compared against the baseline file and the exit status is 1\n"
+             << "if a phase got more than --threshold percent slower or bigger, the results are stored as the baseline when there is\n"
+             << "none yet or when --save is given\n" << endl;
+        return 2;
+    }
+
+    ElementNames elementNames;
+    elementNames.SetElementNames();
+
+    mkdir(options.workDirName.c_str(), 0755);
+    for(int i=0; i<int(options.sizes.size()); i++)
+    {
+        if(!RunSize(options, options.sizes[i], results))
+        {
+            status=2;
+            break;
+        }
+    }
+
+    if(status==0)
+    {
+        PrintResults(results);
+
+        if(options.baselineName!="")
+        {
+            status = options.save ? 3 : ReadBaseline(options.baselineName, options, baseline);
+            if(status==0)
+            {
+                status = CompareBaseline(options, results, baseline);
+            }
+            else if(status==3)
+            {
+                // there is nothing to compare against yet
+                status=0;
+                if(WriteBaseline(options.baselineName, options, results))
+                {
+                    cout << "\nStored the results as the baseline " << options.baselineName << endl;
+                }
+                else
+                {
+                    cout << "\nError: could not write the baseline " << options.baselineName << endl;
+                    status=2;
+                }
+            }
+        }
+    }
+
+    elementNames.ClearStore();
+    StringPool::ClearStore();
+    return status;
+}
+
+//ParseOptions
+//reads the work directory and the options from the command line, returns false if they are incomplete
+bool ParseOptions(int argc, char **argv, BenchOptions &options)
+{
+    string arg;
+
+    options.materialsPerGeometry=50;
+    options.seed=1;
+    options.threshold=10.;
+    options.minSeconds=0.5;
+    options.save=false;
+
+    for(int i=1; i<argc; i++)
+    {
+        arg = argv[i];
+        if(arg.substr(0,8)=="--sizes=")
+        {
+            std::stringstream list(arg.substr(8));
+            string item;
+            while(getline(list, item, ','))
+            {
+                if(atol(item.c_str())>0)
+                    options.sizes.push_back(atol(item.c_str()));
+            }
+        }
+        else if(arg.substr(0,12)=="--materials=")
+        {
+            options.materialsPerGeometry = atoi(arg.substr(12).c_str());
+        }
+        else if(arg.substr(0,7)=="--seed=")
+        {
+            options.seed = strtoul(arg.substr(7).c_str(), NULL, 10);
+        }
+        else if(arg.substr(0,11)=="--baseline=")
+        {
+            options.baselineName = arg.substr(11);
+        }
+        else if(arg.substr(0,12)=="--threshold=")
+        {
+            options.threshold = atof(arg.substr(12).c_str());
+        }
+        else if(arg.substr(0,14)=="--min-seconds=")
+        {
+            options.minSeconds = atof(arg.substr(14).c_str());
+        }
+        else if(arg=="--save")
+        {
+            options.save=true;
+        }
+        else if((arg.substr(0,2)!="--")&&(options.workDirName==""))
+        {
+            options.workDirName = arg;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if(options.sizes.empty())
+    {
+        options.sizes.push_back(1000);
+        options.sizes.push_back(10000);
+        options.sizes.push_back(100000);
+    }
+    if((options.workDirName!="")&&(options.workDirName[options.workDirName.length()-1]!='/'))
+        options.workDirName+='/';
+
+    return ((options.workDirName!="")&&(options.materialsPerGeometry>0)&&(options.threshold>=0.));
+}
+
+//RunSize
+//generates the corpus with the given total number of materials and converts it, the time of every phase is summed over the
+//geometries and its peak memory is the largest peak of any of them
+bool RunSize(const BenchOptions &options, long size, std::vector<PhaseResult> &results)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::stringstream dirName;
+    dirName << options.workDirName << "corpus-" << size << "-" << options.materialsPerGeometry << "-" << options.seed << "/";
+    string outDirName = dirName.str()+"macros/";
+    long numGeometries = (size+options.materialsPerGeometry-1)/options.materialsPerGeometry;
+
+    SyntheticGeometry generator(options.seed);
+    mkdir(dirName.str().c_str(), 0755);
+    mkdir(outDirName.c_str(), 0755);
+
+    double seconds[numPhases] = {0., 0., 0., 0.};
+    long peakRss[numPhases] = {0, 0, 0, 0};
+    double numBytes=0.;
+    bool resetWorks = ResetPeakRss();
+    std::ofstream nullOut("/dev/null");
+
+    cout << "\nConverting " << numGeometries << " geometries with " << options.materialsPerGeometry << " materials each ("
+         << size << " materials)" << endl;
+
+    for(long i=0; i<numGeometries; i++)
+    {
+        std::stringstream className;
+        className << "Synth" << i << "Constructor";
+        string sourceName = dirName.str()+className.str()+".cc", headerName = dirName.str()+className.str()+".hh";
+
+        // the last geometry only gets the materials that are left over
+        int numMaterials = int(std::min(long(options.materialsPerGeometry), size-i*options.materialsPerGeometry));
+        if(!generator.WriteFiles(dirName.str(), className.str(), numMaterials))
+        {
+            cout << "\nError: couldn't write " << className.str() << " to " << dirName.str() << endl;
+            return false;
+        }
+
+        std::stringstream streamS, streamH, original;
+        IsotopeTable isoTable;
+        Clock::time_point start[numPhases+1];
+
+        // the messages the parser prints about the geometry would swamp the results
+        std::streambuf *coutBuf = cout.rdbuf(nullOut.rdbuf());
+
+        for(int phase=0; phase<numPhases; phase++)
+        {
+            if(resetWorks)
+                ResetPeakRss();
+            start[phase] = Clock::now();
+
+            switch(phase)
+            {
+                case readPhase:
+                    GetDataStream(sourceName, streamS);
+                    GetDataStream(headerName, streamH);
+                    numBytes += double(streamS.str().length()+streamH.str().length());
+                    break;
+                case cropPhase:
+                    CropMaterialSection(streamS, streamH, original);
+                    break;
+                case resolvePhase:
+                    ResolveIsotopes(streamS, original, isoTable);
+                    break;
+                default:
+                    streamS.str("");
+                    streamS.clear();
+                    WriteMacroData(streamS, isoTable);
+                    SetDataStream(CreateMacroName(sourceName, outDirName), streamS);
+                    break;
+            }
+
+            start[phase+1] = Clock::now();
+            seconds[phase] += std::chrono::duration<double>(start[phase+1]-start[phase]).count();
+            peakRss[phase] = std::max(peakRss[phase], ReadPeakRss());
+        }
+        cout.rdbuf(coutBuf);
+    }
+
+    for(int phase=0; phase<numPhases; phase++)
+    {
+        PhaseResult result;
+        result.size = size;
+        result.phase = phaseNames[phase];
+        result.seconds = seconds[phase];
+        result.filesPerSec = (seconds[phase]>0.) ? numGeometries/seconds[phase] : 0.;
+        result.mbPerSec = (seconds[phase]>0.) ? numBytes/1.0e6/seconds[phase] : 0.;
+        result.peakRss = peakRss[phase];
+        results.push_back(result);
+    }
+
+    if(!resetWorks)
+        cout << "the peak memory can't be reset on this system, every phase shows the peak of the whole run so far" << endl;
+    return true;
+}
+
+//ResetPeakRss
+//resets the peak resident memory of the process to its current size so that the peak of the next phase can be measured on its own
+bool ResetPeakRss()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if(!clearRefs.good())
+        return false;
+    clearRefs << "5";
+    clearRefs.close();
+    return !clearRefs.fail();
+}
+
+//ReadPeakRss
+//returns the peak resident memory of the process in kB since it started or since the last call to ResetPeakRss()
+long ReadPeakRss()
+{
+    std::ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line))
+    {
+        if(line.substr(0,6)=="VmHWM:")
+            return atol(line.c_str()+6);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return long(usage.ru_maxrss);
+}
+
+void PrintResults(const std::vector<PhaseResult> &results)
+{
+    cout << "\n" << std::setw(10) << "materials" << std::setw(10) << "phase" << std::setw(12) << "seconds" << std::setw(12) << "files/s"
+         << std::setw(12) << "MB/s" << std::setw(14) << "peak RSS kB" << endl;
+    for(int i=0; i<int(results.size()); i++)
+    {
+        cout << std::setw(10) << results[i].size << std::setw(10) << results[i].phase << std::fixed << std::setprecision(3)
+             << std::setw(12) << results[i].seconds << std::setw(12) << results[i].filesPerSec << std::setw(12) << results[i].mbPerSec
+             << std::setw(14) << results[i].peakRss << endl;
+    }
+    cout.unsetf(std::ios::fixed);
+}
+
+//WriteBaseline
+//the baseline is a text file that starts with its version and the corpus settings followed by one line for each size and phase
+bool WriteBaseline(string fileName, const BenchOptions &options, const std::vector<PhaseResult> &results)
+{
+    std::ofstream out(fileName.c_str(), std::ios::out | std::ios::trunc);
+    if(!out.good())
+        return false;
+
+    out << "DoppBroadBench baseline " << baselineVersion << "\n"
+        << "materials " << options.materialsPerGeometry << "\n"
+        << "seed " << options.seed << "\n"
+        << "# materials phase seconds files/s MB/s peakRSSkB\n";
+    out << std::setprecision(10);
+    for(int i=0; i<int(results.size()); i++)
+    {
+        out << results[i].size << ' ' << results[i].phase << ' ' << results[i].seconds << ' ' << results[i].filesPerSec << ' '
+            << results[i].mbPerSec << ' ' << results[i].peakRss << '\n';
+    }
+    out.close();
+    return !out.fail();
+}
+
+//ReadBaseline
+//returns 0 when the baseline was read, 3 when there is no baseline file and 2 when it can't be compared against
+int ReadBaseline(string fileName, const BenchOptions &options, std::vector<PhaseResult> &results)
+{
+    std::ifstream in(fileName.c_str());
+    string magic, word, line;
+    int version=0, materials=0;
+    unsigned int seed=0;
+
+    if(!in.good())
+        return 3;
+
+    if(!(in >> magic >> word >> version)||(magic!="DoppBroadBench")||(word!="baseline"))
+    {
+        cout << "\nError: " << fileName << " is not a benchmark baseline" << endl;
+        return 2;
+    }
+    if(version!=baselineVersion)
+    {
+        cout << "\nError: the baseline " << fileName << " is version " << version << ", this benchmark writes version " << baselineVersion
+             << ", store a new baseline with --save" << endl;
+        return 2;
+    }
+    in >> word >> materials >> word >> seed;
+    if((materials!=options.materialsPerGeometry)||(seed!=options.seed))
+    {
+        cout << "\nError: the baseline was made with " << materials << " materials per geometry and seed " << seed
+             << ", it can't be compared against this run" << endl;
+        return 2;
+    }
+
+    while(getline(in, line))
+    {
+        PhaseResult result;
+        std::stringstream fields(line);
+        if(line.empty()||(line[0]=='#'))
+            continue;
+        if(fields >> result.size >> result.phase >> result.seconds >> result.filesPerSec >> result.mbPerSec >> result.peakRss)
+            results.push_back(result);
+    }
+    return 0;
+}
+
+//CompareBaseline
+//checks every phase that is in the baseline as well, returns 1 if any of them regressed by more than the threshold
+int CompareBaseline(const BenchOptions &options, const std::vector<PhaseResult> &results, const std::vector<PhaseResult> &baseline)
+{
+    int numRegressed=0, numCompared=0;
+    double limit = options.threshold/100.;
+
+    cout << "\nCompared against " << options.baselineName << " with a threshold of " << options.threshold << "%" << endl;
+    for(int i=0; i<int(results.size()); i++)
+    {
+        for(int j=0; j<int(baseline.size()); j++)
+        {
+            if((baseline[j].size!=results[i].size)||(baseline[j].phase!=results[i].phase))
+                continue;
+
+            numCompared++;
+            if((baseline[j].seconds>=options.minSeconds)&&(results[i].filesPerSec<baseline[j].filesPerSec*(1.-limit)))
+            {
+                cout << "  " << results[i].size << " " << results[i].phase << ": throughput fell from " << baseline[j].filesPerSec
+                     << " to " << results[i].filesPerSec << " files/s" << endl;
+                numRegressed++;
+            }
+            if(results[i].peakRss>baseline[j].peakRss*(1.+limit))
+            {
+                cout << "  " << results[i].size << " " << results[i].phase << ": peak memory grew from " << baseline[j].peakRss
+                     << " to " << results[i].peakRss << " kB" << endl;
+                numRegressed++;
+            }
+        }
+    }
+
+    if(numRegressed>0)
+    {
+        cout << "\n" << numRegressed << " regressions found" << endl;
+        return 1;
+    }
+    cout << "\nNo regressions in the " << numCompared << " phases compared" << endl;
+    return 0;
+}
@@ -0,0 +1,683 @@
+using namespace std;
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "ElementNames.hh"
+#include "MacroCreator.hh"
+#include "StringPool.hh"
+#include "SyntheticGeometry.hh"
+#include "StatementIndex.hh"
+
+// DoppBroadDiffHarness
+// differential tester for the isotope extraction, every registered engine is run on the same geometry and the isotope names and
+// temperatures that they produce are compared against the legacy free-function path (and against stored reference lists)
+// mismatching inputs are shrunk line by line and the minimized source/header pair is kept in the corpus so that it can be replayed
+
+// the isotope list produced by one engine for one geometry
+struct IsoResult
+{
+    std::vector<string> isoNameList;
+    std::vector<double> isoTempVec;
+    bool finished;
+};
+
+typedef void (*IsoEngine)(std::stringstream&, std::stringstream&, std::vector<string>&, std::vector<double>&);
+
+struct EngineEntry
+{
+    const char *name;
+    IsoEngine run;
+};
+
+void RunLegacyEngine(std::stringstream& streamS, std::stringstream& streamH, std::vector<string> &isoNameList, std::vector<double> &isoTempVec);
+void RunStreamingEngine(std::stringstream& streamS, std::stringstream& streamH, std::vector<string> &isoNameList, std::vector<double> &isoTempVec);
+void RunParallelEngine(std::stringstream& streamS, std::stringstream& streamH, std::vector<string> &isoNameList, std::vector<double> &isoTempVec);
+
+// the first entry is the reference that every other engine is compared against, new parser implementations are added below it
+static const EngineEntry engines[] =
+{
+    {"legacy", RunLegacyEngine},
+    {"streaming", RunStreamingEngine},
+    {"parallel", RunParallelEngine}
+};
+
+static const int numEngines = int(sizeof(engines)/sizeof(EngineEntry));
+
+// the number of seconds an engine is given to process one geometry before it is treated as hung
+const int engineTimeLimit = 10;
+
+bool RunIsolated(const EngineEntry &engine, const string &source, const string &header, IsoResult &result);
+int CompareResults(const IsoResult &ref, const IsoResult &test);
+bool FindMismatch(const string &source, const string &header, string &report);
+void MinimizeInput(std::vector<string> &lines, const string &header);
+void MutateSource(std::vector<string> &lines, std::mt19937 &rng);
+void SplitLines(const string &text, std::vector<string> &lines);
+string JoinLines(const std::vector<string> &lines);
+void FindGeoPairs(string dirName, std::vector<string> &baseNames);
+bool ReadFile(string fileName, string &data);
+bool WriteFile(string fileName, const string &data);
+void WriteIsoList(string fileName, const IsoResult &result);
+bool ReadIsoList(string fileName, IsoResult &result);
+void SaveReproducer(string dirName, string baseName, const std::vector<string> &lines, const string &header, const string &report);
+
+int GenerateCorpus(int argc, char **argv);
+int RecordCorpus(int argc, char **argv);
+int DiffCorpus(int argc, char **argv);
+int FuzzEngines(int argc, char **argv);
+
+#ifndef DOPPBROAD_LIBFUZZER
+
+int main(int argc, char **argv)
+{
+    ElementNames elementNames;
+    elementNames.SetElementNames();
+    int status=2;
+    string mode = (argc>1) ? argv[1] : "";
+
+    if(mode=="generate")
+        status=GenerateCorpus(argc, argv);
+    else if(mode=="record")
+        status=RecordCorpus(argc, argv);
+    else if(mode=="diff")
+        status=DiffCorpus(argc, argv);
+    else if(mode=="fuzz")
+        status=FuzzEngines(argc, argv);
+
+    if(status==2)
+    {
+        cout << "\nusage: " << argv[0] << " generate <corpus directory> <# of geometries> <# of materials> [seed]\n"
+             << "       " << argv[0] << " record <corpus directory>\n"
+             << "       " << argv[0] << " diff <corpus directory>\n"
+             << "       " << argv[0] << " fuzz <corpus directory> <# of iterations> [seed]\n\n"
+             << "record stores the legacy isotope list of every source/header pair (name.cc, name.hh) in the directory as name.iso,\n"
+             << "diff compares every engine against the stored lists and against the legacy engine and keeps minimized mismatches\n" << endl;
+    }
+
+    elementNames.ClearStore();
+    StringPool::ClearStore();
+    return status;
+}
+
+#else
+
+// libFuzzer entry point, the fuzzer input is used as the geometry source file with an empty header
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    ElementNames::SetElementNames();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+    std::stringstream streamS, streamH;
+    IsoResult ref, test;
+
+    streamS.str(string((const char*)data, size)+"\n");
+    engines[0].run(streamS, streamH, ref.isoNameList, ref.isoTempVec);
+
+    for(int i=1; i<numEngines; i++)
+    {
+        streamS.clear();
+        streamS.str(string((const char*)data, size)+"\n");
+        streamH.clear();
+        streamH.str("");
+        test.isoNameList.clear();
+        test.isoTempVec.clear();
+        engines[i].run(streamS, streamH, test.isoNameList, test.isoTempVec);
+        if(CompareResults(ref, test)!=-1)
+        {
+            cout << "\nError: engine " << engines[i].name << " disagrees with " << engines[0].name << endl;
+            abort();
+        }
+    }
+    return 0;
+}
+
+#endif
+
+//RunLegacyEngine
+//the free-function isotope extraction used by the macro creator
+void RunLegacyEngine(std::stringstream& streamS, std::stringstream& streamH, std::vector<string> &isoNameList, std::vector<double> &isoTempVec)
+{
+    IsotopeTable isoTable;
+
+    GetGeoIsotopes(streamS, streamH, isoTable);
+    for(int i=0; i<isoTable.GetSize(); i++)
+    {
+        isoNameList.push_back(StringPool::GetName(isoTable.GetLabel(i)));
+        isoTempVec.push_back(isoTable.GetTemperature(i));
+    }
+}
+
+//RunStreamingEngine
+//the statement index used by the macro creator's --streaming option
+void RunStreamingEngine(std::stringstream& streamS, std::stringstream& streamH, std::vector<string> &isoNameList, std::vector<double> &isoTempVec)
+{
+    IsotopeTable isoTable;
+    StatementIndex index;
+    std::stringstream matStream, original;
+
+    index.Scan(streamH, false);
+    index.Scan(streamS, true);
+    index.GetMaterialStream(matStream);
+    index.GetSymbolStream(original);
+
+    ResolveIsotopes(matStream, original, isoTable);
+    for(int i=0; i<isoTable.GetSize(); i++)
+    {
+        isoNameList.push_back(StringPool::GetName(isoTable.GetLabel(i)));
+        isoTempVec.push_back(isoTable.GetTemperature(i));
+    }
+}
+
+//RunParallelEngine
+//the legacy extraction with the materials resolved on several threads and gathered by the isotope collector
+void RunParallelEngine(std::stringstream& streamS, std::stringstream& streamH, std::vector<string> &isoNameList, std::vector<double> &isoTempVec)
+{
+    IsotopeTable isoTable;
+
+    GetGeoIsotopes(streamS, streamH, isoTable, 4);
+    for(int i=0; i<isoTable.GetSize(); i++)
+    {
+        isoNameList.push_back(StringPool::GetName(isoTable.GetLabel(i)));
+        isoTempVec.push_back(isoTable.GetTemperature(i));
+    }
+}
+
+//RunIsolated
+//runs the engine in a child process so that a crash or an endless loop in the parser can't take down the harness
+//returns false if the engine did not finish within engineTimeLimit seconds
+bool RunIsolated(const EngineEntry &engine, const string &source, const string &header, IsoResult &result)
+{
+    int fd[2];
+    result.isoNameList.clear();
+    result.isoTempVec.clear();
+    result.finished=false;
+
+    cout.flush();
+    if(pipe(fd)!=0)
+        return false;
+
+    pid_t pid = fork();
+    if(pid==0)
+    {
+        close(fd[0]);
+        alarm(engineTimeLimit);
+
+        // the parser prints its own error messages, they are not part of the comparison
+        if(freopen("/dev/null", "w", stdout)==NULL)
+            _exit(3);
+
+        std::stringstream streamS, streamH, out;
+        streamS.str(source);
+        streamH.str(header);
+        engine.run(streamS, streamH, result.isoNameList, result.isoTempVec);
+
+        out.precision(17);
+        for(int i=0; i<int(result.isoNameList.size()); i++)
+        {
+            out << result.isoNameList[i] << '\t' << result.isoTempVec[i] << '\n';
+        }
+        string data = out.str();
+        size_t written=0;
+        while(written<data.length())
+        {
+            ssize_t num = write(fd[1], data.c_str()+written, data.length()-written);
+            if(num<=0)
+                break;
+            written+=num;
+        }
+        close(fd[1]);
+        _exit(0);
+    }
+    close(fd[1]);
+    if(pid<0)
+    {
+        close(fd[0]);
+        return false;
+    }
+
+    string data;
+    char buffer[4096];
+    ssize_t num;
+    while((num=read(fd[0], buffer, sizeof(buffer)))>0)
+    {
+        data.append(buffer, num);
+    }
+    close(fd[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if(!(WIFEXITED(status)&&(WEXITSTATUS(status)==0)))
+        return false;
+
+    std::stringstream in(data);
+    string line;
+    while(std::getline(in, line))
+    {
+        size_t tab = line.find('\t');
+        if(tab==std::string::npos)
+            continue;
+        result.isoNameList.push_back(line.substr(0, tab));
+        result.isoTempVec.push_back(strtod(line.c_str()+tab+1, NULL));
+    }
+    result.finished=true;
+    return true;
+}
+
+//CompareResults
+//returns the index of the first entry where the two isotope lists differ or -1 if they are the same
+int CompareResults(const IsoResult &ref, const IsoResult &test)
+{
+    int size = std::min(ref.isoNameList.size(), test.isoNameList.size());
+    for(int i=0; i<size; i++)
+    {
+        if((ref.isoNameList[i]!=test.isoNameList[i])||(ref.isoTempVec[i]!=test.isoTempVec[i]))
+            return i;
+    }
+    if(ref.isoNameList.size()!=test.isoNameList.size())
+        return size;
+    return -1;
+}
+
+//FindMismatch
+//runs every engine on the geometry and describes the first disagreement with the reference engine in the report
+bool FindMismatch(const string &source, const string &header, string &report)
+{
+    IsoResult ref, test;
+    std::stringstream msg;
+
+    RunIsolated(engines[0], source, header, ref);
+
+    for(int i=1; i<numEngines; i++)
+    {
+        RunIsolated(engines[i], source, header, test);
+        if(!ref.finished||!test.finished)
+        {
+            if(ref.finished!=test.finished)
+            {
+                msg << engines[i].name << (test.finished ? " finished" : " did not finish") << " while " << engines[0].name
+                    << (ref.finished ? " finished" : " did not finish");
+                report=msg.str();
+                return true;
+            }
+            continue;
+        }
+        int index = CompareResults(ref, test);
+        if(index!=-1)
+        {
+            msg << engines[i].name << " differs from " << engines[0].name << " at entry " << index << ": ";
+            if(index<int(ref.isoNameList.size()))
+                msg << ref.isoNameList[index] << " " << ref.isoTempVec[index];
+            else
+                msg << "(end of list)";
+            msg << " vs ";
+            if(index<int(test.isoNameList.size()))
+                msg << test.isoNameList[index] << " " << test.isoTempVec[index];
+            else
+                msg << "(end of list)";
+            report=msg.str();
+            return true;
+        }
+    }
+    return false;
+}
+
+//MinimizeInput
+//removes chunks of source lines, halving the chunk size each round, as long as the engines still disagree on what is left
+void MinimizeInput(std::vector<string> &lines, const string &header)
+{
+    string report;
+    int chunk = lines.size()/2;
+
+    while(chunk>0)
+    {
+        bool removed=false;
+        for(int start=0; start<int(lines.size()); )
+        {
+            std::vector<string> trial(lines.begin(), lines.begin()+start);
+            int end = std::min(start+chunk, int(lines.size()));
+            trial.insert(trial.end(), lines.begin()+end, lines.end());
+
+            if(FindMismatch(JoinLines(trial), header, report))
+            {
+                lines.swap(trial);
+                removed=true;
+            }
+            else
+            {
+                start+=chunk;
+            }
+        }
+        if(!removed)
+            chunk/=2;
+    }
+}
+
+//MutateSource
+//applies one random structure preserving edit to the source lines
+void MutateSource(std::vector<string> &lines, std::mt19937 &rng)
+{
+    if(lines.empty())
+        return;
+
+    std::uniform_int_distribution<int> pickLine(0, lines.size()-1), pickOp(0, 5);
+    int line = pickLine(rng), other = pickLine(rng);
+    string &text = lines[line];
+
+    switch(pickOp(rng))
+    {
+        case 0:
+            lines.erase(lines.begin()+line);
+            break;
+        case 1:
+            lines.insert(lines.begin()+other, lines[line]);
+            break;
+        case 2:
+            std::swap(lines[line], lines[other]);
+            break;
+        case 3:
+        {
+            // replaces one number in the line with another
+            size_t pos = text.find_first_of("0123456789");
+            if(pos!=std::string::npos)
+            {
+                size_t end = text.find_first_not_of("0123456789.", pos);
+                std::stringstream num;
+                num << std::uniform_int_distribution<int>(0, 2000)(rng);
+                if(std::uniform_int_distribution<int>(0, 1)(rng))
+                    num << '.';
+                text.replace(pos, ((end==std::string::npos) ? text.length() : end)-pos, num.str());
+            }
+            break;
+        }
+        case 4:
+        {
+            // swaps the temperature unit
+            size_t pos;
+            if((pos=text.find("kelvin"))!=std::string::npos)
+                text.replace(pos, 6, "celsius");
+            else if((pos=text.find("celsius"))!=std::string::npos)
+                text.replace(pos, 7, "kelvin");
+            break;
+        }
+        default:
+        {
+            // drops one argument from a constructor or Add call
+            size_t pos = text.find(',');
+            if(pos!=std::string::npos)
+            {
+                size_t end = text.find_first_of(",)", pos+1);
+                if(end!=std::string::npos)
+                    text.erase(pos, end-pos);
+            }
+            break;
+        }
+    }
+}
+
+//GenerateCorpus
+//writes synthetic geometry pairs into the corpus directory
+int GenerateCorpus(int argc, char **argv)
+{
+    if(argc<5)
+        return 2;
+
+    string dirName = argv[2];
+    int count = atoi(argv[3]), numMat = atoi(argv[4]);
+    unsigned int seed = (argc>5) ? strtoul(argv[5], NULL, 10) : 1;
+    SyntheticGeometry generator(seed);
+
+    mkdir(dirName.c_str(), 0755);
+    for(int i=0; i<count; i++)
+    {
+        std::stringstream className;
+        className << "Synth" << i << "Constructor";
+        if(!generator.WriteFiles(dirName, className.str(), numMat))
+        {
+            cout << "\nError: couldn't write " << className.str() << " to " << dirName << endl;
+            return 1;
+        }
+    }
+    cout << "\nGenerated " << count << " geometries with " << numMat << " materials in " << dirName << endl;
+    return 0;
+}
+
+//RecordCorpus
+//stores the isotope list the reference engine finds for each geometry in the corpus, these lists are what later builds are held to
+int RecordCorpus(int argc, char **argv)
+{
+    if(argc<3)
+        return 2;
+
+    string dirName = argv[2];
+    std::vector<string> baseNames;
+    string source, header;
+    IsoResult ref;
+
+    FindGeoPairs(dirName, baseNames);
+    for(int i=0; i<int(baseNames.size()); i++)
+    {
+        ReadFile(baseNames[i]+".cc", source);
+        ReadFile(baseNames[i]+".hh", header);
+        if(RunIsolated(engines[0], source, header, ref))
+            WriteIsoList(baseNames[i]+".iso", ref);
+        else
+            cout << "\nError: " << engines[0].name << " did not finish " << baseNames[i] << ", no reference list stored" << endl;
+    }
+    cout << "\nRecorded " << baseNames.size() << " reference isotope lists" << endl;
+    return 0;
+}
+
+//DiffCorpus
+//checks every engine against the stored reference lists and against each other, returns 1 if any geometry disagrees
+int DiffCorpus(int argc, char **argv)
+{
+    if(argc<3)
+        return 2;
+
+    string dirName = argv[2];
+    std::vector<string> baseNames, lines;
+    string source, header, report;
+    IsoResult ref, test;
+    int failures=0;
+
+    FindGeoPairs(dirName, baseNames);
+    for(int i=0; i<int(baseNames.size()); i++)
+    {
+        ReadFile(baseNames[i]+".cc", source);
+        ReadFile(baseNames[i]+".hh", header);
+
+        if(ReadIsoList(baseNames[i]+".iso", ref))
+        {
+            for(int j=0; j<numEngines; j++)
+            {
+                RunIsolated(engines[j], source, header, test);
+                int index = CompareResults(ref, test);
+                if(!test.finished||(index!=-1))
+                {
+                    cout << "\n" << baseNames[i] << ": " << engines[j].name << " no longer matches the stored isotope list";
+                    if(test.finished)
+                        cout << " (first difference at entry " << index << ")";
+                    cout << endl;
+                    failures++;
+                }
+            }
+        }
+
+        if(FindMismatch(source, header, report))
+        {
+            cout << "\n" << baseNames[i] << ": " << report << endl;
+            SplitLines(source, lines);
+            MinimizeInput(lines, header);
+            FindMismatch(JoinLines(lines), header, report);
+            SaveReproducer(dirName+"/minimized", baseNames[i].substr(baseNames[i].find_last_of('/')+1), lines, header, report);
+            failures++;
+        }
+    }
+
+    cout << "\nCompared " << numEngines << " engines on " << baseNames.size() << " geometries, " << failures << " mismatches" << endl;
+    return (failures>0) ? 1 : 0;
+}
+
+//FuzzEngines
+//mutates small synthetic geometries and keeps every minimized input on which the engines disagree
+int FuzzEngines(int argc, char **argv)
+{
+    if(argc<4)
+        return 2;
+
+    string dirName = argv[2], header, report;
+    int iterations = atoi(argv[3]), failures=0;
+    unsigned int seed = (argc>4) ? strtoul(argv[4], NULL, 10) : 1;
+    std::mt19937 rng(seed);
+    SyntheticGeometry generator(seed);
+    std::vector<string> lines;
+
+    mkdir(dirName.c_str(), 0755);
+    for(int i=0; i<iterations; i++)
+    {
+        std::stringstream source, headerS, baseName;
+        generator.Generate("FuzzConstructor", std::uniform_int_distribution<int>(1, 12)(rng), source, headerS);
+        header = headerS.str();
+        SplitLines(source.str(), lines);
+
+        int numMutations = std::uniform_int_distribution<int>(1, 4)(rng);
+        for(int j=0; j<numMutations; j++)
+        {
+            MutateSource(lines, rng);
+        }
+
+        if(FindMismatch(JoinLines(lines), header, report))
+        {
+            MinimizeInput(lines, header);
+            FindMismatch(JoinLines(lines), header, report);
+            baseName << "fuzz_" << seed << "_" << i;
+            SaveReproducer(dirName, baseName.str(), lines, header, report);
+            cout << "\n" << baseName.str() << ": " << report << endl;
+            failures++;
+        }
+    }
+
+    cout << "\nFuzzed " << iterations << " geometries, " << failures << " mismatches" << endl;
+    return (failures>0) ? 1 : 0;
+}
+
+void SplitLines(const string &text, std::vector<string> &lines)
+{
+    std::stringstream in(text);
+    string line;
+    lines.clear();
+    while(std::getline(in, line))
+    {
+        lines.push_back(line);
+    }
+}
+
+string JoinLines(const std::vector<string> &lines)
+{
+    string text;
+    for(int i=0; i<int(lines.size()); i++)
+    {
+        text+=lines[i]+'\n';
+    }
+    return text;
+}
+
+//FindGeoPairs
+//finds every name.cc file in the directory that has a matching name.hh file
+void FindGeoPairs(string dirName, std::vector<string> &baseNames)
+{
+    DIR *dir = opendir(dirName.c_str());
+    struct dirent *entry;
+    struct stat info;
+
+    baseNames.clear();
+    if(dir==NULL)
+    {
+        cout << "\nError: couldn't open directory " << dirName << endl;
+        return;
+    }
+    while((entry=readdir(dir))!=NULL)
+    {
+        string fileName = entry->d_name;
+        if((fileName.length()>3)&&(fileName.substr(fileName.length()-3)==".cc"))
+        {
+            string baseName = dirName+"/"+fileName.substr(0, fileName.length()-3);
+            if(stat((baseName+".hh").c_str(), &info)==0)
+                baseNames.push_back(baseName);
+        }
+    }
+    closedir(dir);
+    std::sort(baseNames.begin(), baseNames.end());
+}
+
+bool ReadFile(string fileName, string &data)
+{
+    std::stringstream ss;
+    GetDataStream(fileName, ss);
+    data = ss.str();
+    return !ss.fail();
+}
+
+bool WriteFile(string fileName, const string &data)
+{
+    std::ofstream out(fileName.c_str(), std::ios::out | std::ios::trunc);
+    out << data;
+    return out.good();
+}
+
+void WriteIsoList(string fileName, const IsoResult &result)
+{
+    std::stringstream out;
+    out.precision(17);
+    for(int i=0; i<int(result.isoNameList.size()); i++)
+    {
+        out << result.isoNameList[i] << '\t' << result.isoTempVec[i] << '\n';
+    }
+    WriteFile(fileName, out.str());
+}
+
+bool ReadIsoList(string fileName, IsoResult &result)
+{
+    std::ifstream in(fileName.c_str());
+    string line;
+
+    result.isoNameList.clear();
+    result.isoTempVec.clear();
+    result.finished=true;
+    if(!in.good())
+        return false;
+
+    while(std::getline(in, line))
+    {
+        size_t tab = line.find('\t');
+        if(tab==std::string::npos)
+            continue;
+        result.isoNameList.push_back(line.substr(0, tab));
+        result.isoTempVec.push_back(strtod(line.c_str()+tab+1, NULL));
+    }
+    return true;
+}
+
+//SaveReproducer
+//stores a minimized geometry pair and the disagreement it causes into the corpus
+void SaveReproducer(string dirName, string baseName, const std::vector<string> &lines, const string &header, const string &report)
+{
+    mkdir(dirName.c_str(), 0755);
+    WriteFile(dirName+"/"+baseName+".cc", JoinLines(lines));
+    WriteFile(dirName+"/"+baseName+".hh", header);
+    WriteFile(dirName+"/"+baseName+".txt", report+"\n");
+}
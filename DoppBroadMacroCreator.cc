@@ -3,1103 +3,830 @@ using namespace std;
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <cstdlib>
 #include <vector>
 #include <string>
 #include <sstream>
 #include <dirent.h>
-#include "include/ElementNames.hh"
+#include "ElementNames.hh"
+#include "MacroCreator.hh"
+#include "StringPool.hh"
+#include "BoundedQueue.hh"
+#include "Preprocessor.hh"
+#include "GeoSnapshot.hh"
+#include "StatementIndex.hh"
+#include "ProvenanceReport.hh"
+#include "TaskScheduler.hh"
+#include "MaterialResolution.hh"
+#include "GeoBundle.hh"
+#include "ConversionServer.hh"
+#include "CSDataIndex.hh"
+#include "GdmlReader.hh"
+#include "ScanWatchdog.hh"
 #include <iomanip>
-
-// add header file to the original string stream
-// use findDouble() when determining if the constructor is a single isotope or not
-
-enum  OutFilter {characters=1, numbers, NA, symbols};
-
-void GetDataStream( string, std::stringstream&);
-
-void FormatData(std::stringstream& streamS, std::stringstream& streamH);
-bool MovePastWord(std::stringstream& stream, string word);
-string ExtractString(std::stringstream &stream, char delim, int outType=7);
-void CropStream(std::stringstream& stream, int firstChar, int lastChar=0);
-void FindMaterialList(std::stringstream& stream, std::vector<string> &matNameList);
-void GetIsotopeList(std::stringstream& stream, std::vector<string> &matNameList, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, std::stringstream &original);
-bool FindConstructor(std::stringstream& stream, string name, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, string matType, double matTemp=0, std::stringstream *original=NULL, bool matSet=false);
-double FindMatTemp(std::stringstream& stream, string matName, bool normal, std::stringstream *original=NULL);
-int FindElementList(std::stringstream& stream, string matName, std::vector<string> &matNameList, std::vector<string> &elemNameList, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, double matTemp);
-void FindIsotopeList(std::stringstream& stream, string elemName, std::vector<string> &elemNameList, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, double matTemp);
-bool findDouble(std::stringstream *stream, string variable, double &temperature);
-void GetAndAddIsotope(std::stringstream& stream, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, double matTemp);
-
-string CreateMacroName(string geoFileName, string outDirName);
-void SetDataStream( string, std::stringstream&);
-
-
+#include <thread>
+#include <ctime>
+#include <map>
+#include <algorithm>
+#include <atomic>
+
+// holds the file names and data of one geometry source file, header file pair as it moves through the conversion pipeline
+struct GeoJob
+{
+    string geoFileSourceName, geoFileHeaderName, macroFileName, snapFileName, minorFileName, stateFileName, removedFileName;
+    std::stringstream streamS, streamH, minorStream, stateStream, removedStream;
+    IsotopeTable isoTable;
+    SnapshotStamp stamp;
+    std::vector<LineMark> lineMarks;
+    // set when the streams hold the statement index of the geometry instead of the whole files
+    bool indexed;
+    bool fromSnapshot, writeSnapshot;
+    // set when the geometry is a GDML file, it has no header file and is read by the GDML reader
+    bool gdml;
+    // the scanning budget of the geometry, a geometry whose watchdog trips while it is parsed gets no macrofile
+    ScanWatchdog watchdog;
+    // the place of the geometry on the command line
+    int jobIndex;
+};
+
+// the settings chosen on the command line that the pipeline stages need
+struct RunOptions
+{
+    string outDirName, snapDirName, reportFileName, outBundleName;
+    // describes every option that changes what the parser finds, snapshots made with different settings are not reused
+    string parseSettings;
+    Preprocessor *preprocessor;
+    bool streaming;
+    // the number of threads that the materials of each geometry are resolved on
+    int numThreads;
+    // the geometry files are read from inBundle and the macrofiles written into outBundle when they are set
+    GeoBundle *inBundle, *outBundle;
+    // the isotopes at the temperatures listed here already have broadened files and are left out of the macrofiles when it is set
+    CSDataIndex *doneIndex;
+    // the CS data with the closest temperature to each isotope is looked up here and written into the macrofiles when it is set
+    CSDataIndex *sourceIndex;
+    // isotopes whose number density is known to be below minDensity (in atoms/cm3) are left out of the macrofiles when it isn't
+    // negative, with writeMinor they are written into a macrofile of their own instead
+    double minDensity;
+    bool writeMinor;
+    // the macrofiles only list the isotopes that weren't in the last run's macrofile, the full list is kept in a state file
+    bool delta;
+    // the scanning steps and seconds that the parsing of each geometry may take, 0 for no limit
+    long maxSteps;
+    double maxSeconds;
+    std::atomic<long> numSkipped, numNoSource, numMinor, numAdded, numRemoved, numFailed;
+};
+
+// the maximum number of geometries that can be waiting between two stages of the pipeline, this caps the memory used for large batches
+const int pipelineDepth = 4;
+
+void ReadStage(std::vector<string> *fileNames, RunOptions *options, BoundedQueue<GeoJob*> *readQueue);
+void WriteStage(BoundedQueue<GeoJob*> *writeQueue, RunOptions *options);
+bool ReadGeoFile(string fileName, RunOptions *options, std::stringstream &stream);
+bool MakeBundleStamp(GeoBundle &bundle, string sourceName, string headerName, string settings, SnapshotStamp &stamp);
+void AddBundlePairs(GeoBundle &bundle, std::vector<string> &fileNames);
+void PairGdmlFiles(std::vector<string> &fileNames);
+void ReadGdml(GeoJob *job, RunOptions *options);
+void ConvertTask(GeoJob *job, RunOptions *options, TaskScheduler *scheduler, int worker, BoundedQueue<GeoJob*> *writeQueue, BoundedQueue<int> *inFlight);
+void FinishJob(GeoJob *job, RunOptions *options, BoundedQueue<GeoJob*> *writeQueue);
 
 int main(int argc, char **argv)
 {
-    string geoFileSourceName, geoFileHeaderName, outDirName;
+    string arg;
+    std::vector<string> fileNames;
+    Preprocessor preprocessor;
+    RunOptions options;
+    GeoBundle inBundle, outBundle;
+    CSDataIndex doneIndex, sourceIndex;
+    string inBundleName, socketName, doneDirName, sourceDirName;
+    bool preprocess=false;
+    options.streaming=false;
+    options.numThreads=1;
+    options.inBundle=NULL;
+    options.outBundle=NULL;
+    options.doneIndex=NULL;
+    options.sourceIndex=NULL;
+    options.minDensity=-1.;
+    options.writeMinor=false;
+    options.delta=false;
+    options.maxSteps=0;
+    options.maxSeconds=0.;
+    options.numSkipped=0;
+    options.numNoSource=0;
+    options.numMinor=0;
+    options.numAdded=0;
+    options.numRemoved=0;
+    options.numFailed=0;
     ElementNames elementNames;
     elementNames.SetElementNames();
-    std::stringstream streamS, streamH;
-    string macroFileName;
 
-    //checks to make sure that number of arguments (including the program call) is equal to 4 or greater and that it is even
-    if(argc>=4&&(floor(argc/2)==ceil(argc/2)))
+    // options can be given anywhere on the command line, the remaining arguments are the output directory followed by the geometry file pairs
+    for(int i=1; i<argc; i++)
     {
-        outDirName = argv[1];
-
-        //loops through the given geometry source file, header file pairs and creates a macrofile (to be used by the dopplerbroadpara code) for each of them
-        for(int i = 2; i<argc; i+=2)
+        arg = argv[i];
+        if(arg=="--preprocess")
         {
-            geoFileSourceName = argv[i];
-            geoFileHeaderName = argv[i+1];
-
-            // copies the data from the source and header file into a stringstream
-            GetDataStream(geoFileSourceName, streamS);
-            GetDataStream(geoFileHeaderName, streamH);
-
-            // Extracts the isotope names and temperatures used in the geometry and stores the information into the source stream
-            FormatData(streamS, streamH);
-
-            // generates the name for the macrofile based off the given source file name and the output directory
-            macroFileName = CreateMacroName(geoFileSourceName, outDirName);
-
-            //stores the information contianed in the source stream into the newly created macrofile
-            SetDataStream( macroFileName, streamS);
+            preprocess=true;
         }
-
-        cout << "\nMacro file creation is complete, don't forget to fill in the DoppBroad run parameters at the top of the macrofile before using it\n" << endl;
-    }
-    else
-    {
-        cout << "\nGive the the output directory and then the name of the source and the header file (in that order) for each G4Stork geometry that you want to convert\n" <<  endl;
-    }
-
-    elementNames.ClearStore();
-}
-
-void GetDataStream( string geoFileName, std::stringstream& ss)
-{
-    string* data=NULL;
-
-    // Use regular text file
-    std::ifstream thefData( geoFileName.c_str() , std::ios::in | std::ios::ate );
-    if ( thefData.good() )
-    {
-        // determines the size of the file in characters
-        int file_size = thefData.tellg();
-        thefData.seekg( 0 , std::ios::beg );
-
-        // creates a character array based off the size of the file
-        char* filedata = new char[ file_size ];
-        while ( thefData )
+        else if(arg=="--streaming")
         {
-            // stores the file data into the character array
-            thefData.read( filedata , file_size );
+            options.streaming=true;
         }
-        thefData.close();
-        // stores the character array into a string
-        data = new string ( filedata , file_size );
-        delete [] filedata;
-    }
-    else
-    {
-    // found no data file
-    //                 set error bit to the stream
-        ss.setstate( std::ios::badbit );
-    }
-    if (data != NULL)
-    {
-        //stores the string into a stringstream
-        ss.str(*data);
-        if(data->back()!='\n')
-            ss << "\n";
-        ss.seekg( 0 , std::ios::beg );
-    }
-
-    delete data;
-}
-
-void FormatData(std::stringstream& stream, std::stringstream& stream2)
-{
-    std::vector<string> matNameList;
-    std::vector<string> isoNameList;
-    std::vector<double> isoTempVec;
-    std::stringstream original;
-
-    // combines the source file stream and the header file stream into one stream for advanced searching of variables
-    original.str(stream2.str()+stream.str());
-
-    // searches throught the source stream for the ConstructMaterials() function and moves the file pointer past that position
-    MovePastWord(stream, "::ConstructMaterials()");
-    int pos = stream.tellg();
-
-    // removes the information in the source stream before the current position
-    CropStream(stream, pos);
-
-    // finds the material map used in the geometry file and stores it into the matNameList vector
-    FindMaterialList(stream, matNameList);
-
-    //Gets the isotope list using the matNameList and the source and the header stream
-    GetIsotopeList(stream, matNameList, isoNameList, isoTempVec, original);
-
-    stream.str("");
-    stream.clear();
-
-    // prints a list of variables (that will determine what the doppler broadening program will do with the information) the user must fill in after the macrofile has been created
-    stream << "(int: # of parameters)\n" << "(string: CS data input file or directory)\n" << "(string: CS data output file or directory)\n"
-            << "(bool: use the file in the input directory with the closest temperature)\n" << "(double: use the file in the input directory with this temperature)\n"
-            << "[Optional](string: choose either ascii or compressed for the output file type {Default=ascii})\n" << "[Optional](bool: create log file to show progress and errors {Default=false})\n"
-            << "[Optional](bool: regenerate any existing doppler broadened data file with the same name {Default=true})\n" << isoNameList.size() << "\n\n"
-            << "Fill in the above parameters and then delete this line before running.\n" << "The order of the parameters must be mantianed,\n"
-            << "to enter an option the user must enter the previous options on the list \nleave the number at the bottom this is your # of isotopes\n\n";
-
-    // loops throught the isotope list and adds the
-    for(int i=0; i<int(isoNameList.size()); i++)
-    {
-        stream.fill(' ');
-        stream << std::setw(20) << std::left << isoNameList[i] << std::setw(14) << std::left << isoTempVec[i] << '\n';
-    }
-}
-
-// MovePastWord
-// breaks up the given string into words then it searches throught the stream ignoring whitespace looking for match between the words extracted from the string and those in the stream
-// a match occurs when the stream has the words in the same order as they are in the string and without any words inbetween them
-// when a match is found the file pointer is set to the position just after the match and then the function returns true
-bool MovePastWord(std::stringstream& stream, string word)
-{
-    std::vector<string> wordParts;
-    int pos=0, start;
-    bool check=true, firstPass=true;
-
-    start = stream.tellg();
-
-    for(int i=0; i<int(word.length()); i++)
-    {
-        if(word[i]==' ')
+        else if(arg.substr(0,10)=="--threads=")
         {
-            if(check)
-            {
-                pos=i+1;
-            }
-            else
-            {
-                wordParts.push_back(word.substr(pos,i-pos));
-                pos=i+1;
-                check=true;
-            }
+            options.numThreads = atoi(arg.substr(10).c_str());
+            if(options.numThreads<1)
+                options.numThreads=1;
         }
-        else
+        else if(arg.substr(0,9)=="--report=")
         {
-            check=false;
-            if(i==int(word.length()-1))
-            {
-                wordParts.push_back(word.substr(pos,i-pos+1));
-            }
+            options.reportFileName = arg.substr(9);
         }
-    }
-
-    if(wordParts.size()==0)
-    {
-        wordParts.push_back(word);
-    }
-
-    string wholeWord, partWord;
-    check=false;
-    char line[256];
-
-    while(!check)
-    {
-        if(!stream)
+        else if(arg.substr(0,15)=="--input-bundle=")
         {
-            if(firstPass)
-            {
-                stream.clear();
-                stream.seekg(start, std::ios::beg);
-                firstPass=false;
-            }
-            else
-            {
-                break;
-            }
+            inBundleName = arg.substr(15);
         }
-        if(stream.peek()=='/')
+        else if(arg.substr(0,16)=="--output-bundle=")
         {
-            stream.get();
-            if(stream.peek()=='/')
-            {
-                stream.getline(line,256);
-            }
-            else if(stream.peek()=='*')
-            {
-                stream.get();
-                while(stream)
-                {
-                    if(stream.get()=='*')
-                    {
-                        if(stream.get()=='/')
-                        {
-                            break;
-                        }
-                    }
-                }
-            }
+            options.outBundleName = arg.substr(16);
         }
-        else if(stream.peek()=='\n')
+        else if(arg.substr(0,16)=="--skip-existing=")
         {
-            stream.getline(line,256);
+            doneDirName = arg.substr(16);
         }
-        else if(stream.peek()=='\t')
+        else if(arg.substr(0,17)=="--closest-source=")
         {
-            stream.get();
+            sourceDirName = arg.substr(17);
         }
-        else if(stream.peek()==' ')
+        else if(arg.substr(0,14)=="--min-density=")
         {
-            stream.get();
+            options.minDensity = atof(arg.substr(14).c_str());
+            if(options.minDensity<0.)
+                options.minDensity=0.;
         }
-        else
+        else if(arg=="--minor-macro")
         {
-            for(int i=0; i<int(wordParts.size()); i++)
-            {
-                stream >> wholeWord;
-                if(int(wholeWord.length())>=int((wordParts[i]).length()))
-                {
-                    if(firstPass)
-                    {
-                        check=(wholeWord==(wordParts[i]));
-                        if(!check)
-                        {
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        partWord = wholeWord.substr(0, (wordParts[i]).length());
-                        check=(partWord==(wordParts[i]));
-
-                        if(check)
-                        {
-                            stream.seekg((partWord.length()-wholeWord.length()),std::ios_base::cur);
-                        }
-                        else if(0==i)
-                        {
-                            partWord = wholeWord.substr(wholeWord.length()-(wordParts[i]).length(), (wordParts[i]).length());
-                            check=(partWord==(wordParts[i]));
-                        }
-
-                        if(!check)
-                        {
-                            break;
-                        }
-                    }
-
-                }
-                else
-                {
-                    break;
-                }
-            }
+            options.writeMinor=true;
         }
-
-    }
-
-    if(!check)
-    {
-        stream.clear();
-        stream.seekg(start, std::ios::beg);
-    }
-
-    return check;
-}
-
-// ExtractString
-// starting from the current position in the stream the function looks through the stream character by character checking if it meets the given format
-// and if so adding it to a string which is returned when the delimeter is found
-string ExtractString(std::stringstream &stream, char delim, int outType)
-{
-    string value="";
-    bool charOut=false, numOut=false, symOut=false;
-    char letter;
-    //bool first=true;
-
-    if(outType==0)
-    {
-
-    }
-    else if(outType==1)
-    {
-        charOut=true;
-    }
-    else if(outType==2)
-    {
-        numOut=true;
-    }
-    else if(outType==3)
-    {
-        charOut=true;
-        numOut=true;
-    }
-    else if(outType==4)
-    {
-        symOut=true;
-    }
-    else if(outType==5)
-    {
-        charOut=true;
-        symOut=true;
-    }
-    else if(outType==6)
-    {
-        numOut=true;
-        symOut=true;
-    }
-    else
-    {
-        charOut=true;
-        numOut=true;
-        symOut=true;
-    }
-
-    while(stream&&(stream.peek()!=delim))
-    {
-        letter = stream.get();
-        if(((letter>='A')&&(letter<='Z'))||((letter>='a')&&(letter<='z')))
+        else if(arg=="--delta")
         {
-            if(charOut)
-            {
-                value+=letter;
-                //first=true;
-            }
-            /*else if(first)
-            {
-                value+=' ';
-                first=false;
-            }*/
+            options.delta=true;
         }
-        else if(((letter>='0')&&(letter<='9'))||(letter=='.')||(letter=='-'))
+        else if(arg.substr(0,12)=="--max-steps=")
         {
-            if(numOut)
-            {
-                value+=letter;
-                //first=true;
-            }
-            /*else if(first)
-            {
-                value+=' ';
-                first=false;
-            }*/
+            options.maxSteps = atol(arg.substr(12).c_str());
+        }
+        else if(arg.substr(0,14)=="--max-seconds=")
+        {
+            options.maxSeconds = atof(arg.substr(14).c_str());
+        }
+        else if(arg.substr(0,8)=="--serve=")
+        {
+            socketName = arg.substr(8);
+        }
+        else if(arg.substr(0,15)=="--snapshot-dir=")
+        {
+            options.snapDirName = arg.substr(15);
+            if((options.snapDirName!="")&&(options.snapDirName[options.snapDirName.length()-1]!='/'))
+                options.snapDirName+='/';
+        }
+        else if((arg.length()>2)&&(arg.substr(0,2)=="-I"))
+        {
+            preprocessor.AddIncludePath(arg.substr(2));
+            options.parseSettings+=arg+'\n';
+            preprocess=true;
+        }
+        else if((arg.length()>2)&&(arg.substr(0,2)=="-D"))
+        {
+            size_t pos = arg.find('=');
+            if(pos==std::string::npos)
+                preprocessor.Define(arg.substr(2));
+            else
+                preprocessor.Define(arg.substr(2, pos-2), arg.substr(pos+1));
+            options.parseSettings+=arg+'\n';
+            preprocess=true;
         }
         else
         {
-            if(symOut)
-            {
-                value+=letter;
-                //first=true;
-            }
-            /*else if(first)
-            {
-                value+=' ';
-                first=false;
-            }*/
+            fileNames.push_back(arg);
         }
     }
-    return value;
-}
-
-// CropStream
-// overwirtes the given stream with the data between the given firstchar and last char of the stream
-void CropStream(std::stringstream& stream, int firstChar, int lastChar)
-{
-    if(lastChar==0)
-        stream.seekg( 0 , std::ios::end );
-    else
-        stream.seekg( lastChar , std::ios::beg );
 
-    int file_size = int(stream.tellg())-firstChar;
-    stream.seekg( firstChar , std::ios::beg );
-    char* filedata = new char[ file_size ];
+    options.preprocessor = (preprocess ? &preprocessor : NULL);
+    if(preprocess)
+        options.parseSettings+="--preprocess\n";
+    if(options.streaming)
+        options.parseSettings+="--streaming\n";
 
-    stream.read( filedata , file_size );
-    if(!stream)
+    // the server keeps the element names and its cache of isotope lists between requests until it is stopped
+    if(socketName!="")
     {
-        cout << "\n #### Error reading string stream ###" << endl;
-        return;
-    }
-    stream.str("");
-    stream.clear();
+        ConversionServer server(options.preprocessor, options.streaming);
+        int numWorkers = (options.numThreads>1) ? options.numThreads : std::max(2, int(std::thread::hardware_concurrency()));
+        bool served = server.Run(socketName, numWorkers);
 
-    stream.write( filedata, file_size);
-    stream.seekg(0 , std::ios::beg);
-
-    delete filedata;
-}
+        elementNames.ClearStore();
+        StringPool::ClearStore();
+        return (served ? 0 : 1);
+    }
 
-//FindMaterialList
-//Gets the G4Material objects stroed in the material map
-void FindMaterialList(std::stringstream& stream, std::vector<string> &matNameList)
-{
-    string name="";
-    while(MovePastWord(stream, "matMap["))
+    // the CS data output directory is read once up front, the isotope lists are checked against the index as each macrofile is made
+    if(doneDirName!="")
     {
-        stream.get();
-
-        ExtractString(stream, '=', 0);
-
-        stream.get();
-
-        name=ExtractString(stream, ';', int(characters+numbers));
-        if(name!="")
+        if(!doneIndex.Scan(doneDirName))
         {
-            matNameList.push_back(name);
+            cout << "\nError: could not read the CS data directory " << doneDirName << endl;
+            return 1;
         }
-        else
+        options.doneIndex = &doneIndex;
+    }
+
+    // the unbroadened G4NDL data has no temperature in its path, it is taken to be at 0 K
+    if(sourceDirName!="")
+    {
+        if(!sourceIndex.Scan(sourceDirName, 0.))
         {
-            cout << "\nError: found a blank when trying to extract material name\n" << endl;
+            cout << "\nError: could not read the CS data directory " << sourceDirName << endl;
+            return 1;
         }
-        name.clear();
-
+        options.sourceIndex = &sourceIndex;
     }
-    stream.clear();
-    stream.seekg(0, std::ios::beg);
-}
-
-//GetIsotopeList
-//takes in a data stream and a material name list and it searches the data stream for the isotopes that make up the material and their respective temperatures
-//then it outputs the information into a list of isotope names and a list of isotope temperatures
-void GetIsotopeList(std::stringstream& stream, std::vector<string> &matNameList, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, std::stringstream &original)
-{
-    std::vector<string> elemNameList;
-    std::vector<double> tempList;
-    double matTemp;
-    int initialSize = matNameList.size(), addMat;
-    bool matSet=false;
 
-    for(int i=0; i<int(matNameList.size()); i++)
+    if(inBundleName!="")
     {
-        //if the matNameList has been extended due to AddMaterial() being used in the geometry file use the material temperatures stored in the templist
-        if(i>initialSize-1)
+        if(!inBundle.Open(inBundleName))
         {
-            matSet=true;
-            matTemp=tempList[i-initialSize];
+            cout << "\nError: could not read the bundle " << inBundleName << endl;
+            return 1;
         }
+        options.inBundle = &inBundle;
 
-        // find the constructor of the material object in the data stream
-        if(FindConstructor(stream, matNameList[i], isoNameList, isoTempVec, "Material", matTemp, &original, matSet))
-        {
-            //if this material is not part of another material, find the temperature of the material
-            if(!(i>initialSize-1))
-            {
-                matTemp=FindMatTemp(stream, matNameList[i], true, &original );
-            }
+        // without any geometry files given every source file in the bundle that has a matching header is converted
+        if(fileNames.size()==1)
+            AddBundlePairs(inBundle, fileNames);
+    }
+    PairGdmlFiles(fileNames);
 
-            //find the G4Element objects that make up this material and if any materials are used to create the current material added them to the templist
-            addMat=FindElementList(stream, matNameList[i], matNameList, elemNameList, isoNameList, isoTempVec, matTemp);
-            while(addMat>0)
-            {
-                tempList.push_back(matTemp);
-                addMat--;
-            }
+    //checks to make sure that there is an output directory and at least one complete source file, header file pair
+    if((fileNames.size()>=3)&&(fileNames.size()%2==1))
+    {
+        options.outDirName = fileNames[0];
 
-            //find the isotopes used to construct each element
-            for(int j=0; j<int(elemNameList.size()); j++)
+        if(options.outBundleName!="")
+        {
+            if(!outBundle.Create(options.outDirName+options.outBundleName))
             {
-                FindIsotopeList(stream, elemNameList[j], elemNameList, isoNameList, isoTempVec, matTemp);
+                cout << "\nError: could not create the bundle " << options.outDirName+options.outBundleName << endl;
+                return 1;
             }
-            elemNameList.clear();
-
+            options.outBundle = &outBundle;
         }
-        stream.clear();
-        stream.seekg(0, std::ios::beg);
 
-    }
-}
+        // the geometry files are read ahead on one thread and the finished macrofiles are written out on another
+        // so that the file I/O for the neighbouring geometries overlaps with the parsing of the current one
+        BoundedQueue<GeoJob*> readQueue(pipelineDepth), writeQueue(pipelineDepth);
+        std::thread reader(ReadStage, &fileNames, &options, &readQueue);
+        std::thread writer(WriteStage, &writeQueue, &options);
+        GeoJob *job;
+        ProvenanceReport report;
+        if(options.reportFileName!="")
+            ProvenanceReport::SetActive(&report);
 
-//FindConstructor
-//searches the data stream for the constructor of the given object
-bool FindConstructor(std::stringstream& stream, string name, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, string matType,
-                    double matTemp, std::stringstream *original, bool matSet)
-{
-    string check;
-    std::stringstream line;
-    int pos;
-    if(!MovePastWord(stream, (name+" =")))
-    {
-        cout << "\nError: could not find constructor for " << name << "\n" << endl;
-        return false;
-    }
-    else
-    {
-        pos=stream.tellg();
-        int count=0;
+        // with several threads every geometry is converted on the work-stealing scheduler, the report follows the material being
+        // resolved on the parsing thread so it needs the geometries to be converted here one after the other
+        TaskScheduler *scheduler = NULL;
+        if((options.numThreads>1)&&(options.reportFileName==""))
+            scheduler = new TaskScheduler(options.numThreads);
+
+        // holds a slot for every geometry that is being converted on the scheduler, this caps the number of them in memory
+        BoundedQueue<int> inFlight(pipelineDepth+options.numThreads);
+        int slot=0;
 
-        if(matType=="Material")
+        //loops through the given geometry source file, header file pairs and creates a macrofile (to be used by the dopplerbroadpara code) for each of them
+        while(readQueue.Pop(job))
         {
-            bool intType=true;
-            int pos1=pos;
-            while(stream.peek()!=')')
-            {
-                if(stream.get()==',')
-                {
-                    if(count==0)
-                    {
-                        pos1=stream.tellg();
-                    }
-                    count++;
-                }
-                if(count==3)
-                {
-                    line.str(ExtractString(stream, ')', int(characters+numbers+symbols))+")");
-                    line.seekg(0,std::ios::beg);
-                    bool test=false;
-                    while((line.peek()!=')')&&(line.peek()!=','))
-                    {
-                        if(line.get()=='.')
-                        {
-                            intType=false;
-                            break;
-                        }
-                        if(line.peek()==',')
-                        {
-                            test=true;
-                        }
-                    }
-                    if(intType)
-                    {
-                        line.seekg(0,std::ios::beg);
-                        string variable;
-                        double num;
-                        if(test)
-                        {
-                            variable = ExtractString(line, ',', int(characters+numbers));
-                        }
-                        else
-                        {
-                            variable = ExtractString(line, ')', int(characters+numbers));
-                        }
-                        if (findDouble(original, variable, num))
-                        {
-                            stringstream numConv;
-                            numConv << num;
-                            while(numConv)
-                            {
-                                if(numConv.get()=='.')
-                                {
-                                    intType=false;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                    if(intType)
-                    {
-                        intType = (!MovePastWord(line, "kState"));
-                    }
-                    line.str("");
-                    line.clear();
-                    break;
-                }
-            }
-            if(intType)
-            {
-                stream.seekg(pos1, std::ios::beg);
-                return true;
-            }
-            else
+            if(scheduler!=NULL)
             {
-                stream.seekg(pos1, std::ios::beg);
-                if(!matSet)
-                    matTemp=FindMatTemp(stream, name, false, original);
-                stream.seekg(pos1, std::ios::beg);
-                GetAndAddIsotope(stream, isoNameList, isoTempVec, matTemp);
-                return false;
+                inFlight.Push(slot);
+                scheduler->Submit([job, &options, scheduler, &writeQueue, &inFlight](int worker)
+                                    { ConvertTask(job, &options, scheduler, worker, &writeQueue, &inFlight); });
+                continue;
             }
 
-        }
-        else if(matType=="Element")
-        {
-            int count=0, pos1=0, pos2=0;
-            while(stream.peek()!=';')
+            if(options.reportFileName!="")
+                report.BeginGeometry(job->geoFileSourceName, job->geoFileHeaderName, job->fromSnapshot);
+            job->watchdog.Start(options.maxSteps, options.maxSeconds);
+            ScanWatchdog::SetActive(&job->watchdog);
+
+            // Extracts the isotope names and temperatures used in the geometry unless they were loaded from its snapshot
+            if(job->gdml&&!job->fromSnapshot)
             {
-                if(stream.get()==',')
-                {
-                    pos1=pos2;
-                    pos2=stream.tellg();
-                    count++;
-                }
+                ReadGdml(job, &options);
+                job->writeSnapshot = (options.snapDirName!="")&&(job->snapFileName!="");
             }
-            if(count==3)
+            else if(job->indexed)
             {
-                stream.seekg(pos1, std::ios::beg);
-                GetAndAddIsotope(stream, isoNameList, isoTempVec, matTemp);
-                return false;
+                ProvenanceReport::MapLines(job->streamS, job->lineMarks);
+                ResolveIsotopes(job->streamS, job->streamH, job->isoTable);
+                job->writeSnapshot = (options.snapDirName!="")&&(job->snapFileName!="");
             }
-            else
+            else if(!job->fromSnapshot)
             {
-                stream.seekg(pos, std::ios::beg);
-                return true;
+                GetGeoIsotopes(job->streamS, job->streamH, job->isoTable);
+                job->writeSnapshot = (options.snapDirName!="")&&(job->snapFileName!="");
             }
+
+            ScanWatchdog::SetActive(NULL);
+            if(options.reportFileName!="")
+                report.EndGeometry();
+
+            FinishJob(job, &options, &writeQueue);
         }
-        else
+
+        if(scheduler!=NULL)
         {
-            return true;
+            scheduler->Wait();
+            delete scheduler;
         }
-    }
-}
+        writeQueue.Close();
 
-// FindMatTemp
-//finds the temperature of the given material in the data stream
-double FindMatTemp(std::stringstream& stream, string matName, bool normal, std::stringstream *original)
-{
-    int count=0, limit;
-    bool celsius=false, standard=true, number=true, first=true;
-    double temperature=0.;
-    char letter;
-    std::stringstream temp;
+        reader.join();
+        writer.join();
 
-    if(normal)
-    {
-        limit=3;
-    }
-    else
-    {
-        limit=4;
-    }
+        if((options.outBundle!=NULL)&&!outBundle.Close())
+            cout << "\nError: could not finish writing the bundle " << options.outDirName+options.outBundleName << endl;
 
-    while(stream.peek()!=';')
-    {
-        if((stream.get())==',')
+        if(options.reportFileName!="")
         {
-            count++;
+            ProvenanceReport::SetActive(NULL);
+            if(!report.Write(options.reportFileName))
+                cout << "\nError: could not write the report file " << options.reportFileName << endl;
         }
-        if(limit==count)
+
+        if(options.doneIndex!=NULL)
+            cout << "\nLeft out " << options.numSkipped << " isotope/temperature pairs that already have a broadened file in " << doneDirName << endl;
+        if(options.minDensity>=0.)
         {
-            standard=false;
-            break;
+            cout << "\nLeft out " << options.numMinor << " isotope/temperature pairs with a number density below " << options.minDensity << " atoms/cm3";
+            if(options.writeMinor)
+                cout << ", they are listed in the Minor macrofiles";
+            cout << endl;
         }
-    }
-    if(standard)
-    {
-        temperature=273.15;
+        if(options.delta)
+            cout << "\nThe macrofiles list the " << options.numAdded << " isotope/temperature pairs added since the last run, "
+                 << options.numRemoved << " pairs were removed" << endl;
+        if(options.numFailed>0)
+            cout << "\nError: " << options.numFailed << " geometries were skipped because their parsing used up its budget or ran into"
+                 << " the end of the text, see the errors above" << endl;
+        if((options.sourceIndex!=NULL)&&(options.numNoSource>0))
+            cout << "\nError: " << options.numNoSource << " isotope lines have no CS data in " << sourceDirName << endl;
+
+        cout << "\nMacro file creation is complete, don't forget to fill in the DoppBroad run parameters at the top of the macrofile before using it\n" << endl;
     }
     else
     {
-        while((stream.peek()!=',')&&(stream.peek()!=')'))
-        {
-            letter=stream.get();
-            if(((letter>='0')&&(letter<='9'))||(letter=='.')||(letter=='-'))
-            {
-                if(first)
-                {
-                    number=true;
-                    first=false;
-                }
-                temp << letter;
-            }
-            else if((((letter>='A')&&(letter<='Z'))||((letter>='a')&&(letter<='z')))||(letter=='[')||(letter==']')||(letter==','))
+        cout << "\nGive the the output directory and then the name of the source and the header file (in that order) for each G4Stork geometry that you want to convert\n" <<  endl;
+        cout << "A geometry exported as GDML (.gdml) is given as a single file in place of the source and header file\n" << endl;
+        cout << "The geometry files may be gzip (.gz) or zstd (.zst) compressed, they are decompressed as they are read\n" << endl;
+        cout << "Options:\n"
+             << "  --preprocess     follow quoted #includes and expand #defines and #ifdefs in the geometry files before searching them\n"
+             << "  -I<dir>          add a directory to search for included files (implies --preprocess)\n"
+             << "  -D<name>[=value] define a macro before preprocessing, to select #ifdef variants (implies --preprocess)\n"
+             << "  --streaming      read the geometry files a chunk at a time and only keep the statements that define materials,\n"
+             << "                   for very large generated geometries that don't fit into memory\n"
+             << "  --threads=<n>    convert the geometries on n threads, the materials of large geometries are shared out between\n"
+             << "                   the threads as they become idle, the macrofiles are the same for any n\n"
+             << "  --report=<file>  write the time, searches, source lines and isotopes of every material to <file> as JSON\n"
+             << "  --input-bundle=<file>  read the geometry files from the tar file <file>, the file names given are the names\n"
+             << "                   in the tar file, with none given every .cc file with a matching .hh file in it is converted\n"
+             << "  --output-bundle=<name>  write all of the macrofiles into the tar file <name> in the output directory instead of\n"
+             << "                   one file each, <name>.idx lists where each macrofile is stored in it\n"
+             << "  --skip-existing=<dir>  leave out the isotopes that already have a broadened file for their temperature in the CS\n"
+             << "                   data output directory <dir>, files named Z_A_ElementName[_<T>K][.z] are matched to the temperature\n"
+             << "                   at the end of their name or in the closest directory above them named <T> or <T>K\n"
+             << "  --closest-source=<dir>  write the CS data in the input directory <dir> with the closest temperature at or below\n"
+             << "                   each isotope's temperature after it in the macrofile, named the same way as for --skip-existing,\n"
+             << "                   files without a temperature are taken to be at 0 K\n"
+             << "  --min-density=<n>  leave out the isotopes whose number density is below n atoms/cm3 in every material they are\n"
+             << "                   in at that temperature, isotopes in a material whose density or makeup can't be worked out are kept\n"
+             << "  --minor-macro    write the isotopes left out by --min-density into a second macrofile, DoppBroadMacro<name>Minor.txt\n"
+             << "  --delta          only write the isotopes that weren't in the last run's macrofile into the macrofile, the full\n"
+             << "                   list is kept in DoppBroadMacro<name>.state for the next run and the isotopes that are no longer\n"
+             << "                   used are listed in DoppBroadMacro<name>Removed.txt\n"
+             << "  --max-steps=<n>  give up on a geometry whose parsing takes more than n scanning steps, it is reported and gets\n"
+             << "                   no macrofile while the other geometries are converted as usual\n"
+             << "  --max-seconds=<s>  give up on a geometry whose parsing takes more than s seconds, in the same way\n"
+             << "  --serve=<socket>  answer requests for isotope lists on the Unix domain socket <socket> instead of converting the\n"
+             << "                   files given, each request is a line of JSON such as {\"source\": \"a.cc\", \"header\": \"a.hh\"} or\n"
+             << "                   {\"sourceText\": \"...\", \"headerText\": \"...\"} and is answered with a line of JSON, the results are\n"
+             << "                   cached until the files change, --threads=<n> sets the number of connections served at once\n"
+             << "  --snapshot-dir=<dir>  store the isotopes found in each geometry in <dir> and reuse them while the geometry files\n"
+             << "                   and parse options are unchanged (or when the geometry files are no longer there)\n" << endl;
+    }
+
+    elementNames.ClearStore();
+    StringPool::ClearStore();
+}
+
+//ReadStage
+//first stage of the conversion pipeline, copies the data from each source and header file pair into a new job and queues it for parsing
+void ReadStage(std::vector<string> *fileNames, RunOptions *options, BoundedQueue<GeoJob*> *readQueue)
+{
+    GeoJob *job;
+    Preprocessor *preprocessor = options->preprocessor;
+    SnapshotStamp savedStamp;
+
+    for(int i = 1; i<int(fileNames->size()); i+=2)
+    {
+        job = new GeoJob;
+        job->geoFileSourceName = (*fileNames)[i];
+        job->geoFileHeaderName = (*fileNames)[i+1];
+        job->jobIndex = (i-1)/2;
+        job->indexed = false;
+        job->gdml = (job->geoFileHeaderName=="");
+        job->fromSnapshot = false;
+        job->writeSnapshot = false;
+
+        // a snapshot is used in place of the geometry files if it was made from the same files with the same settings
+        if(options->snapDirName!="")
+        {
+            bool filesFound;
+            if(options->inBundle!=NULL)
+                filesFound = MakeBundleStamp(*options->inBundle, job->geoFileSourceName, job->geoFileHeaderName, options->parseSettings, job->stamp);
+            else
+                filesFound = GeoSnapshot::MakeStamp(job->geoFileSourceName, job->geoFileHeaderName, options->parseSettings, job->stamp);
+            string snapFileName = GeoSnapshot::SnapshotName(job->geoFileSourceName, options->snapDirName);
+
+            if(GeoSnapshot::Load(snapFileName, job->isoTable, &savedStamp))
             {
-                if((letter=='c')||(letter=='C'))
-                {
-                    celsius=true;
-                }
-                if(first)
-                {
-                    number=false;
-                    first=false;
-                }
-                if(!number)
-                    temp << letter;
+                job->fromSnapshot = (!filesFound)||GeoSnapshot::Matches(savedStamp, job->stamp);
+                if(!job->fromSnapshot)
+                    job->isoTable.Clear();
             }
+            if(filesFound)
+                job->snapFileName = snapFileName;
+        }
+        if(job->fromSnapshot)
+        {
+            readQueue->Push(job);
+            continue;
         }
 
-        if(temp.str()!="")
+        // a GDML file is streamed through the GDML reader when it is parsed, only a bundled one has to be copied out first
+        if(job->gdml)
         {
-            if(number)
-            {
-                temp >> temperature;
-                if(celsius)
-                {
-                    temperature+=273.15;
-                }
-            }
-            else if(original!=NULL)
-            {
-                if(!findDouble(original, temp.str(), temperature))
-                {
-                    cout << "\nError: couldn't find material temperature " << matName << endl;
-                }
-            }
+            if(options->inBundle!=NULL)
+                ReadGeoFile(job->geoFileSourceName, options, job->streamS);
+            readQueue->Push(job);
+            continue;
         }
-        else
+
+        // builds the statement index from the files without ever holding all of their data in memory
+        if(options->streaming&&(preprocessor==NULL)&&(options->inBundle==NULL))
         {
-            cout << "\nError: unable to find temperature for " << matName << " in the expected position\n" << endl;
+            StatementIndex index;
+            index.ScanFile(job->geoFileHeaderName, false);
+            index.ScanFile(job->geoFileSourceName, true);
+            index.GetMaterialStream(job->streamS);
+            index.GetSymbolStream(job->streamH);
+            job->lineMarks = index.GetLineMarks();
+            job->indexed = true;
+            readQueue->Push(job);
+            continue;
         }
-    }
 
-    return temperature;
-}
+        // copies the data from the source and header file into a stringstream
+        ReadGeoFile(job->geoFileSourceName, options, job->streamS);
+        ReadGeoFile(job->geoFileHeaderName, options, job->streamH);
 
-//findDouble
-//finds the value stored in the given variable
-bool findDouble(std::stringstream *stream, string variable, double &temperature)
-{
-    bool arrayElem=false, number=false, celsius=false, first=true;
-    std::vector<int> arrayIndex;
-    int index, pos1, pos2, count=0;
-    stringstream numConv, temp;
-    char letter;
-    stream->seekg(0, std::ios::beg);
-
-    while(variable.back()==']')
-    {
-        arrayElem=true;
-        pos1=variable.find_first_of('[',0);
-        pos2=variable.find_first_of(']',0);
-        numConv.str(variable.substr(pos1,pos1-pos2-1));
-        numConv >> index;
-        numConv.clear();
-        numConv.str("");
-        arrayIndex.push_back(index);
-        variable.erase(pos1, pos2-pos1+1);
-    }
+        // resolves the includes, macros and conditionals so that temperatures defined through them can be found
+        if(preprocessor!=NULL)
+        {
+            preprocessor->Expand(job->streamS, job->geoFileSourceName);
+            preprocessor->Expand(job->streamH, job->geoFileHeaderName);
+        }
 
-    if(variable!="")
-    {
-        if(*stream)
+        // the preprocessed text or the bundled files have to be held in memory, but the parser still only searches their statement index
+        if(options->streaming)
         {
-            if(MovePastWord((*stream),variable+" ="))
-            {
-                temp.str(ExtractString((*stream),';',int(numbers+characters)));
-                temp.str(temp.str()+';');
+            StatementIndex index;
+            index.Scan(job->streamH, false);
+            index.Scan(job->streamS, true);
+            index.GetMaterialStream(job->streamS);
+            index.GetSymbolStream(job->streamH);
+            job->lineMarks = index.GetLineMarks();
+            job->indexed = true;
+        }
 
-                if(arrayElem)
-                {
-                    for(int i=0; i<int(arrayIndex.size()); i++)
-                    {
-                        ExtractString(temp,'{',0);
-                        temp.get();
-                        while(count!=arrayIndex[i])
-                        {
-                            letter=temp.get();
-                            if(letter=='{')
-                            {
-                               ExtractString(temp,'}',0);
-                               temp.get();
-                            }
-                            else if(letter==',')
-                            {
-                                count++;
-                            }
-                        }
-                    }
-                }
-                while((temp.peek()!=',')&&(temp.peek()!=';'))
-                {
-                    letter=temp.get();
-                    if(((letter>='0')&&(letter<='9'))||(letter=='.')||(letter=='-'))
-                    {
-                        if(first)
-                        {
-                            number=true;
-                            first=false;
-                        }
-                        numConv << letter;
-                    }
-                    else if((((letter>='A')&&(letter<='Z'))||((letter>='a')&&(letter<='z')))||(letter=='[')||(letter==']')||(letter==','))
-                    {
-                        if((letter=='c')||(letter=='C'))
-                        {
-                            celsius=true;
-                        }
-                        if(first)
-                        {
-                            number=false;
-                            first=false;
-                        }
-                        if(!number)
-                            numConv << letter;
-                    }
-                }
-                if(number)
-                {
-                    numConv >> temperature;
-                    if(celsius)
-                    {
-                        temperature+=273.15;
-                    }
-                }
-                else
-                {
-                    (*stream).seekg(0,std::ios::beg);
-                    return findDouble(stream, numConv.str(), temperature);
-                }
+        // blocks while the parser is pipelineDepth geometries behind
+        readQueue->Push(job);
+    }
+    readQueue->Close();
+}
 
-            }
-            else
-            {
-                return false;
-            }
-        }
+//ReadGeoFile
+//copies the data of a geometry file into the stream, from the input bundle if there is one
+bool ReadGeoFile(string fileName, RunOptions *options, std::stringstream &stream)
+{
+    if(options->inBundle==NULL)
+    {
+        GetDataStream(fileName, stream);
+        return true;
     }
-    else
+
+    string data;
+    if(!options->inBundle->Read(fileName, data))
     {
+        cout << "\nError: " << fileName << " is not in the bundle" << endl;
+        stream.str("");
         return false;
     }
-
+    stream.str(data);
     return true;
 }
 
-//FindElementList
-//Finds the elements used to create the given material
-int FindElementList(std::stringstream& stream, string matName, std::vector<string> &matNameList, std::vector<string> &elemNameList, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, double matTemp)
+//MakeBundleStamp
+//stamps a geometry read from the input bundle with the sizes and modification times recorded in the bundle
+bool MakeBundleStamp(GeoBundle &bundle, string sourceName, string headerName, string settings, SnapshotStamp &stamp)
 {
-    string name="";
-    int addMat=0;
-    std::stringstream checkCon;
+    const BundleEntry *source = bundle.Find(sourceName);
+    const BundleEntry *header = bundle.Find(headerName);
 
-    while(MovePastWord(stream, matName+" ->"))
-    {
-        name.clear();
-        name=ExtractString(stream, '(', int(characters));
+    GeoSnapshot::MakeStamp("", "", settings, stamp);
+    if((source==NULL)||((header==NULL)&&(headerName!="")))
+        return false;
 
-        stream.get();
+    stamp.sourceSize = source->size;
+    stamp.sourceTime = source->time;
+    if(header!=NULL)
+    {
+        stamp.headerSize = header->size;
+        stamp.headerTime = header->time;
+    }
+    return true;
+}
 
-        if(name=="AddElement")
+//AddBundlePairs
+//adds every source file (.cc) in the bundle that has a header file (.hh) with the same name and every GDML file to the list of
+//geometries, in bundle order
+void AddBundlePairs(GeoBundle &bundle, std::vector<string> &fileNames)
+{
+    const std::vector<BundleEntry> &entries = bundle.GetEntries();
+    for(int i=0; i<int(entries.size()); i++)
+    {
+        const string &name = entries[i].name;
+        if(GdmlReader::IsGdmlFile(name))
         {
-            name.clear();
-            name=ExtractString(stream, ',', int(characters+numbers));
-            stream.get();
-            checkCon.clear();
-            checkCon.str(name);
-            if(MovePastWord(checkCon, "new G4Element"))
-            {
-                ExtractString(stream, ',', 0);
-                GetAndAddIsotope(stream, isoNameList, isoTempVec, matTemp);
-            }
-            else if(name!="")
-            {
-                elemNameList.push_back(name);
-            }
-            else
-            {
-                cout << "\nError: found a blank when trying to extract element name\n" << endl;
-            }
+            fileNames.push_back(name);
+            continue;
         }
-        else if(name=="AddMaterial")
+        if((name.length()<=3)||(name.substr(name.length()-3)!=".cc"))
+            continue;
+        string headerName = name.substr(0, name.length()-3)+".hh";
+        if(bundle.Find(headerName)!=NULL)
         {
-            name.clear();
-
-            name=ExtractString(stream, ',', int(characters+numbers));
-            stream.get();
-            checkCon.clear();
-            checkCon.str(name);
-            if(MovePastWord(checkCon, "new G4Material"))
-            {
-                GetAndAddIsotope(stream, isoNameList, isoTempVec, matTemp);
-            }
-            else if(name!="")
-            {
-                matNameList.push_back(name);
-                addMat++;
-            }
-            else
-            {
-                cout << "\nError: found a blank when trying to extract material name\n" << endl;
-            }
+            fileNames.push_back(name);
+            fileNames.push_back(headerName);
         }
+    }
+}
 
+//PairGdmlFiles
+//gives each GDML file among the geometry files an empty header name, so that every geometry in the list is a source and header pair
+void PairGdmlFiles(std::vector<string> &fileNames)
+{
+    std::vector<string> pairedNames;
+    for(int i=0; i<int(fileNames.size()); i++)
+    {
+        pairedNames.push_back(fileNames[i]);
+        if((i>0)&&GdmlReader::IsGdmlFile(fileNames[i]))
+            pairedNames.push_back("");
     }
-    stream.clear();
-    stream.seekg(0, std::ios::beg);
+    fileNames.swap(pairedNames);
+}
 
-    return addMat;
+//ReadGdml
+//finds the isotopes of a GDML geometry by streaming its file through the GDML reader, or its copy from the input bundle
+void ReadGdml(GeoJob *job, RunOptions *options)
+{
+    GdmlReader reader;
+    if(options->inBundle!=NULL)
+    {
+        reader.Read(job->streamS, job->isoTable);
+    }
+    else if(!reader.ReadFile(job->geoFileSourceName, job->isoTable))
+    {
+        cout << "\nError: could not open the GDML file " << job->geoFileSourceName << endl;
+    }
 }
 
-// FindIsotopeList
-// finds the isotopes used to create the given element
-void FindIsotopeList(std::stringstream& stream, string elemName, std::vector<string> &elemNameList, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, double matTemp)
+//ConvertTask
+//scheduler task that converts one geometry, once the material list is found every material becomes a task of its own that idle
+//workers can steal, the worker that resolves the last material finishes the geometry and hands it to the writer
+void ConvertTask(GeoJob *job, RunOptions *options, TaskScheduler *scheduler, int worker, BoundedQueue<GeoJob*> *writeQueue, BoundedQueue<int> *inFlight)
 {
-    std::vector<string> isoObjectNameList;
-    std::stringstream checkCon;
+    std::vector<NameHandle> matNameList;
+    std::vector<MaterialTask> taskList;
+    std::stringstream original;
+    int slot;
 
-    if(FindConstructor(stream, elemName, isoNameList, isoTempVec, "Element", matTemp))
+    if(job->fromSnapshot)
     {
-        string name="";
-        while(MovePastWord(stream, elemName+" ->"))
-        {
-            name.clear();
-            name=ExtractString(stream, '(', int(characters));
+        FinishJob(job, options, writeQueue);
+        inFlight->Pop(slot);
+        return;
+    }
 
-            stream.get();
+    // the scanning on this worker and on the workers that take the materials counts against the budget of the geometry
+    job->watchdog.Start(options->maxSteps, options->maxSeconds);
 
-            if(name=="AddIsotope")
-            {
-                name.clear();
-                name=ExtractString(stream, ',', int(characters+numbers));
-                stream.get();
-                checkCon.clear();
-                checkCon.str(name);
-                if(MovePastWord(checkCon, "new G4Isotope"))
-                {
-                    GetAndAddIsotope(stream, isoNameList, isoTempVec, matTemp);
-                }
-                else if(name!="")
-                {
-                    isoObjectNameList.push_back(name);
-                }
-                else
-                {
-                    cout << "\nError: found a blank when trying to extract isotope name\n" << endl;
-                }
-            }
-            else if(name=="AddElement")
-            {
-                name.clear();
-                name=ExtractString(stream, ',', int(characters+numbers));
-                stream.get();
-                checkCon.clear();
-                checkCon.str(name);
-                if(MovePastWord(checkCon, "new G4Element"))
-                {
-                    ExtractString(stream, ',', 0);
-                    GetAndAddIsotope(stream, isoNameList, isoTempVec, matTemp);
-                }
-                else if(name!="")
-                {
-                    elemNameList.push_back(name);
-                }
-                else
-                {
-                    cout << "\nError: found a blank when trying to extract element name\n" << endl;
-                }
-            }
-        }
-        stream.clear();
-        stream.seekg(0, std::ios::beg);
+    // the GDML reader doesn't search the text for each material so there is nothing to share out
+    if(job->gdml)
+    {
+        ScanWatchdog::SetActive(&job->watchdog);
+        ReadGdml(job, options);
+        ScanWatchdog::SetActive(NULL);
+        job->writeSnapshot = (options->snapDirName!="")&&(job->snapFileName!="");
+        FinishJob(job, options, writeQueue);
+        inFlight->Pop(slot);
+        return;
     }
 
-    for(int i=0; i<int(isoObjectNameList.size()); i++)
-    {
-        if(FindConstructor(stream, isoObjectNameList[i], isoNameList, isoTempVec, "Isotope"))
-        {
-            ExtractString(stream, ',', 0);
-            stream.get();
+    // the statement index already holds only the material section and the symbols
+    ScanWatchdog::SetActive(&job->watchdog);
+    if(job->indexed)
+        original.str(job->streamH.str());
+    else
+        CropMaterialSection(job->streamS, job->streamH, original);
 
-            GetAndAddIsotope(stream, isoNameList, isoTempVec, matTemp);
-        }
-        else
-        {
-            cout << "\nError: couldn't fin isotope constructor for " << isoObjectNameList[i] << endl;
-        }
-        //I changed this check and make sure it still works
-        stream.clear();
-        stream.seekg(0, std::ios::beg);
+    FindMaterialList(job->streamS, matNameList);
+    ScanWatchdog::SetActive(NULL);
+    for(int i=0; i<int(matNameList.size()); i++)
+    {
+        MaterialTask task = {matNameList[i], false, 0., -1.};
+        taskList.push_back(task);
     }
-}
 
-//GetAndAddIsotope
-//finds the isotope object, gets the isotope name,  adds it to the isoNameList along, and then it adds the material temperature to the isotope name list
-void GetAndAddIsotope(std::stringstream& stream, std::vector<string> &isoNameList, std::vector<double> &isoTempVec, double matTemp)
-{
-    std::stringstream isoName;
-    ElementNames* elementNames;
-    bool duplicate;
-    int Z;
+    MaterialResolution *resolution = new MaterialResolution(job->streamS.str(), original.str(), taskList, scheduler->GetNumWorkers(), &job->watchdog);
+    job->streamS.str("");
+    job->streamH.str("");
 
-    isoName << ExtractString(stream, ',', int(numbers));
+    resolution->Start(*scheduler, worker, [job, options, resolution, writeQueue, inFlight](int)
+    {
+        int slot;
+        resolution->Drain(job->isoTable);
+        delete resolution;
+
+        job->writeSnapshot = (options->snapDirName!="")&&(job->snapFileName!="");
+        FinishJob(job, options, writeQueue);
+        inFlight->Pop(slot);
+    });
+}
 
-    stream.get();
-    isoName >> Z;
-    isoName.clear();
-    isoName << '_';
+//FinishJob
+//replaces the geometry data of the job with its macrofile data and passes it on to the writer
+void FinishJob(GeoJob *job, RunOptions *options, BoundedQueue<GeoJob*> *writeQueue)
+{
+    // replaces the contents of the source stream with the macrofile data
+    job->streamS.str("");
+    job->streamS.clear();
+    job->streamH.str("");
+
+    // a geometry that its parsing gave up on is missing materials, it is only passed on so the writer keeps its place in the bundle
+    if(job->watchdog.HasTripped())
+    {
+        cout << "\nError: skipped " << job->geoFileSourceName << ((job->geoFileHeaderName!="") ? " and "+job->geoFileHeaderName : "")
+             << ", its parsing " << job->watchdog.GetReason() << " (" << job->watchdog.GetSteps() << " steps, "
+             << job->watchdog.GetSeconds() << " s)" << endl;
+        options->numFailed++;
+        job->writeSnapshot=false;
+        writeQueue->Push(job);
+        return;
+    }
 
-    isoName << (ExtractString(stream, ',', int(numbers))).c_str();
+    // generates the name for the macrofile based off the given source file name and the output directory
+    job->macroFileName = CreateMacroName(job->geoFileSourceName, options->outDirName);
+    string baseName = job->macroFileName.substr(0, job->macroFileName.length()-4);
 
-    isoName << "_" << elementNames->GetName(Z);
-    duplicate=false;
-    for(int j=0; j<int(isoNameList.size()); j++)
+    // the snapshot keeps the whole isotope list, only the macrofile leaves out the isotopes that are already broadened and the ones
+    // that are too sparse to matter
+    IsotopeTable missing;
+    const IsotopeTable *macroTable = &job->isoTable;
+    if((options->doneIndex!=NULL)||(options->minDensity>=0.))
     {
-        if(isoNameList[j]==isoName.str())
+        missing = job->isoTable;
+        std::vector<bool> keep(missing.GetSize()), minor(missing.GetSize(), false);
+        for(int i=0; i<missing.GetSize(); i++)
         {
-            if(isoTempVec[j]==matTemp)
+            keep[i] = (options->doneIndex==NULL)||!options->doneIndex->Contains(StringPool::GetName(missing.GetLabel(i)), missing.GetTemperature(i));
+            if(!keep[i])
             {
-                duplicate=true;
+                options->numSkipped++;
+            }
+            else if((missing.GetNumDensity(i)>=0.)&&(missing.GetNumDensity(i)<options->minDensity))
+            {
+                keep[i]=false;
+                minor[i]=true;
+                options->numMinor++;
             }
         }
+        if(options->writeMinor)
+        {
+            IsotopeTable minorTable = missing;
+            minorTable.Select(minor);
+            options->numNoSource += WriteMacroData(job->minorStream, minorTable, options->sourceIndex);
+            job->minorFileName = baseName+"Minor.txt";
+        }
+        missing.Select(keep);
+        macroTable = &missing;
     }
-    if(!duplicate)
-    {
-        isoNameList.push_back(isoName.str());
-        isoTempVec.push_back(matTemp);
-    }
-    isoName.str("");
-    isoName.clear();
-}
 
-//CreateMacroName
-//Generates the name for the macro file based off the geometry file name and the output directory
-string CreateMacroName(string geoFileName, string outDirName)
-{
-    if((geoFileName.substr(geoFileName.length()-3,3))==".cc")
+    // the last run's list comes from its state file, or from its macrofile when it was made without --delta
+    if(options->delta)
     {
-        geoFileName=geoFileName.substr(0,geoFileName.length()-3);
+        IsotopeTable previous, added, removed;
+        job->stateFileName = baseName+".state";
+        job->removedFileName = baseName+"Removed.txt";
+        if(!ReadMacroIsotopes(job->stateFileName, previous))
+            ReadMacroIsotopes(job->macroFileName, previous);
+
+        DiffMacroIsotopes(previous, *macroTable, added, removed);
+        options->numAdded += added.GetSize();
+        options->numRemoved += removed.GetSize();
+        options->numNoSource += WriteMacroData(job->streamS, added, options->sourceIndex);
+
+        // both lists start with their number of isotopes
+        job->removedStream << removed.GetSize() << '\n';
+        removed.Emit(job->removedStream);
+        job->stateStream << macroTable->GetSize() << '\n';
+        macroTable->Emit(job->stateStream);
     }
-    size_t pos = geoFileName.find_last_of('/');
-    size_t pos2 = std::string::npos;
-    if(pos == std::string::npos)
-        pos=0;
     else
-        pos++;
-
-    if(geoFileName.length()>11)
     {
-        string test = geoFileName.substr(geoFileName.length()-11, 11);
-        if((test=="Constructor")||(test=="constructor"))
-        {
-            pos2 = geoFileName.length()-11;
-        }
+        options->numNoSource += WriteMacroData(job->streamS, *macroTable, options->sourceIndex);
     }
 
-    return (outDirName+"DoppBroadMacro"+geoFileName.substr(pos, pos2-pos)+".txt");
+    // passes the finished macrofile data on to the writer
+    writeQueue->Push(job);
 }
 
-//SetDataStream
-//opens the file with the given name and stores the information contianed by the data stream inside of it
-void SetDataStream( string macroFileName, std::stringstream& ss)
+//WriteStage
+//last stage of the conversion pipeline, stores the information contained in each parsed job into its macrofile
+void WriteStage(BoundedQueue<GeoJob*> *writeQueue, RunOptions *options)
 {
-  std::ofstream out( macroFileName.c_str() , std::ios::out | std::ios::trunc );
-  if ( ss.good() )
-  {
-     ss.seekg( 0 , std::ios::end );
-     int file_size = ss.tellg();
-     ss.seekg( 0 , std::ios::beg );
-     char* filedata = new char[ file_size ];
-
-     while ( ss )
-     {
-        ss.read( filedata , file_size );
-        if(!file_size)
-        {
-            cout << "\n #### Error the size of the stringstream is invalid ###" << endl;
-            break;
-        }
-     }
+    GeoJob *job;
+    // geometries converted on several threads can finish out of order, they are held here until it is their turn in the bundle
+    std::map<int, GeoJob*> waiting;
+    int nextIndex=0;
 
-     out.write(filedata, file_size);
-     if (out.fail())
+    while(writeQueue->Pop(job))
     {
-        cout << endl << "writing the ascii data to the output file " << macroFileName << " failed" << endl
-             << " may not have permission to delete an older version of the file" << endl;
+        // the macrofiles keep the names they would have in the output directory inside of the bundle
+        if(options->outBundle!=NULL)
+        {
+            waiting[job->jobIndex] = job;
+            while((!waiting.empty())&&(waiting.begin()->first==nextIndex))
+            {
+                job = waiting.begin()->second;
+                waiting.erase(waiting.begin());
+                nextIndex++;
+
+                if(job->watchdog.HasTripped())
+                {
+                    delete job;
+                    continue;
+                }
+                if(!options->outBundle->Add(job->macroFileName.substr(options->outDirName.length()), job->streamS.str(), int64_t(time(NULL))))
+                    cout << "\nError: could not add " << job->macroFileName << " to the bundle" << endl;
+                if((job->minorFileName!="")&&!options->outBundle->Add(job->minorFileName.substr(options->outDirName.length()), job->minorStream.str(), int64_t(time(NULL))))
+                    cout << "\nError: could not add " << job->minorFileName << " to the bundle" << endl;
+                if((job->removedFileName!="")&&!options->outBundle->Add(job->removedFileName.substr(options->outDirName.length()), job->removedStream.str(), int64_t(time(NULL))))
+                    cout << "\nError: could not add " << job->removedFileName << " to the bundle" << endl;
+                // the state has to outlast the bundle, which is made anew each run
+                if(job->stateFileName!="")
+                    SetDataStream(job->stateFileName, job->stateStream);
+                if(job->writeSnapshot)
+                    GeoSnapshot::Write(job->snapFileName, job->isoTable, job->stamp);
+                delete job;
+            }
+            continue;
+        }
+
+        if(job->watchdog.HasTripped())
+        {
+            delete job;
+            continue;
+        }
+        SetDataStream(job->macroFileName, job->streamS);
+        if(job->minorFileName!="")
+            SetDataStream(job->minorFileName, job->minorStream);
+        if(job->removedFileName!="")
+            SetDataStream(job->removedFileName, job->removedStream);
+        // the state is written after the delta macrofile that it goes with
+        if(job->stateFileName!="")
+            SetDataStream(job->stateFileName, job->stateStream);
+        if(job->writeSnapshot)
+            GeoSnapshot::Write(job->snapFileName, job->isoTable, job->stamp);
+        delete job;
     }
-     out.close();
-     delete [] filedata;
-  }
-  else
-  {
-// found no data file
-//                 set error bit to the stream
-     ss.setstate( std::ios::badbit );
-
-     cout << endl << "### failed to write to ascii file " << macroFileName << " ###" << endl;
-  }
-   ss.str("");
 }
@@ -0,0 +1,29 @@
+# Generates the synthetic training corpus and converts every geometry in it with the macro creator.
+# Run by the pgo-train target with HARNESS, CREATOR, CORPUS_DIR, GEOMETRIES and MATERIALS set.
+
+file(REMOVE_RECURSE ${CORPUS_DIR})
+file(MAKE_DIRECTORY ${CORPUS_DIR}/macros)
+
+execute_process(COMMAND ${HARNESS} generate ${CORPUS_DIR} ${GEOMETRIES} ${MATERIALS} 1
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Generating the training corpus failed")
+endif()
+
+file(GLOB sources ${CORPUS_DIR}/*.cc)
+list(SORT sources)
+set(pairs "")
+foreach(source ${sources})
+    string(REGEX REPLACE "\\.cc$" ".hh" header ${source})
+    list(APPEND pairs ${source} ${header})
+endforeach()
+
+execute_process(COMMAND ${CREATOR} ${CORPUS_DIR}/macros/ ${pairs}
+                OUTPUT_QUIET
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Converting the training corpus failed")
+endif()
+
+# the differential harness is trained as well since it runs the same parser
+execute_process(COMMAND ${HARNESS} record ${CORPUS_DIR} OUTPUT_QUIET)
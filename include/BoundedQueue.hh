@@ -0,0 +1,63 @@
+#ifndef BoundedQueue_HH
+#define BoundedQueue_HH
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// BoundedQueue
+// a fixed capacity first in first out queue used to pass work between the stages of the conversion pipeline
+// Push() blocks while the queue is full so that a fast stage can never get more than capacity items ahead of a slow one
+// once Close() has been called Pop() drains the remaining items and then returns false
+template <class T>
+class BoundedQueue
+{
+    public:
+        BoundedQueue(int maxSize)
+        {
+            capacity = (maxSize>0) ? maxSize : 1;
+            closed = false;
+        }
+        virtual ~BoundedQueue() {}
+
+        bool Push(const T &item)
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            notFull.wait(lock, [this]{ return (closed||(int(items.size())<capacity)); });
+            if(closed)
+                return false;
+            items.push_back(item);
+            notEmpty.notify_one();
+            return true;
+        }
+
+        bool Pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            notEmpty.wait(lock, [this]{ return (closed||!items.empty()); });
+            if(items.empty())
+                return false;
+            item = items.front();
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            closed = true;
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+    protected:
+    private:
+        std::deque<T> items;
+        int capacity;
+        bool closed;
+        std::mutex queueMutex;
+        std::condition_variable notEmpty, notFull;
+};
+
+#endif // BoundedQueue_HH
@@ -0,0 +1,46 @@
+#ifndef CSDataIndex_HH
+#define CSDataIndex_HH
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+using namespace std;
+
+// one temperature that an isotope has cross section data for and where that data is
+struct CSDataFile
+{
+    double temperature;
+    string path;
+};
+
+// CSDataIndex
+// the temperatures that each isotope has cross section files for in a CS data directory, the directory is walked through once
+// and the temperatures of each isotope are kept sorted so that an exact or closest temperature is found with a binary search
+// every file named after an isotope the way G4NDL names them (Z_A_ElementName, optionally compressed with a .z ending) is indexed
+// under the temperature given at the end of its name (Z_A_ElementName_600K) or, failing that, by the closest directory above it
+// that is named after a temperature (600K/Elastic/CrossSection/Z_A_ElementName), its path is the file in the first case and the
+// temperature directory in the second, since that is the directory the broadening code reads the isotope's data from
+// files that have no temperature in their name or path are given the default temperature of the scan or skipped if it has none
+class CSDataIndex
+{
+    public:
+        CSDataIndex();
+        virtual ~CSDataIndex();
+        bool Scan(string dirName, double defaultTemp=-1.);
+        bool Contains(const string &label, double temperature) const;
+        const CSDataFile* FindClosest(const string &label, double temperature) const;
+        int GetSize() const
+        {
+            return numFiles;
+        }
+    protected:
+        void ScanDir(const string &dirName, const string &tempDirName, double dirTemp, int depth);
+        void AddFile(const string &dirName, string fileName, const string &tempDirName, double dirTemp);
+        static bool ParseTemperature(const string &text, double &temperature);
+    private:
+        // the files of each isotope by macrofile label, sorted by temperature
+        std::unordered_map<string, std::vector<CSDataFile> > isotopes;
+        int numFiles;
+};
+
+#endif // CSDataIndex_HH
@@ -0,0 +1,69 @@
+#ifndef CompressedInput_HH
+#define CompressedInput_HH
+
+#include <string>
+#include <istream>
+#include <streambuf>
+#include <cstdio>
+using namespace std;
+
+enum CompressionType {uncompressed=0, gzipCompressed, zstdCompressed};
+
+// CompressedInput
+// input stream over a geometry file that is either plain text or compressed with gzip or zstd, the compression is detected from the
+// magic bytes at the start of the file and not from its name, the data is decompressed a chunk at a time as it is read so a
+// compressed file never has to be extracted to disk first
+// gzip support needs zlib and zstd support needs libzstd at build time, without them reading such a file fails with an error message
+class CompressedInput : public std::istream
+{
+    public:
+        CompressedInput(string fileName);
+        virtual ~CompressedInput();
+        bool IsOpen()
+        {
+            return buffer.IsOpen();
+        }
+        CompressionType GetType()
+        {
+            return buffer.GetType();
+        }
+        static CompressionType DetectType(string fileName);
+        static bool IsSupported(CompressionType type);
+        static string StripExtension(string fileName);
+    protected:
+        // stream buffer that refills itself with the next decompressed chunk of the file
+        class DecompressBuf : public std::streambuf
+        {
+            public:
+                DecompressBuf();
+                virtual ~DecompressBuf();
+                bool Open(string fileName);
+                void Close();
+                bool IsOpen()
+                {
+                    return (file!=NULL);
+                }
+                CompressionType GetType()
+                {
+                    return type;
+                }
+            protected:
+                virtual int_type underflow();
+                long Decompress();
+                bool FillInput();
+            private:
+                FILE *file;
+                CompressionType type;
+                char *inBuf, *outBuf;
+                size_t inPos, inSize;
+                bool inputDone, streamDone;
+                // true while a gzip member has been started but its end hasn't been read
+                bool memberOpen;
+                // the zlib or zstd decompression state
+                void *state;
+        };
+    private:
+        DecompressBuf buffer;
+};
+
+#endif // CompressedInput_HH
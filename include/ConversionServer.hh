@@ -0,0 +1,76 @@
+#ifndef ConversionServer_HH
+#define ConversionServer_HH
+
+#include <string>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <csignal>
+#include <sys/types.h>
+#include "Preprocessor.hh"
+#include "IsotopeTable.hh"
+using namespace std;
+
+// the number of geometries whose isotope lists are kept by a server before the least recently used one is dropped
+const int defaultServerCacheSize = 4096;
+
+// the size, modification time and inode of the geometry files a cached isotope list was made from, all zero for inline text
+struct ServerStamp
+{
+    int64_t sourceSize, headerSize, sourceTime, headerTime;
+    uint64_t sourceInode, headerInode;
+};
+
+// ConversionServer
+// keeps the converter running behind a Unix domain socket so that a build system can ask for the isotope list of a geometry without
+// starting a new process, loading the element names and parsing the files every time
+// each request is one line of JSON, either {"source": "<file>.cc", "header": "<file>.hh"} with the paths of the geometry files or
+// {"sourceText": "...", "headerText": "..."} with their contents, an optional "id" is copied into the response
+// each response is one line of JSON, {"id": ..., "ok": true, "cached": false, "seconds": ..., "isotopes": [{"label": ..., "Z": ...,
+// "A": ..., "temperature": ..., "material": ...}, ...]} in the order of the macrofile, or {"id": ..., "ok": false, "error": "..."}
+// {"command": "stats"} returns the request and cache counts and {"command": "shutdown"} stops the server
+// connections are served by a fixed number of worker threads and can send any number of requests one after the other, the isotope
+// lists are cached by file path (checked against the file's stamp on every request) or by a hash of the inline text
+class ConversionServer
+{
+    public:
+        ConversionServer(Preprocessor *preprocessor, bool streaming, int cacheSize=defaultServerCacheSize);
+        virtual ~ConversionServer();
+        bool Run(string socketName, int numWorkers);
+        static void RequestStop()
+        {
+            stopRequested=1;
+        }
+    protected:
+        struct CacheEntry
+        {
+            string key;
+            ServerStamp stamp;
+            // the isotope list already written out as a JSON array
+            string isotopes;
+        };
+
+        void ServeConnection(int connection);
+        string HandleRequest(const string &line);
+        bool Convert(std::map<string,string> &fields, ServerStamp &stamp, string &isotopes, string &error);
+        bool FindCached(const string &key, const ServerStamp &stamp, string &isotopes);
+        void StoreCached(const string &key, const ServerStamp &stamp, const string &isotopes);
+        static bool ParseRequest(const string &line, std::map<string,string> &fields, string &id);
+        static bool MakeServerStamp(string sourceName, string headerName, ServerStamp &stamp);
+        static string IsotopesToJson(const IsotopeTable &isoTable);
+    private:
+        Preprocessor *preprocessor;
+        bool streaming;
+        int cacheSize;
+        // the preprocessor keeps the files it has included, so only one request can use it at a time
+        std::mutex preprocessMutex, cacheMutex;
+        // the cached isotope lists with the most recently used one first
+        std::list<CacheEntry> cacheOrder;
+        std::unordered_map<string, std::list<CacheEntry>::iterator> cacheIndex;
+        std::atomic<long> numRequests, numHits, numErrors;
+        static volatile sig_atomic_t stopRequested;
+};
+
+#endif // ConversionServer_HH
@@ -0,0 +1,100 @@
+#ifndef GdmlReader_HH
+#define GdmlReader_HH
+
+#include <string>
+#include <istream>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "StringPool.hh"
+#include "IsotopeTable.hh"
+using namespace std;
+
+// one entry of an element or material, the isotope, element or material it refers to and its share (an atom or mass fraction,
+// or a number of atoms)
+struct GdmlComponent
+{
+    string ref;
+    double amount;
+};
+
+// an <isotope>, its molar mass is in g/mole and negative when it isn't given
+struct GdmlIsotope
+{
+    int Z, N;
+    double molarMass;
+};
+
+// an <element>, made either from the isotopes it lists or, when it lists none, from its Z and molar mass
+struct GdmlElement
+{
+    int Z;
+    double molarMass;
+    std::vector<GdmlComponent> isotopes;
+};
+
+// a <material>, made either from the elements and materials it lists or, when it lists none, from its Z and molar mass
+// the temperature is in kelvin and the density in g/cm3, they are negative when they aren't given
+struct GdmlMaterial
+{
+    int Z;
+    double molarMass, temperature, density;
+    // the components are given as numbers of atoms (<composite>) instead of mass fractions (<fraction>)
+    bool byAtoms;
+    std::vector<GdmlComponent> components;
+};
+
+// GdmlReader
+// streaming reader for the isotopes and temperatures of a geometry exported as GDML, it fills the same isotope table as the
+// parser of the G4Stork constructors does
+// the file is read a chunk at a time by a SAX style scanner that hands each tag to the reader as soon as it is complete, only the
+// <isotope>, <element> and <material> definitions (along with their <T>, <D>, <atom>, <fraction> and <composite> entries), the
+// values defined in <define> and the names of the materials used by the volumes are kept, the solids and volumes themselves are
+// dropped as they are read, so the memory used depends on the number of materials and not on the size of the file
+// the materials are resolved once the whole file has been read, since GDML lets a definition refer to one that comes after it
+// external entities (<!ENTITY materials SYSTEM "materials.xml"> used as &materials;) are read from the file they name
+class GdmlReader
+{
+    public:
+        GdmlReader();
+        virtual ~GdmlReader();
+        void Clear();
+        bool ReadFile(string fileName, IsotopeTable &isoTable);
+        void Read(std::istream &in, IsotopeTable &isoTable);
+        static bool IsGdmlFile(string fileName);
+    protected:
+        enum DefinitionType {noDefinition=0, isotopeDefinition, elementDefinition, materialDefinition};
+
+        void Scan(std::istream &in, string dirName, int depth);
+        void ReadTag(const string &tag);
+        void ReadDoctype(const string &doctype);
+        void ExpandEntity(const string &name, const string &dirName, int depth);
+        void StartElement(const string &name, const std::unordered_map<string, string> &attributes);
+        void EndElement(const string &name);
+        bool ReadValue(const std::unordered_map<string, string> &attributes, string valueName, double &value);
+        bool Evaluate(const string &text, double &value);
+
+        void ResolveMaterials(IsotopeTable &isoTable);
+        void ResolveMaterial(const string &name, double temperature, double density, bool ownDensity, int depth, IsotopeTable &isoTable);
+        void AddComponent(const string &ref, double temperature, double density, int depth, IsotopeTable &isoTable);
+        void AddElement(const string &name, const GdmlElement &element, double temperature, double density, IsotopeTable &isoTable);
+        void AddSimpleElement(const string &name, int Z, double molarMass, double temperature, double density, IsotopeTable &isoTable);
+        double FindMolarMass(const string &ref);
+    private:
+        std::unordered_map<string, GdmlIsotope> isotopes;
+        std::unordered_map<string, GdmlElement> elements;
+        std::unordered_map<string, GdmlMaterial> materials;
+        // the materials in the order they are defined in, and the materials named by the volumes in the order they are first used
+        std::vector<string> materialOrder, usedOrder;
+        std::unordered_set<string> usedMaterials;
+        // the constants, variables and quantities of the <define> section, quantities are kept in the units the reader uses
+        std::unordered_map<string, double> constants;
+        // the entities declared in the DOCTYPE, either the text they stand for or the name of the file that holds it
+        std::unordered_map<string, string> entities, entityFiles;
+
+        // the definition whose entries are being read
+        DefinitionType openType;
+        string openName;
+};
+
+#endif // GdmlReader_HH
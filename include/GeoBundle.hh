@@ -0,0 +1,58 @@
+#ifndef GeoBundle_HH
+#define GeoBundle_HH
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <unordered_map>
+using namespace std;
+
+// where the data of one file is stored in a bundle
+struct BundleEntry
+{
+    string name;
+    uint64_t offset, size;
+    int64_t time;
+};
+
+// GeoBundle
+// packs many small files into one tar (ustar) file so that a large batch doesn't create thousands of files on the file system,
+// the bundle can be unpacked with any tar program, next to it an index file (the bundle name followed by .idx) lists the offset and
+// size of the data of every file so that one file can be read straight out of the bundle without going through the others
+// bundles made by other tar programs can be read as well, without a matching index the member headers are walked through once instead
+class GeoBundle
+{
+    public:
+        GeoBundle();
+        virtual ~GeoBundle();
+        bool Create(string fileName);
+        bool Add(string name, const string &data, int64_t time);
+        bool Close();
+        bool Open(string fileName);
+        bool Read(string name, string &data);
+        const BundleEntry* Find(string name);
+        const std::vector<BundleEntry>& GetEntries()
+        {
+            return entries;
+        }
+        static string IndexName(string bundleName)
+        {
+            return bundleName+".idx";
+        }
+    protected:
+        bool LoadIndex(uint64_t bundleSize);
+        bool ScanHeaders(uint64_t bundleSize);
+        bool WriteIndex();
+        void AddEntry(const BundleEntry &entry);
+    private:
+        FILE *file;
+        string fileName;
+        bool writing;
+        // the number of bytes written to the bundle so far
+        uint64_t fileOffset;
+        std::vector<BundleEntry> entries;
+        std::unordered_map<string, int> entryIndex;
+};
+
+#endif // GeoBundle_HH
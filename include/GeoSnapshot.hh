@@ -0,0 +1,36 @@
+#ifndef GeoSnapshot_HH
+#define GeoSnapshot_HH
+
+#include <string>
+#include <cstdint>
+#include "IsotopeTable.hh"
+using namespace std;
+
+// identifies the inputs a snapshot was made from, a snapshot is only reused while all of these still match
+struct SnapshotStamp
+{
+    uint64_t sourceSize, headerSize;
+    int64_t sourceTime, headerTime;
+    uint64_t settingsHash;
+};
+
+// GeoSnapshot
+// stores the resolved isotope table of a geometry, with the material each isotope came from, in a compact binary file
+// the file is laid out as fixed size columns followed by a string table so it can be mapped into memory and loaded without parsing
+// later runs load the snapshot instead of searching the geometry source again as long as the files and parse settings are unchanged
+class GeoSnapshot
+{
+    public:
+        GeoSnapshot();
+        virtual ~GeoSnapshot();
+        static bool MakeStamp(string sourceName, string headerName, string settings, SnapshotStamp &stamp);
+        static bool Write(string fileName, const IsotopeTable &isoTable, const SnapshotStamp &stamp);
+        static bool Load(string fileName, IsotopeTable &isoTable, SnapshotStamp *stamp=NULL);
+        static bool Matches(const SnapshotStamp &a, const SnapshotStamp &b);
+        static string SnapshotName(string geoFileName, string snapDirName);
+        static uint64_t HashString(const string &text);
+    protected:
+    private:
+};
+
+#endif // GeoSnapshot_HH
@@ -0,0 +1,60 @@
+#ifndef IsotopeCollector_HH
+#define IsotopeCollector_HH
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "StringPool.hh"
+#include "IsotopeTable.hh"
+using namespace std;
+
+// IsotopeCollector
+// gathers the isotopes that several worker threads find in one geometry without any locking, each worker owns a shard that
+// only it writes to so an insert never waits on another thread, shards drop repeated isotopes/temperature pairs as they go
+// every isotope carries an order key giving its position in a sequential run (the index of its material in the material list
+// and its row in that material's table), Drain() adds them to the final table in key order once the workers are done so the
+// macrofile is the same no matter how the materials were split between the threads
+class IsotopeCollector
+{
+    public:
+        IsotopeCollector(int numShards=1);
+        virtual ~IsotopeCollector();
+        void Reset(int numShards);
+        int GetNumShards()
+        {
+            return int(shards.size());
+        }
+        static uint64_t OrderKey(uint32_t matIndex, uint32_t row)
+        {
+            return (uint64_t(matIndex)<<32)|row;
+        }
+
+        void Insert(int shard, uint64_t order, int Z, double A, NameHandle label, double temperature, NameHandle material, double numDensity=-1.);
+        void Insert(int shard, uint32_t matIndex, const IsotopeTable &matTable);
+        void Drain(IsotopeTable &isoTable);
+    protected:
+        struct Entry
+        {
+            uint64_t order;
+            double A, temperature, numDensity;
+            NameHandle label, material;
+            int Z;
+        };
+
+        // the entries of one worker, padded so that two workers never write to the same cache line
+        struct Shard
+        {
+            std::vector<Entry> entries;
+            std::unordered_multimap<NameHandle, int> labelIndex;
+            char padding[64];
+        };
+
+        static bool OrderLess(const Entry &first, const Entry &second)
+        {
+            return first.order<second.order;
+        }
+    private:
+        std::vector<Shard*> shards;
+};
+
+#endif // IsotopeCollector_HH
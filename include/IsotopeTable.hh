@@ -0,0 +1,111 @@
+#ifndef IsotopeTable_HH
+#define IsotopeTable_HH
+
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <cstdint>
+#include "StringPool.hh"
+using namespace std;
+
+// IsotopeTable
+// column store of the isotope/temperature pairs found in a geometry, each isotope is one row across the Z, A, temperature,
+// source material and label columns, rows are unique by label and temperature and are kept in the order they were first added
+// the label is the Z_A_ElementName key written to the macrofile, it is kept as found in the geometry so non integer masses survive
+// the number density column holds the isotope's atoms per cm3 in the densest material that has it at the row's temperature, it is
+// negative when the density isn't known for one of those materials, since the isotope can't be ruled out as unimportant then
+class IsotopeTable
+{
+    public:
+        IsotopeTable();
+        virtual ~IsotopeTable();
+
+        bool Add(int Z, double A, NameHandle label, double temperature);
+        bool Add(int Z, double A, NameHandle label, double temperature, NameHandle material, double numDensity=-1.);
+        void SetCurrentMaterial(NameHandle material)
+        {
+            currentMaterial=material;
+        }
+        NameHandle GetCurrentMaterial() const
+        {
+            return currentMaterial;
+        }
+        void Merge(const IsotopeTable &other);
+        void Select(const std::vector<bool> &keep);
+        void Clear();
+
+        void SortByIsotope();
+        void SortByTemperature();
+        void GroupByTemperature(std::vector<int> &groupStart) const;
+        void Emit(std::ostream &out) const;
+
+        int GetSize() const
+        {
+            return int(zCol.size());
+        }
+        int GetZ(int row) const
+        {
+            return zCol[row];
+        }
+        int GetA(int row) const
+        {
+            return aCol[row];
+        }
+        double GetTemperature(int row) const
+        {
+            return tempCol[row];
+        }
+        NameHandle GetMaterial(int row) const
+        {
+            return matCol[row];
+        }
+        NameHandle GetLabel(int row) const
+        {
+            return labelCol[row];
+        }
+        double GetNumDensity(int row) const
+        {
+            return densityCol[row];
+        }
+        const std::vector<uint8_t>& GetZColumn() const
+        {
+            return zCol;
+        }
+        const std::vector<uint16_t>& GetAColumn() const
+        {
+            return aCol;
+        }
+        const std::vector<double>& GetTemperatureColumn() const
+        {
+            return tempCol;
+        }
+        const std::vector<NameHandle>& GetMaterialColumn() const
+        {
+            return matCol;
+        }
+        const std::vector<NameHandle>& GetLabelColumn() const
+        {
+            return labelCol;
+        }
+        const std::vector<double>& GetNumDensityColumn() const
+        {
+            return densityCol;
+        }
+        static double CombineDensity(double numDensity1, double numDensity2)
+        {
+            return (((numDensity1<0.)||(numDensity2<0.)) ? -1. : ((numDensity1>numDensity2) ? numDensity1 : numDensity2));
+        }
+    protected:
+        void Permute(const std::vector<int> &order);
+        void RebuildIndex();
+    private:
+        std::vector<uint8_t> zCol;
+        std::vector<uint16_t> aCol;
+        std::vector<double> tempCol, densityCol;
+        std::vector<NameHandle> matCol, labelCol;
+        // maps a label to the rows that use it, a label only appears at a few temperatures so the duplicate check is constant time
+        std::unordered_multimap<NameHandle, int> labelIndex;
+        NameHandle currentMaterial;
+};
+
+#endif // IsotopeTable_HH
@@ -0,0 +1,87 @@
+#ifndef MacroCreator_HH
+#define MacroCreator_HH
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include "StringPool.hh"
+#include "IsotopeTable.hh"
+using namespace std;
+
+class CSDataIndex;
+
+// free functions that extract the isotopes and temperatures used in a G4Stork geometry and turn them into a DoppBroad macrofile
+// these are shared by the macro creator and the tools that are built around it
+
+// add header file to the original string stream
+// use findDouble() when determining if the constructor is a single isotope or not
+
+enum  OutFilter {characters=1, numbers, NA, symbols};
+
+// one material of the material list, the materials that are only used through AddMaterial() are nested and inherit the temperature
+// of the material they were added to
+// the density of a nested material is the share of the density of the material it was added to, in g/cm3 and negative if unknown
+struct MaterialTask
+{
+    NameHandle name;
+    bool nested;
+    double temperature;
+    double density;
+};
+
+// where one of the walks that MovePastWord() makes through the text has got to, along with the last token the walk read
+struct SearchWalk
+{
+    int pos;
+    std::ios::iostate state;
+    string lastToken;
+};
+
+void GetDataStream( string, std::stringstream&);
+
+void FormatData(std::stringstream& streamS, std::stringstream& streamH);
+void GetGeoIsotopes(std::stringstream& streamS, std::stringstream& streamH, IsotopeTable &isoTable, int numThreads=1);
+void CropMaterialSection(std::stringstream& streamS, std::stringstream& streamH, std::stringstream& original);
+int FindSectionEnd(const string &text, int pos);
+void ResolveIsotopes(std::stringstream& stream, std::stringstream& original, IsotopeTable &isoTable, int numThreads=1);
+int WriteMacroData(std::stringstream& stream, const IsotopeTable &isoTable, const CSDataIndex *sourceIndex=NULL);
+bool ReadMacroIsotopes(string macroFileName, IsotopeTable &isoTable);
+void DiffMacroIsotopes(const IsotopeTable &previous, const IsotopeTable &current, IsotopeTable &added, IsotopeTable &removed);
+string MacroKey(NameHandle label, double temperature);
+bool MovePastWord(std::stringstream& stream, string word);
+bool SearchStep(std::stringstream& stream, const std::vector<string> &wordParts, bool exact, string &wholeWord, SearchWalk &tokenWalk, bool &partStart);
+void SaveWalk(std::stringstream& stream, SearchWalk &walk, const string &lastToken);
+void LoadWalk(std::stringstream& stream, const SearchWalk &walk);
+bool SameWalk(const SearchWalk &walk1, const SearchWalk &walk2);
+string ExtractString(std::stringstream &stream, char delim, int outType=7);
+void CropStream(std::stringstream& stream, int firstChar, int lastChar=0);
+void FindMaterialList(std::stringstream& stream, std::vector<NameHandle> &matNameList);
+void GetIsotopeList(std::stringstream& stream, std::vector<NameHandle> &matNameList, IsotopeTable &isoTable, std::stringstream &original, int numThreads=1);
+void ResolveMaterial(std::stringstream& stream, std::stringstream &original, const MaterialTask &task, IsotopeTable &isoTable, std::vector<MaterialTask> &nestedList);
+void ResolveMaterialsParallel(std::stringstream& stream, std::stringstream &original, const std::vector<MaterialTask> &taskList, IsotopeTable &isoTable, int numThreads);
+bool FindConstructor(std::stringstream& stream, string name, IsotopeTable &isoTable, string matType, double matTemp=0, std::stringstream *original=NULL, bool matSet=false, double density=-1.);
+double FindMatTemp(std::stringstream& stream, string matName, bool normal, std::stringstream *original=NULL);
+int FindElementList(std::stringstream& stream, string matName, std::vector<NameHandle> &matNameList, std::vector<NameHandle> &elemNameList, IsotopeTable &isoTable, double matTemp,
+                    std::vector<string> &matAmounts, std::vector<string> &elemAmounts);
+void FindIsotopeList(std::stringstream& stream, string elemName, std::vector<NameHandle> &elemNameList, IsotopeTable &isoTable, double matTemp,
+                     double density=-1., std::stringstream *original=NULL);
+bool findDouble(std::stringstream *stream, string variable, double &temperature, int depth=0);
+void GetAndAddIsotope(std::stringstream& stream, IsotopeTable &isoTable, double matTemp, bool natural=false, double density=-1.);
+int ReadIsotope(std::stringstream& stream, string &isoName, string &massNum);
+void AddIsotopeLabel(IsotopeTable &isoTable, int Z, string isoName, string massNum, double matTemp, double numDensity=-1.);
+void AddNistIsotopes(const string &statement, string name, IsotopeTable &isoTable, double matTemp, double density=-1., bool ownDensity=false,
+                     std::stringstream *original=NULL);
+bool AddNaturalIsotopes(IsotopeTable &isoTable, int Z, double matTemp, double density=-1.);
+double NumberDensity(double density, double molarMass);
+void FindElementDensities(std::stringstream& stream, double matDensity, const std::vector<NameHandle> &elemNameList, const std::vector<string> &amountList,
+                          std::vector<double> &densityList, std::stringstream *original);
+double FindMolarMass(std::stringstream& stream, string elemName, std::stringstream *original);
+double ReadDensity(std::stringstream& stream, int skip, std::stringstream *original);
+char ReadArgument(std::stringstream& stream, string &argument);
+void SplitArguments(const string &statement, std::vector<string> &args);
+bool ReadQuantity(string text, std::stringstream *original, double &value, int depth=0);
+
+string CreateMacroName(string geoFileName, string outDirName);
+void SetDataStream( string, std::stringstream&);
+
+#endif // MacroCreator_HH
@@ -0,0 +1,52 @@
+#ifndef MaterialResolution_HH
+#define MaterialResolution_HH
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "MacroCreator.hh"
+#include "IsotopeCollector.hh"
+#include "TaskScheduler.hh"
+using namespace std;
+
+class ScanFilter;
+class ScanWatchdog;
+
+// MaterialResolution
+// resolves the materials of one geometry as tasks of a TaskScheduler, one task per material so that the materials of a large geometry
+// can be stolen by the workers that have run out of work, the materials found through AddMaterial() are resolved in a wave after
+// the materials they were added to so that they get the same place in the material list as they do in GetIsotopeList()
+// each worker searches its own copy of the material and symbol text and adds the isotopes to its own shard of the collector
+// the done function is run on the worker that finishes the last material, after that Drain() gives the isotopes in sequential order
+// the workers count their scanning steps against the watchdog of the geometry when it has one
+class MaterialResolution
+{
+    public:
+        MaterialResolution(const string &matText, const string &originalText, const std::vector<MaterialTask> &tasks, int numWorkers,
+                           ScanWatchdog *watchdog=NULL);
+        virtual ~MaterialResolution();
+        void Start(TaskScheduler &scheduler, int worker, std::function<void(int)> done);
+        void Drain(IsotopeTable &isoTable);
+    protected:
+        void StartWave(int worker);
+        void RunMaterial(int worker, uint32_t index);
+    private:
+        string matText, originalText;
+        // shared by the copies of the text on every worker
+        std::shared_ptr<const ScanFilter> matFilter, originalFilter;
+        std::vector<MaterialTask> taskList;
+        std::vector< std::vector<MaterialTask> > nestedLists;
+        uint32_t waveStart, waveEnd;
+        std::atomic<int> numRemaining;
+
+        IsotopeCollector collector;
+        TaskScheduler *scheduler;
+        ScanWatchdog *watchdog;
+        std::function<void(int)> onDone;
+        // identifies the resolution in the per-thread copies of the text
+        long id;
+};
+
+#endif // MaterialResolution_HH
@@ -0,0 +1,61 @@
+#ifndef NistTable_HH
+#define NistTable_HH
+
+#include <string>
+#include <vector>
+using namespace std;
+
+// the largest number of elements in one material of the table
+const int maxNistComponents = 16;
+
+// one naturally occuring isotope of an element and its share of the element's atoms
+struct NistIsotope
+{
+    int Z, A;
+    double abundance;
+};
+
+// an element of the table, density is the density of the element's own NIST material (G4_<symbol>) in g/cm3
+struct NistElement
+{
+    int Z;
+    const char *symbol;
+    double atomicWeight, density;
+};
+
+// one element of a material and either its number of atoms in a molecule or its mass fraction
+struct NistComponent
+{
+    int Z;
+    double fraction;
+};
+
+// a compound or mixture of the table, the list of components ends at the first one with a Z of 0
+struct NistMaterial
+{
+    const char *name;
+    double density;
+    bool byAtoms;
+    NistComponent components[maxNistComponents];
+};
+
+// NistTable
+// the compositions of the elements and materials that G4NistManager builds, so that the isotopes of materials made with
+// FindOrBuildMaterial("G4_WATER") or FindOrBuildElement("H") can be listed without a Geant4 installation
+// the elements carry their natural isotopic abundances and the materials their densities and the share of each element,
+// the single element materials (G4_Fe, G4_U, ...) are made from the element table
+// the data is compiled into the program as constant tables, the hash maps that find an entry by its name are made on first use
+class NistTable
+{
+    public:
+        NistTable();
+        virtual ~NistTable();
+        static const NistElement* FindElement(const string &symbol);
+        static const NistElement* FindElement(int Z);
+        static const NistIsotope* GetIsotopes(int Z, int &numIsotopes);
+        static bool GetComposition(const string &materialName, std::vector<NistComponent> &massFractions, double &density);
+    protected:
+    private:
+};
+
+#endif // NistTable_HH
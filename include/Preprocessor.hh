@@ -0,0 +1,46 @@
+#ifndef Preprocessor_HH
+#define Preprocessor_HH
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+using namespace std;
+
+// Preprocessor
+// a minimal C preprocessor that is run over the geometry files before they are searched for materials
+// it follows quoted #includes through the including file's directory and the include paths, expands object-like #defines
+// and drops the lines of inactive #if/#ifdef/#ifndef/#elif/#else branches, function-like macros and system includes are left alone
+// every file that gets included is read and split into lines only once per run no matter how many geometries include it
+class Preprocessor
+{
+    public:
+        Preprocessor();
+        virtual ~Preprocessor();
+        void AddIncludePath(string dirName);
+        void Define(string name, string value="1");
+        void Expand(std::stringstream &stream, string fileName);
+        int GetNumCachedFiles()
+        {
+            return int(fileCache.size());
+        }
+    protected:
+        struct CondState
+        {
+            bool parentActive, taken, active;
+        };
+
+        const std::vector<string>* LoadFile(string fileName);
+        bool ResolveInclude(string name, string currentDir, string &path);
+        void ExpandLines(const std::vector<string> &lines, string fileName, std::map<string,string> &macros, std::stringstream &out, int depth);
+        string ExpandMacros(const string &line, std::map<string,string> &macros, std::set<string> &active);
+        long EvalCondition(string expr, std::map<string,string> &macros);
+        static void SplitLines(const string &text, std::vector<string> &lines);
+    private:
+        std::vector<string> includePaths;
+        std::map<string,string> predefined;
+        std::map<string, std::vector<string>*> fileCache;
+};
+
+#endif // Preprocessor_HH
@@ -0,0 +1,75 @@
+#ifndef ProvenanceReport_HH
+#define ProvenanceReport_HH
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include "StringPool.hh"
+#include "StatementIndex.hh"
+using namespace std;
+
+// ProvenanceReport
+// records for every material of every converted geometry the time spent resolving it, the number of stream scans (MovePastWord calls)
+// and variable lookups (findDouble calls) it caused, the source lines its definitions were found on and the isotopes it contributed
+// the parser reports to the report that is active on its thread through the static hooks, they do nothing when no report is active
+class ProvenanceReport
+{
+    public:
+        ProvenanceReport();
+        virtual ~ProvenanceReport();
+
+        void BeginGeometry(string sourceName, string headerName, bool fromSnapshot=false);
+        void EndGeometry();
+        bool Write(string fileName);
+
+        static void SetActive(ProvenanceReport *report);
+        static bool IsActive()
+        {
+            return (active!=NULL);
+        }
+        static void BeginMaterial(NameHandle material, bool nested);
+        static void EndMaterial();
+        static void MapLines(std::stringstream &stream, const std::vector<LineMark> &marks);
+        static void CountScan(std::stringstream &stream, bool found);
+        static void CountLookup();
+        static void AddIsotope(NameHandle label, double temperature);
+        static void WriteString(std::ostream &out, const string &text);
+    protected:
+        struct MaterialRecord
+        {
+            NameHandle name;
+            bool nested;
+            double seconds;
+            long scans, lookups;
+            std::vector<long> lines;
+            std::vector<NameHandle> isoLabels;
+            std::vector<double> isoTemps;
+        };
+
+        struct GeometryRecord
+        {
+            string sourceName, headerName;
+            bool fromSnapshot;
+            double seconds;
+            long scans, lookups;
+            std::vector<MaterialRecord> materials;
+        };
+
+        long SourceLine(long offset);
+        static void WriteLineRanges(std::ostream &out, std::vector<long> lines);
+    private:
+        static thread_local ProvenanceReport *active;
+
+        std::vector<GeometryRecord> geometries;
+        // the index of the material being resolved in the last geometry, -1 in between materials
+        int current;
+        std::chrono::steady_clock::time_point geoStart, matStart;
+
+        // the stream that the material definitions are searched in and how its offsets map to the lines of the source file
+        std::stringstream *matStream;
+        std::vector<long> lineStarts;
+        std::vector<LineMark> lineMarks;
+};
+
+#endif // ProvenanceReport_HH
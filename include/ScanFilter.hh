@@ -0,0 +1,52 @@
+#ifndef ScanFilter_HH
+#define ScanFilter_HH
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+#include <cstdint>
+using namespace std;
+
+// ScanFilter
+// lets MovePastWord() turn down a search that can't succeed without walking through the text
+// the filter is a Bloom filter of the three letter sequences of the text, along with exact sets of its letters and letter pairs,
+// a first word part that has a sequence the text doesn't have can't be matched exactly or by the start or end of a token
+// a filter is attached to a stream for as long as the stream holds the text it was made from, each thread keeps its own attachments
+// and with them a negative cache of the words that were already searched for without success, so the same failed search for
+// an undefined temperature variable or constructor is only made once per starting position
+class ScanFilter
+{
+    public:
+        ScanFilter(const string &text);
+        virtual ~ScanFilter();
+        bool MayContain(const string &part) const;
+
+        static void Attach(std::stringstream &stream, std::shared_ptr<const ScanFilter> filter);
+        static void Detach(std::stringstream &stream);
+        static bool RulesOut(std::stringstream &stream, int start, const string &word, const std::vector<string> &wordParts);
+        static void AddMiss(std::stringstream &stream, int start, const string &word);
+    protected:
+        struct Attachment
+        {
+            std::stringstream *stream;
+            std::shared_ptr<const ScanFilter> filter;
+            // the searches that failed, as the word followed by the position they started from
+            std::unordered_set<string> misses;
+        };
+
+        static Attachment* FindAttachment(std::stringstream &stream);
+        static string MissKey(int start, const string &word);
+        void AddTriple(uint32_t triple);
+        bool HasTriple(uint32_t triple) const;
+    private:
+        std::vector<uint64_t> tripleBits;
+        uint64_t tripleMask;
+        uint64_t pairBits[1024];
+        uint64_t letterBits[4];
+        // a thread only searches a couple of streams at once so the attachments are kept in a short list
+        static thread_local std::vector<Attachment> attachments;
+};
+
+#endif // ScanFilter_HH
@@ -0,0 +1,66 @@
+#ifndef ScanWatchdog_HH
+#define ScanWatchdog_HH
+
+#include <string>
+#include <istream>
+#include <atomic>
+#include <chrono>
+using namespace std;
+
+// ScanWatchdog
+// step and time budget for the parsing of one geometry, so that an input that the scanning loops can't get through only stops that
+// geometry instead of holding up the whole batch
+// the scanning primitives count their steps through the static hooks, which use the watchdog that is active on their thread and
+// do nothing without one, the materials of a geometry resolved on several threads share the budget of its watchdog
+// the watchdog trips when its budget is spent or when a loop that waits for a delimiter runs into the end of the text, from then
+// on every step fails right away so the parser quickly unwinds, and the geometry can be reported and skipped
+class ScanWatchdog
+{
+    public:
+        ScanWatchdog();
+        virtual ~ScanWatchdog();
+        void Start(long maxSteps, double maxSeconds);
+        bool HasTripped() const
+        {
+            return tripped;
+        }
+        string GetReason() const
+        {
+            return reason;
+        }
+        long GetSteps() const
+        {
+            return numSteps;
+        }
+        double GetSeconds() const;
+
+        static void SetActive(ScanWatchdog *watchdog);
+        static ScanWatchdog* GetActive()
+        {
+            return active;
+        }
+        static bool Step();
+        static bool Step(std::istream &stream);
+        static bool Tripped()
+        {
+            return ((active!=NULL)&&active->tripped.load(std::memory_order_relaxed));
+        }
+    protected:
+        bool AddSteps(long steps);
+        void Trip(const string &why);
+    private:
+        long stepLimit;
+        double timeLimit;
+        std::atomic<long> numSteps;
+        std::atomic<bool> tripped;
+        // only written by the thread that trips the watchdog
+        string reason;
+        std::chrono::steady_clock::time_point startTime;
+
+        static thread_local ScanWatchdog *active;
+        // the steps taken on this thread that haven't been added to the active watchdog yet, they are added in batches so that
+        // the threads sharing a watchdog don't all write to it on every step
+        static thread_local long pendingSteps;
+};
+
+#endif // ScanWatchdog_HH
@@ -0,0 +1,72 @@
+#ifndef StatementIndex_HH
+#define StatementIndex_HH
+
+#include <string>
+#include <sstream>
+#include <istream>
+#include <vector>
+using namespace std;
+
+// ties a line of a text built from pieces of a file to the line of the file it was copied from, the lines after it follow on from it
+struct LineMark
+{
+    long textLine, sourceLine;
+};
+
+// StatementIndex
+// streaming reader that builds a compact copy of only the statements the material search needs
+// the geometry files are read in fixed size chunks and split into statements at each top level ';', a statement is kept if it
+//   - is inside of ::ConstructMaterials() and builds or uses a material, element or isotope (the material index)
+//   - assigns a value that findDouble() might have to look up (the symbol index)
+// everything else (volumes, placements, visualization) is dropped as soon as its ';' is read, so the memory used depends on
+// the number of material statements and not on the size of the files
+class StatementIndex
+{
+    public:
+        StatementIndex();
+        virtual ~StatementIndex();
+        void Clear();
+        bool ScanFile(string fileName, bool isSource);
+        void Scan(std::istream &in, bool isSource);
+        void GetMaterialStream(std::stringstream &stream);
+        void GetSymbolStream(std::stringstream &stream);
+        const std::vector<LineMark>& GetLineMarks()
+        {
+            return lineMarks;
+        }
+        long GetBytesScanned()
+        {
+            return bytesScanned;
+        }
+        long GetBytesKept()
+        {
+            return long(materialText.length()+symbolHeader.length()+symbolSource.length());
+        }
+        long GetLongestStatement()
+        {
+            return longestStatement;
+        }
+    protected:
+        void EndStatement(bool isSource);
+        void EndToken(bool isSource);
+        void CountBrace(char letter, bool isSource);
+        static bool IsAssignment(const string &text);
+        static bool CreatesOtherObject(const string &text);
+        static bool UsesMaterial(const string &text);
+    private:
+        string materialText, symbolHeader, symbolSource;
+        // the statement and the whitespace delimited token currently being read
+        string statement, token;
+        // the line of the file being read, the line its current statement started on and the number of lines in the material index
+        long line, statementLine, materialLines;
+        std::vector<LineMark> lineMarks;
+        bool inMaterials, exactMarker;
+        // set once the '}' that closes ConstructMaterials() has been read, see CountBrace()
+        bool materialsEnded;
+        int braceDepth;
+        // set while the statements after the last kept material statement are kept, see EndStatement()
+        bool keepTail, tailComma, tailAssign;
+        long bytesScanned, longestStatement;
+};
+
+#endif // StatementIndex_HH
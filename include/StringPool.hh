@@ -0,0 +1,33 @@
+#ifndef StringPool_HH
+#define StringPool_HH
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+using namespace std;
+
+// 32 bit handle of an interned material, element, isotope or isotope key name, 0 is the empty string
+typedef uint32_t NameHandle;
+
+// StringPool
+// per run store of the identifiers found in the geometry files, every distinct name is kept once and referred to by its handle
+// so that the name lists can be compared and hashed as integers, like ElementNames it is set up and cleared by main()
+class StringPool
+{
+    public:
+        StringPool();
+        virtual ~StringPool();
+        static void ClearStore();
+        static NameHandle Intern(const string &name);
+        static const string& GetName(NameHandle handle);
+        static int GetSize();
+    protected:
+    private:
+        static std::deque<string> *names;
+        static std::unordered_map<string, NameHandle> *handles;
+        static std::mutex poolMutex;
+};
+
+#endif // StringPool_HH
@@ -0,0 +1,31 @@
+#ifndef SyntheticGeometry_HH
+#define SyntheticGeometry_HH
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <random>
+using namespace std;
+
+// SyntheticGeometry
+// writes randomly generated but reproducible G4Stork geometry source and header files
+// the generated constructors use the same isotope, element and material constructor forms as the hand written geometries
+// so they can be used to compare parser implementations against each other and to benchmark them at any size
+class SyntheticGeometry
+{
+    public:
+        SyntheticGeometry(unsigned int seed=1);
+        virtual ~SyntheticGeometry();
+        void SetSeed(unsigned int seed);
+        void Generate(string className, int numMaterials, std::stringstream &source, std::stringstream &header);
+        bool WriteFiles(string dirName, string className, int numMaterials);
+    protected:
+        int RandInt(int low, int high);
+        double RandDouble(double low, double high);
+        string Label(string prefix, int index);
+    private:
+        std::mt19937 rng;
+        int width;
+};
+
+#endif // SyntheticGeometry_HH
@@ -0,0 +1,62 @@
+#ifndef TaskScheduler_HH
+#define TaskScheduler_HH
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+using namespace std;
+
+// a unit of work, it is given the index of the worker that runs it so that it can spawn follow up tasks onto that worker
+typedef std::function<void(int)> SchedTask;
+
+// TaskScheduler
+// work-stealing thread pool, every worker has its own deque of tasks, it takes the newest task from the back of its own deque and
+// when that is empty it steals the oldest task from the front of another worker's deque
+// tasks spawned by a task go onto the deque of the worker running it, so a whole geometry that splits into material tasks keeps
+// its worker busy while the idle workers take its remaining materials away from it
+class TaskScheduler
+{
+    public:
+        TaskScheduler(int numWorkers);
+        virtual ~TaskScheduler();
+        void Submit(SchedTask task);
+        void Spawn(int worker, SchedTask task);
+        void Wait();
+        int GetNumWorkers()
+        {
+            return int(workers.size());
+        }
+        long GetNumSteals()
+        {
+            return numSteals;
+        }
+    protected:
+        // padded so that two workers never write to the same cache line
+        struct Worker
+        {
+            std::mutex dequeMutex;
+            std::deque<SchedTask> tasks;
+            char padding[64];
+        };
+
+        void WorkerLoop(int worker);
+        bool FindTask(int worker, SchedTask &task);
+        void Notify();
+    private:
+        std::vector<Worker*> workers;
+        std::vector<std::thread> threads;
+        std::atomic<unsigned int> nextWorker;
+        std::atomic<long> numPending, numSteals;
+
+        // idle workers sleep until a task is added, generation changes every time one is so that no wake up is lost
+        std::mutex idleMutex;
+        std::condition_variable taskAdded, allDone;
+        unsigned long generation;
+        bool stopping;
+};
+
+#endif // TaskScheduler_HH
@@ -0,0 +1,211 @@
+#include "CSDataIndex.hh"
+#include "ElementNames.hh"
+#include <cstdlib>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// how deep the directory walk goes below the data directory, G4NDL style trees are three or four levels deep
+const int maxScanDepth = 16;
+// temperatures closer than this, in kelvin, are the same temperature so that 293.6 in a macrofile matches a directory named 293.60K
+const double tempTolerance = 0.005;
+
+static bool TempLess(const CSDataFile &a, const CSDataFile &b)
+{
+    return (a.temperature<b.temperature);
+}
+
+static string JoinPath(const string &dirName, const string &name)
+{
+    return dirName+((dirName[dirName.length()-1]=='/') ? "" : "/")+name;
+}
+
+CSDataIndex::CSDataIndex()
+{
+    numFiles=0;
+}
+
+CSDataIndex::~CSDataIndex()
+{
+    //dtor
+}
+
+//Scan
+//indexes the isotope files in the given directory and the directories below it, returns false if the directory can't be opened
+//defaultTemp is the temperature of the files that have none in their name or path, they are skipped when it is negative
+bool CSDataIndex::Scan(string dirName, double defaultTemp)
+{
+    DIR *dir = opendir(dirName.c_str());
+    if(dir==NULL)
+        return false;
+    closedir(dir);
+
+    double dirTemp=defaultTemp;
+    string baseName = dirName;
+    while((baseName.length()>1)&&(baseName[baseName.length()-1]=='/'))
+        baseName.erase(baseName.length()-1);
+    if(!ParseTemperature(baseName.substr(baseName.rfind('/')+1), dirTemp))
+        dirTemp=defaultTemp;
+
+    ScanDir(dirName, dirName, dirTemp, 0);
+
+    // the files of one isotope in the different reaction directories of a temperature directory are one entry
+    numFiles=0;
+    for(std::unordered_map<string, std::vector<CSDataFile> >::iterator it=isotopes.begin(); it!=isotopes.end(); it++)
+    {
+        std::vector<CSDataFile> &files = it->second;
+        std::stable_sort(files.begin(), files.end(), TempLess);
+        int size=0;
+        for(int i=0; i<int(files.size()); i++)
+        {
+            if((size==0)||(files[i].temperature-files[size-1].temperature>tempTolerance))
+                files[size++] = files[i];
+        }
+        files.resize(size);
+        numFiles+=size;
+    }
+    return true;
+}
+
+//Contains
+//checks whether the isotope with the given macrofile label has a file at the given temperature
+bool CSDataIndex::Contains(const string &label, double temperature) const
+{
+    std::unordered_map<string, std::vector<CSDataFile> >::const_iterator it = isotopes.find(label);
+    if(it==isotopes.end())
+        return false;
+
+    CSDataFile target = {temperature-tempTolerance, ""};
+    std::vector<CSDataFile>::const_iterator file = std::lower_bound(it->second.begin(), it->second.end(), target, TempLess);
+    return ((file!=it->second.end())&&(file->temperature<=temperature+tempTolerance));
+}
+
+//FindClosest
+//finds the file of the isotope with the closest temperature that is not above the given one, since cross sections can only be
+//broadened up to a higher temperature, if every file is hotter the coolest one is returned, NULL if the isotope has no files
+const CSDataFile* CSDataIndex::FindClosest(const string &label, double temperature) const
+{
+    std::unordered_map<string, std::vector<CSDataFile> >::const_iterator it = isotopes.find(label);
+    if((it==isotopes.end())||it->second.empty())
+        return NULL;
+
+    const std::vector<CSDataFile> &files = it->second;
+    CSDataFile target = {temperature+tempTolerance, ""};
+    std::vector<CSDataFile>::const_iterator file = std::upper_bound(files.begin(), files.end(), target, TempLess);
+    if(file==files.begin())
+        return &files.front();
+    return &(*(file-1));
+}
+
+//ScanDir
+//adds the files of the directory to the index, dirTemp is the temperature named by tempDirName, the closest directory above them
+//named after a temperature, or the default temperature when there is none
+void CSDataIndex::ScanDir(const string &dirName, const string &tempDirName, double dirTemp, int depth)
+{
+    DIR *dir = opendir(dirName.c_str());
+    struct dirent *entry;
+    struct stat info;
+    std::vector<string> subDirs;
+
+    if(dir==NULL)
+        return;
+
+    while((entry=readdir(dir))!=NULL)
+    {
+        string name = entry->d_name;
+        if((name==".")||(name==".."))
+            continue;
+
+        string path = JoinPath(dirName, name);
+        bool isDir = (entry->d_type==DT_DIR);
+        bool isFile = (entry->d_type==DT_REG);
+        // linked directories aren't followed so that a link back up the tree can't be walked through forever
+        if(entry->d_type==DT_UNKNOWN)
+        {
+            if(lstat(path.c_str(), &info)!=0)
+                continue;
+            isDir = S_ISDIR(info.st_mode);
+            isFile = S_ISREG(info.st_mode);
+        }
+        else if(entry->d_type==DT_LNK)
+        {
+            isFile = ((stat(path.c_str(), &info)==0)&&S_ISREG(info.st_mode));
+        }
+
+        if(isDir)
+            subDirs.push_back(name);
+        else if(isFile)
+            AddFile(dirName, name, tempDirName, dirTemp);
+    }
+    closedir(dir);
+
+    if(depth>=maxScanDepth)
+        return;
+    // the directories are walked in name order so that the path kept for a temperature doesn't depend on the file system
+    std::sort(subDirs.begin(), subDirs.end());
+    for(int i=0; i<int(subDirs.size()); i++)
+    {
+        double subTemp;
+        string path = JoinPath(dirName, subDirs[i]);
+        if(ParseTemperature(subDirs[i], subTemp))
+            ScanDir(path, path, subTemp, depth+1);
+        else
+            ScanDir(path, tempDirName, dirTemp, depth+1);
+    }
+}
+
+//AddFile
+//indexes a file named Z_A_ElementName, with an optional _<temperature> and .z ending, other files are ignored
+void CSDataIndex::AddFile(const string &dirName, string fileName, const string &tempDirName, double dirTemp)
+{
+    std::vector<string> parts;
+    size_t start=0, end;
+    string baseName = fileName;
+    CSDataFile file = {dirTemp, tempDirName};
+
+    if((baseName.length()>2)&&(baseName.substr(baseName.length()-2)==".z"))
+        baseName.erase(baseName.length()-2);
+
+    while((end=baseName.find('_', start))!=std::string::npos)
+    {
+        parts.push_back(baseName.substr(start, end-start));
+        start=end+1;
+    }
+    parts.push_back(baseName.substr(start));
+
+    if((parts.size()<3)||(parts.size()>4))
+        return;
+    if((parts[0].find_first_not_of("0123456789")!=std::string::npos)||(parts[1].find_first_not_of("0123456789")!=std::string::npos)
+        ||(parts[0]=="")||(parts[1]==""))
+        return;
+
+    int Z = atoi(parts[0].c_str());
+    if((Z<1)||(Z>118)||!ElementNames::CheckName(parts[2], Z))
+        return;
+    if(parts.size()==4)
+    {
+        if(!ParseTemperature(parts[3], file.temperature))
+            return;
+        file.path = JoinPath(dirName, fileName);
+    }
+    if(file.temperature<0.)
+        return;
+
+    isotopes[parts[0]+'_'+parts[1]+'_'+ElementNames::GetName(Z)].push_back(file);
+}
+
+//ParseTemperature
+//reads a temperature in kelvin written as a plain number with an optional K ending (600, 293.6K, 900k)
+bool CSDataIndex::ParseTemperature(const string &text, double &temperature)
+{
+    char *end;
+    if((text=="")||(text.find_first_not_of("0123456789.Kk")!=std::string::npos))
+        return false;
+
+    temperature = strtod(text.c_str(), &end);
+    if(end==text.c_str())
+        return false;
+    return ((*end=='\0')||(((*end=='K')||(*end=='k'))&&(end[1]=='\0')));
+}
@@ -0,0 +1,293 @@
+#include "CompressedInput.hh"
+#include <iostream>
+#include <cstring>
+
+#ifdef DOPPBROAD_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef DOPPBROAD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+// the number of bytes read from the file and decompressed at a time
+const size_t compressedChunkSize = 65536;
+
+static const unsigned char gzipMagic[2] = {0x1f, 0x8b};
+static const unsigned char zstdMagic[4] = {0x28, 0xb5, 0x2f, 0xfd};
+
+CompressedInput::CompressedInput(string fileName) : std::istream(NULL)
+{
+    rdbuf(&buffer);
+    if(!buffer.Open(fileName))
+        setstate(std::ios::badbit);
+}
+
+CompressedInput::~CompressedInput()
+{
+    buffer.Close();
+}
+
+//DetectType
+//checks the first bytes of the file for the gzip and zstd magic numbers
+CompressionType CompressedInput::DetectType(string fileName)
+{
+    unsigned char magic[4] = {0, 0, 0, 0};
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if(file==NULL)
+        return uncompressed;
+
+    size_t numRead = fread(magic, 1, 4, file);
+    fclose(file);
+
+    if((numRead>=2)&&(memcmp(magic, gzipMagic, 2)==0))
+        return gzipCompressed;
+    if((numRead==4)&&(memcmp(magic, zstdMagic, 4)==0))
+        return zstdCompressed;
+    return uncompressed;
+}
+
+bool CompressedInput::IsSupported(CompressionType type)
+{
+#ifndef DOPPBROAD_HAVE_ZLIB
+    if(type==gzipCompressed)
+        return false;
+#endif
+#ifndef DOPPBROAD_HAVE_ZSTD
+    if(type==zstdCompressed)
+        return false;
+#endif
+    return true;
+}
+
+//StripExtension
+//removes a .gz or .zst ending from the file name so that the names made from it are the same as for the extracted file
+string CompressedInput::StripExtension(string fileName)
+{
+    if((fileName.length()>3)&&(fileName.substr(fileName.length()-3)==".gz"))
+        return fileName.substr(0, fileName.length()-3);
+    if((fileName.length()>4)&&(fileName.substr(fileName.length()-4)==".zst"))
+        return fileName.substr(0, fileName.length()-4);
+    return fileName;
+}
+
+CompressedInput::DecompressBuf::DecompressBuf()
+{
+    file=NULL;
+    type=uncompressed;
+    inBuf = new char[compressedChunkSize];
+    outBuf = new char[compressedChunkSize];
+    inPos=0;
+    inSize=0;
+    inputDone=true;
+    streamDone=true;
+    memberOpen=false;
+    state=NULL;
+}
+
+CompressedInput::DecompressBuf::~DecompressBuf()
+{
+    Close();
+    delete [] inBuf;
+    delete [] outBuf;
+}
+
+//Open
+//opens the file and sets up the decompression for the type of compression it was written with
+bool CompressedInput::DecompressBuf::Open(string fileName)
+{
+    Close();
+
+    type = CompressedInput::DetectType(fileName);
+    if(!CompressedInput::IsSupported(type))
+    {
+        cout << "\nError: " << fileName << " is " << ((type==gzipCompressed) ? "gzip" : "zstd")
+             << " compressed but this build was made without support for it\n" << endl;
+        return false;
+    }
+
+    file = fopen(fileName.c_str(), "rb");
+    if(file==NULL)
+        return false;
+
+#ifdef DOPPBROAD_HAVE_ZLIB
+    if(type==gzipCompressed)
+    {
+        z_stream *zs = new z_stream;
+        memset(zs, 0, sizeof(z_stream));
+        // 15+32 lets zlib read the gzip header
+        if(inflateInit2(zs, 15+32)!=Z_OK)
+        {
+            delete zs;
+            Close();
+            return false;
+        }
+        state=zs;
+    }
+#endif
+#ifdef DOPPBROAD_HAVE_ZSTD
+    if(type==zstdCompressed)
+    {
+        ZSTD_DStream *zds = ZSTD_createDStream();
+        if((zds==NULL)||ZSTD_isError(ZSTD_initDStream(zds)))
+        {
+            ZSTD_freeDStream(zds);
+            Close();
+            return false;
+        }
+        state=zds;
+    }
+#endif
+
+    inPos=0;
+    inSize=0;
+    inputDone=false;
+    streamDone=false;
+    memberOpen=false;
+    setg(outBuf, outBuf, outBuf);
+    return true;
+}
+
+void CompressedInput::DecompressBuf::Close()
+{
+#ifdef DOPPBROAD_HAVE_ZLIB
+    if((type==gzipCompressed)&&(state!=NULL))
+    {
+        inflateEnd((z_stream*)state);
+        delete (z_stream*)state;
+    }
+#endif
+#ifdef DOPPBROAD_HAVE_ZSTD
+    if((type==zstdCompressed)&&(state!=NULL))
+        ZSTD_freeDStream((ZSTD_DStream*)state);
+#endif
+    state=NULL;
+
+    if(file!=NULL)
+        fclose(file);
+    file=NULL;
+    setg(outBuf, outBuf, outBuf);
+}
+
+//FillInput
+//reads the next chunk of the file once the last one has been used up, returns false at the end of the file
+bool CompressedInput::DecompressBuf::FillInput()
+{
+    if(inPos<inSize)
+        return true;
+    if(inputDone)
+        return false;
+
+    inSize = fread(inBuf, 1, compressedChunkSize, file);
+    inPos=0;
+    if(inSize<compressedChunkSize)
+        inputDone=true;
+    return (inSize>0);
+}
+
+//Decompress
+//fills the output buffer with the next part of the file's text, returns the number of characters written and 0 at the end of the data
+long CompressedInput::DecompressBuf::Decompress()
+{
+    if(streamDone)
+        return 0;
+
+    if(type==uncompressed)
+    {
+        size_t numRead = fread(outBuf, 1, compressedChunkSize, file);
+        if(numRead==0)
+            streamDone=true;
+        return long(numRead);
+    }
+
+#ifdef DOPPBROAD_HAVE_ZLIB
+    if(type==gzipCompressed)
+    {
+        z_stream *zs = (z_stream*)state;
+        zs->next_out = (Bytef*)outBuf;
+        zs->avail_out = uInt(compressedChunkSize);
+
+        while((zs->avail_out>0)&&FillInput())
+        {
+            zs->next_in = (Bytef*)(inBuf+inPos);
+            zs->avail_in = uInt(inSize-inPos);
+            int status = inflate(zs, Z_NO_FLUSH);
+            inPos = inSize-zs->avail_in;
+
+            if(status==Z_STREAM_END)
+            {
+                // concatenated gzip files are read as one file
+                inflateReset(zs);
+                memberOpen=false;
+                continue;
+            }
+            else if(status!=Z_OK)
+            {
+                cout << "\nError: the gzip data is corrupt (" << ((zs->msg!=NULL) ? zs->msg : "unknown error") << ")\n" << endl;
+                streamDone=true;
+                break;
+            }
+            memberOpen=true;
+        }
+        long numOut = long(compressedChunkSize-zs->avail_out);
+        if(numOut==0)
+        {
+            if(memberOpen&&!streamDone)
+                cout << "\nError: the gzip data ends before the end of the compressed stream, the file is truncated\n" << endl;
+            streamDone=true;
+        }
+        return numOut;
+    }
+#endif
+#ifdef DOPPBROAD_HAVE_ZSTD
+    if(type==zstdCompressed)
+    {
+        ZSTD_DStream *zds = (ZSTD_DStream*)state;
+        ZSTD_outBuffer out = {outBuf, compressedChunkSize, 0};
+
+        while((out.pos<out.size)&&FillInput())
+        {
+            ZSTD_inBuffer in = {inBuf, inSize, inPos};
+            size_t status = ZSTD_decompressStream(zds, &out, &in);
+            inPos = in.pos;
+
+            if(ZSTD_isError(status))
+            {
+                cout << "\nError: the zstd data is corrupt (" << ZSTD_getErrorName(status) << ")\n" << endl;
+                streamDone=true;
+                break;
+            }
+        }
+        // the decoder can still hold data after the input has run out
+        if((out.pos<out.size)&&!streamDone)
+        {
+            ZSTD_inBuffer in = {inBuf, 0, 0};
+            size_t status = ZSTD_decompressStream(zds, &out, &in);
+            if(ZSTD_isError(status))
+                streamDone=true;
+        }
+        if(out.pos==0)
+            streamDone=true;
+        return long(out.pos);
+    }
+#endif
+
+    streamDone=true;
+    return 0;
+}
+
+CompressedInput::DecompressBuf::int_type CompressedInput::DecompressBuf::underflow()
+{
+    if(gptr()<egptr())
+        return traits_type::to_int_type(*gptr());
+    if(file==NULL)
+        return traits_type::eof();
+
+    long numOut = Decompress();
+    if(numOut<=0)
+        return traits_type::eof();
+
+    setg(outBuf, outBuf, outBuf+numOut);
+    return traits_type::to_int_type(*gptr());
+}
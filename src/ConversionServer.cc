@@ -0,0 +1,614 @@
+#include "ConversionServer.hh"
+#include "MacroCreator.hh"
+#include "StatementIndex.hh"
+#include "StringPool.hh"
+#include "GeoSnapshot.hh"
+#include "ProvenanceReport.hh"
+#include "BoundedQueue.hh"
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+using namespace std;
+
+volatile sig_atomic_t ConversionServer::stopRequested = 0;
+
+// how often, in milliseconds, the threads waiting on a socket check whether the server is stopping
+const int stopCheckInterval = 200;
+// requests longer than this are refused so that a client can't make the server hold an unbounded line
+const size_t maxRequestLength = size_t(256)<<20;
+
+static void StopOnSignal(int)
+{
+    ConversionServer::RequestStop();
+}
+
+//SendAll
+//writes the whole buffer to the socket, a client that has gone away doesn't raise SIGPIPE
+static bool SendAll(int connection, const string &data)
+{
+    size_t sent=0;
+    while(sent<data.length())
+    {
+        ssize_t count = send(connection, data.data()+sent, data.length()-sent, MSG_NOSIGNAL);
+        if(count<0)
+        {
+            if(errno==EINTR)
+                continue;
+            return false;
+        }
+        sent+=size_t(count);
+    }
+    return true;
+}
+
+//AppendUtf8
+//adds the code point to the text in UTF-8
+static void AppendUtf8(string &text, unsigned long code)
+{
+    if(code<0x80)
+    {
+        text += char(code);
+    }
+    else if(code<0x800)
+    {
+        text += char(0xc0|(code>>6));
+        text += char(0x80|(code&0x3f));
+    }
+    else if(code<0x10000)
+    {
+        text += char(0xe0|(code>>12));
+        text += char(0x80|((code>>6)&0x3f));
+        text += char(0x80|(code&0x3f));
+    }
+    else
+    {
+        text += char(0xf0|(code>>18));
+        text += char(0x80|((code>>12)&0x3f));
+        text += char(0x80|((code>>6)&0x3f));
+        text += char(0x80|(code&0x3f));
+    }
+}
+
+//ReadJsonString
+//reads the quoted JSON string starting at pos into text and moves pos past its closing quote
+static bool ReadJsonString(const string &line, size_t &pos, string &text)
+{
+    text.clear();
+    if((pos>=line.length())||(line[pos]!='"'))
+        return false;
+
+    for(pos++; pos<line.length(); pos++)
+    {
+        char letter = line[pos];
+        if(letter=='"')
+        {
+            pos++;
+            return true;
+        }
+        if(letter!='\\')
+        {
+            text += letter;
+            continue;
+        }
+        if(++pos>=line.length())
+            return false;
+        switch(line[pos])
+        {
+            case 'n': text += '\n'; break;
+            case 't': text += '\t'; break;
+            case 'r': text += '\r'; break;
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'u':
+            {
+                if(pos+4>=line.length())
+                    return false;
+                unsigned long code = strtoul(line.substr(pos+1, 4).c_str(), NULL, 16);
+                pos+=4;
+                // a pair of surrogates makes up one code point above 0xffff
+                if((code>=0xd800)&&(code<0xdc00)&&(pos+6<line.length())&&(line[pos+1]=='\\')&&(line[pos+2]=='u'))
+                {
+                    unsigned long low = strtoul(line.substr(pos+3, 4).c_str(), NULL, 16);
+                    if((low>=0xdc00)&&(low<0xe000))
+                    {
+                        code = 0x10000+((code-0xd800)<<10)+(low-0xdc00);
+                        pos+=6;
+                    }
+                }
+                AppendUtf8(text, code);
+                break;
+            }
+            default: text += line[pos]; break;
+        }
+    }
+    return false;
+}
+
+static void SkipSpace(const string &line, size_t &pos)
+{
+    while((pos<line.length())&&isspace((unsigned char)line[pos]))
+        pos++;
+}
+
+ConversionServer::ConversionServer(Preprocessor *preproc, bool stream, int maxCached)
+{
+    preprocessor=preproc;
+    streaming=stream;
+    cacheSize = (maxCached>0) ? maxCached : 1;
+    numRequests=0;
+    numHits=0;
+    numErrors=0;
+}
+
+ConversionServer::~ConversionServer()
+{
+    //dtor
+}
+
+//Run
+//listens on the socket and serves requests on numWorkers threads until SIGINT or SIGTERM is received or a client asks for a shutdown
+//returns false if the socket can't be set up
+bool ConversionServer::Run(string socketName, int numWorkers)
+{
+    struct sockaddr_un address;
+    struct stat info;
+
+    if(socketName.length()>=sizeof(address.sun_path))
+    {
+        cout << "\nError: the socket name " << socketName << " is too long" << endl;
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketName.c_str(), sizeof(address.sun_path)-1);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener<0)
+    {
+        cout << "\nError: could not create a socket" << endl;
+        return false;
+    }
+
+    // a socket file left behind by a server that is gone is replaced, one that a server still answers on is not
+    if((stat(socketName.c_str(), &info)==0)&&S_ISSOCK(info.st_mode))
+    {
+        if(connect(listener, (struct sockaddr*)&address, sizeof(address))==0)
+        {
+            cout << "\nError: a server is already listening on " << socketName << endl;
+            close(listener);
+            return false;
+        }
+        close(listener);
+        unlink(socketName.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+
+    if((listener<0)||(bind(listener, (struct sockaddr*)&address, sizeof(address))!=0)||(listen(listener, SOMAXCONN)!=0))
+    {
+        cout << "\nError: could not listen on " << socketName << ": " << strerror(errno) << endl;
+        if(listener>=0)
+            close(listener);
+        return false;
+    }
+
+    stopRequested=0;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = StopOnSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    if(numWorkers<1)
+        numWorkers=1;
+
+    // accepted connections wait here for a free worker
+    BoundedQueue<int> connections(4*numWorkers);
+    std::vector<std::thread> workers;
+    for(int i=0; i<numWorkers; i++)
+    {
+        workers.push_back(std::thread([this, &connections]
+        {
+            int connection;
+            while(connections.Pop(connection))
+            {
+                ServeConnection(connection);
+                close(connection);
+            }
+        }));
+    }
+
+    cout << "\nServing isotope lists on " << socketName << " with " << numWorkers << " worker threads\n" << endl;
+
+    struct pollfd waiting = {listener, POLLIN, 0};
+    while(!stopRequested)
+    {
+        if(poll(&waiting, 1, stopCheckInterval)<=0)
+            continue;
+        int connection = accept(listener, NULL, NULL);
+        if(connection>=0)
+            connections.Push(connection);
+    }
+
+    connections.Close();
+    for(int i=0; i<int(workers.size()); i++)
+    {
+        workers[i].join();
+    }
+    close(listener);
+    unlink(socketName.c_str());
+
+    cout << "\nServer stopped after " << numRequests << " requests (" << numHits << " from the cache, " << numErrors << " failed)\n" << endl;
+    return true;
+}
+
+//ServeConnection
+//answers each line the client sends until it closes the connection or the server stops
+void ConversionServer::ServeConnection(int connection)
+{
+    string pending;
+    char buffer[65536];
+    struct pollfd waiting = {connection, POLLIN, 0};
+
+    while(!stopRequested)
+    {
+        int ready = poll(&waiting, 1, stopCheckInterval);
+        if(ready==0)
+            continue;
+        if(ready<0)
+        {
+            if(errno==EINTR)
+                continue;
+            return;
+        }
+
+        ssize_t count = recv(connection, buffer, sizeof(buffer), 0);
+        if(count<0)
+        {
+            if(errno==EINTR)
+                continue;
+            return;
+        }
+        if(count==0)
+            return;
+        pending.append(buffer, size_t(count));
+
+        size_t start=0, end;
+        while((end=pending.find('\n', start))!=std::string::npos)
+        {
+            string line = pending.substr(start, end-start);
+            start=end+1;
+            if(line.find_first_not_of(" \t\r")==std::string::npos)
+                continue;
+            if(!SendAll(connection, HandleRequest(line)+'\n'))
+                return;
+        }
+        pending.erase(0, start);
+
+        if(pending.length()>maxRequestLength)
+        {
+            SendAll(connection, "{\"ok\": false, \"error\": \"the request is too long\"}\n");
+            return;
+        }
+    }
+}
+
+//HandleRequest
+//answers one request line with one response line
+string ConversionServer::HandleRequest(const string &line)
+{
+    std::map<string,string> fields;
+    std::stringstream response;
+    string id, isotopes, error;
+    ServerStamp stamp;
+    bool cached=false;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    numRequests++;
+    bool parsed = ParseRequest(line, fields, id);
+    response << "{\"id\": " << ((id!="") ? id : "null");
+    if(!parsed)
+    {
+        numErrors++;
+        response << ", \"ok\": false, \"error\": \"the request is not a JSON object\"}";
+        return response.str();
+    }
+
+    if(fields.count("command"))
+    {
+        if(fields["command"]=="stats")
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            response << ", \"ok\": true, \"requests\": " << numRequests << ", \"hits\": " << numHits << ", \"errors\": " << numErrors
+                     << ", \"cached\": " << cacheIndex.size() << "}";
+        }
+        else if(fields["command"]=="shutdown")
+        {
+            RequestStop();
+            response << ", \"ok\": true}";
+        }
+        else
+        {
+            numErrors++;
+            response << ", \"ok\": false, \"error\": ";
+            ProvenanceReport::WriteString(response, "unknown command "+fields["command"]);
+            response << "}";
+        }
+        return response.str();
+    }
+
+    // the isotope list of a geometry given by its paths is only reused while the files are unchanged
+    string key;
+    bool inlineText = fields.count("sourceText")||fields.count("headerText");
+    if(inlineText)
+    {
+        std::stringstream keyStream;
+        keyStream << "text\n" << GeoSnapshot::HashString(fields["sourceText"]) << ' ' << fields["sourceText"].length() << ' '
+                  << GeoSnapshot::HashString(fields["headerText"]) << ' ' << fields["headerText"].length() << ' ' << fields["name"];
+        key = keyStream.str();
+        memset(&stamp, 0, sizeof(stamp));
+    }
+    else if(fields.count("source")&&fields.count("header"))
+    {
+        key = "path\n"+fields["source"]+'\n'+fields["header"];
+        if(!MakeServerStamp(fields["source"], fields["header"], stamp))
+        {
+            numErrors++;
+            response << ", \"ok\": false, \"error\": ";
+            ProvenanceReport::WriteString(response, "could not find "+fields["source"]+" or "+fields["header"]);
+            response << "}";
+            return response.str();
+        }
+    }
+    else
+    {
+        numErrors++;
+        response << ", \"ok\": false, \"error\": \"give either source and header or sourceText and headerText\"}";
+        return response.str();
+    }
+
+    cached = FindCached(key, stamp, isotopes);
+    if(cached)
+    {
+        numHits++;
+    }
+    else if(Convert(fields, stamp, isotopes, error))
+    {
+        StoreCached(key, stamp, isotopes);
+    }
+    else
+    {
+        numErrors++;
+        response << ", \"ok\": false, \"error\": ";
+        ProvenanceReport::WriteString(response, error);
+        response << "}";
+        return response.str();
+    }
+
+    response << ", \"ok\": true, \"cached\": " << (cached ? "true" : "false") << ", \"seconds\": "
+             << std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count() << ", \"isotopes\": " << isotopes << "}";
+    return response.str();
+}
+
+//Convert
+//finds the isotopes of the geometry in the request the same way the command line conversion does
+bool ConversionServer::Convert(std::map<string,string> &fields, ServerStamp &stamp, string &isotopes, string &error)
+{
+    std::stringstream streamS, streamH;
+    IsotopeTable isoTable;
+    bool inlineText = fields.count("sourceText")||fields.count("headerText");
+    string sourceName = inlineText ? ((fields["name"]!="") ? fields["name"] : "inline.cc") : fields["source"];
+    string headerName = inlineText ? sourceName.substr(0, sourceName.rfind('.'))+".hh" : fields["header"];
+
+    if(streaming&&(preprocessor==NULL)&&!inlineText)
+    {
+        StatementIndex index;
+        if(!index.ScanFile(headerName, false)||!index.ScanFile(sourceName, true))
+        {
+            error = "could not read "+sourceName+" or "+headerName;
+            return false;
+        }
+        index.GetMaterialStream(streamS);
+        index.GetSymbolStream(streamH);
+        ResolveIsotopes(streamS, streamH, isoTable);
+        isotopes = IsotopesToJson(isoTable);
+        return true;
+    }
+
+    if(inlineText)
+    {
+        // every stream the parser searches ends with a new line, see GetDataStream()
+        streamS.str(fields["sourceText"]+'\n');
+        streamH.str(fields["headerText"]+'\n');
+    }
+    else
+    {
+        GetDataStream(sourceName, streamS);
+        GetDataStream(headerName, streamH);
+        if(!streamS.good()||!streamH.good())
+        {
+            error = "could not read "+sourceName+" or "+headerName;
+            return false;
+        }
+    }
+
+    if(preprocessor!=NULL)
+    {
+        std::lock_guard<std::mutex> lock(preprocessMutex);
+        preprocessor->Expand(streamS, sourceName);
+        preprocessor->Expand(streamH, headerName);
+    }
+
+    if(streaming)
+    {
+        StatementIndex index;
+        index.Scan(streamH, false);
+        index.Scan(streamS, true);
+        index.GetMaterialStream(streamS);
+        index.GetSymbolStream(streamH);
+        ResolveIsotopes(streamS, streamH, isoTable);
+    }
+    else
+    {
+        GetGeoIsotopes(streamS, streamH, isoTable);
+    }
+
+    isotopes = IsotopesToJson(isoTable);
+    return true;
+}
+
+//FindCached
+//copies the cached isotope list with the given key if it was made from files with the same stamp
+bool ConversionServer::FindCached(const string &key, const ServerStamp &stamp, string &isotopes)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::unordered_map<string, std::list<CacheEntry>::iterator>::iterator it = cacheIndex.find(key);
+    if(it==cacheIndex.end())
+        return false;
+    if(memcmp(&it->second->stamp, &stamp, sizeof(stamp))!=0)
+        return false;
+
+    cacheOrder.splice(cacheOrder.begin(), cacheOrder, it->second);
+    isotopes = it->second->isotopes;
+    return true;
+}
+
+void ConversionServer::StoreCached(const string &key, const ServerStamp &stamp, const string &isotopes)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::unordered_map<string, std::list<CacheEntry>::iterator>::iterator it = cacheIndex.find(key);
+    if(it!=cacheIndex.end())
+    {
+        cacheOrder.erase(it->second);
+        cacheIndex.erase(it);
+    }
+
+    CacheEntry entry;
+    entry.key = key;
+    entry.stamp = stamp;
+    entry.isotopes = isotopes;
+    cacheOrder.push_front(entry);
+    cacheIndex[key] = cacheOrder.begin();
+
+    while(int(cacheOrder.size())>cacheSize)
+    {
+        cacheIndex.erase(cacheOrder.back().key);
+        cacheOrder.pop_back();
+    }
+}
+
+//ParseRequest
+//reads a flat JSON object, string values are unescaped and other values are kept as they were written
+//id is set to the JSON text of the "id" member so that it can be copied into the response unchanged
+bool ConversionServer::ParseRequest(const string &line, std::map<string,string> &fields, string &id)
+{
+    size_t pos=0;
+    string key, value;
+
+    SkipSpace(line, pos);
+    if((pos>=line.length())||(line[pos]!='{'))
+        return false;
+    pos++;
+    SkipSpace(line, pos);
+    if((pos<line.length())&&(line[pos]=='}'))
+        return true;
+
+    while(pos<line.length())
+    {
+        SkipSpace(line, pos);
+        if(!ReadJsonString(line, pos, key))
+            return false;
+        SkipSpace(line, pos);
+        if((pos>=line.length())||(line[pos]!=':'))
+            return false;
+        pos++;
+        SkipSpace(line, pos);
+
+        size_t valueStart=pos;
+        if((pos<line.length())&&(line[pos]=='"'))
+        {
+            if(!ReadJsonString(line, pos, value))
+                return false;
+        }
+        else
+        {
+            while((pos<line.length())&&(line[pos]!=',')&&(line[pos]!='}')&&!isspace((unsigned char)line[pos]))
+                pos++;
+            value = line.substr(valueStart, pos-valueStart);
+            if(value=="")
+                return false;
+        }
+        fields[key] = value;
+        if(key=="id")
+            id = line.substr(valueStart, pos-valueStart);
+
+        SkipSpace(line, pos);
+        if(pos>=line.length())
+            return false;
+        if(line[pos]=='}')
+            return true;
+        if(line[pos]!=',')
+            return false;
+        pos++;
+    }
+    return false;
+}
+
+//MakeServerStamp
+//unlike the snapshot stamps the modification times are kept to the nanosecond, a build system can change a file twice in a second
+bool ConversionServer::MakeServerStamp(string sourceName, string headerName, ServerStamp &stamp)
+{
+    struct stat sourceInfo, headerInfo;
+
+    memset(&stamp, 0, sizeof(stamp));
+    if((stat(sourceName.c_str(), &sourceInfo)!=0)||(stat(headerName.c_str(), &headerInfo)!=0))
+        return false;
+
+    stamp.sourceSize = sourceInfo.st_size;
+    stamp.headerSize = headerInfo.st_size;
+    stamp.sourceTime = int64_t(sourceInfo.st_mtim.tv_sec)*1000000000+sourceInfo.st_mtim.tv_nsec;
+    stamp.headerTime = int64_t(headerInfo.st_mtim.tv_sec)*1000000000+headerInfo.st_mtim.tv_nsec;
+    stamp.sourceInode = sourceInfo.st_ino;
+    stamp.headerInode = headerInfo.st_ino;
+    return true;
+}
+
+//IsotopesToJson
+//writes the rows of the isotope table as a JSON array in the order they appear in the macrofile
+string ConversionServer::IsotopesToJson(const IsotopeTable &isoTable)
+{
+    std::stringstream out;
+    out << "[";
+    for(int i=0; i<isoTable.GetSize(); i++)
+    {
+        out << ((i>0) ? ", " : "") << "{\"label\": ";
+        ProvenanceReport::WriteString(out, StringPool::GetName(isoTable.GetLabel(i)));
+        out << ", \"Z\": " << isoTable.GetZ(i) << ", \"A\": " << isoTable.GetA(i) << ", \"temperature\": ";
+        if(std::isfinite(isoTable.GetTemperature(i)))
+            out << isoTable.GetTemperature(i);
+        else
+            out << "null";
+        out << ", \"material\": ";
+        ProvenanceReport::WriteString(out, StringPool::GetName(isoTable.GetMaterial(i)));
+        // atoms per cm3, null when the density of one of the materials the isotope is in couldn't be worked out
+        out << ", \"numberDensity\": ";
+        if(isoTable.GetNumDensity(i)>=0.)
+            out << isoTable.GetNumDensity(i);
+        else
+            out << "null";
+        out << "}";
+    }
+    out << "]";
+    return out.str();
+}
@@ -0,0 +1,779 @@
+#include "GdmlReader.hh"
+#include "CompressedInput.hh"
+#include "MacroCreator.hh"
+#include "NistTable.hh"
+#include "ProvenanceReport.hh"
+#include "ScanWatchdog.hh"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <cctype>
+
+using namespace std;
+
+const int gdmlChunkSize = 65536;
+// a tag longer than this is only kept up to here, the tags the reader needs are short and the rest are dropped anyway
+const size_t maxTagLength = size_t(1)<<20;
+const size_t maxEntityNameLength = 256;
+// how many entities can be expanded inside of each other, and how deep materials can be added to each other, before the reader
+// takes it to be a loop
+const int maxEntityDepth = 8;
+const int maxNestingDepth = 16;
+// the temperature given to a material without a <T> entry, the same one the constructor parser gives a material without one
+const double defaultTemperature = 273.15;
+
+// the units that GDML gives temperatures, densities and molar masses in, as multiples of kelvin, g/cm3 and g/mole
+struct GdmlUnit
+{
+    const char *symbol;
+    double value;
+};
+const GdmlUnit gdmlUnits[] = {{"K", 1.}, {"kelvin", 1.}, {"g", 1.}, {"gram", 1.}, {"kg", 1e3}, {"kilogram", 1e3}, {"mg", 1e-3},
+                              {"milligram", 1e-3}, {"cm3", 1.}, {"cm^3", 1.}, {"mm3", 1e-3}, {"mm^3", 1e-3}, {"m3", 1e6}, {"m^3", 1e6},
+                              {"L", 1e3}, {"liter", 1e3}, {"mole", 1.}, {"mol", 1.}};
+
+enum ScanState {textState=0, entityState, tagState, commentState, cdataState, doctypeState};
+
+//StripPointer
+//removes the address that Geant4 appends to the names it writes into GDML (G4_WATER0x1e2f40) so the name can be looked up
+static string StripPointer(const string &name)
+{
+    size_t pos = name.find("0x");
+    if((pos==std::string::npos)||(pos==0))
+        return name;
+    return name.substr(0, pos);
+}
+
+static string DirectoryOf(const string &fileName)
+{
+    size_t pos = fileName.find_last_of('/');
+    if(pos==std::string::npos)
+        return "";
+    return fileName.substr(0, pos+1);
+}
+
+GdmlReader::GdmlReader()
+{
+    openType=noDefinition;
+}
+
+GdmlReader::~GdmlReader()
+{
+    //dtor
+}
+
+void GdmlReader::Clear()
+{
+    isotopes.clear();
+    elements.clear();
+    materials.clear();
+    materialOrder.clear();
+    usedOrder.clear();
+    usedMaterials.clear();
+    constants.clear();
+    entities.clear();
+    entityFiles.clear();
+    openType=noDefinition;
+    openName="";
+}
+
+//ReadFile
+//reads the GDML file, decompressing it if needed, and adds the isotopes of its materials to the table
+//returns false if the file can't be opened
+bool GdmlReader::ReadFile(string fileName, IsotopeTable &isoTable)
+{
+    CompressedInput file(fileName);
+    if(!file.IsOpen())
+        return false;
+
+    Clear();
+    Scan(file, DirectoryOf(fileName), 0);
+    ResolveMaterials(isoTable);
+    return true;
+}
+
+//Read
+//reads a GDML geometry from the stream and adds the isotopes of its materials to the table, entity files are looked for in the
+//working directory
+void GdmlReader::Read(std::istream &in, IsotopeTable &isoTable)
+{
+    Clear();
+    Scan(in, "", 0);
+    ResolveMaterials(isoTable);
+}
+
+//IsGdmlFile
+//checks whether the file is named as a GDML file (.gdml, which may be followed by a compression extension)
+bool GdmlReader::IsGdmlFile(string fileName)
+{
+    fileName = CompressedInput::StripExtension(fileName);
+    if(fileName.length()<=5)
+        return false;
+    string extension = fileName.substr(fileName.length()-5);
+    for(int i=0; i<int(extension.length()); i++)
+    {
+        extension[i] = char(tolower((unsigned char)extension[i]));
+    }
+    return (extension==".gdml");
+}
+
+//Scan
+//splits the text read from the stream into tags and hands each one to ReadTag() as soon as it ends, the text between tags is
+//skipped except for the entities used in it, comments and CDATA sections are skipped without being kept
+void GdmlReader::Scan(std::istream &in, string dirName, int depth)
+{
+    char buffer[gdmlChunkSize];
+    int state=textState, bracketDepth=0;
+    char quote='\0', prev='\0', prev2='\0';
+    string tag, entityName;
+
+    // each tag is a step of the geometry's scanning budget, the rest of the file is left once it is used up
+    while(in.good()&&!ScanWatchdog::Tripped())
+    {
+        in.read(buffer, gdmlChunkSize);
+        long numRead = in.gcount();
+
+        for(long i=0; i<numRead; i++)
+        {
+            char letter = buffer[i];
+            switch(state)
+            {
+                case textState:
+                    if(letter=='<')
+                    {
+                        state=tagState;
+                        tag.clear();
+                        quote='\0';
+                    }
+                    else if(letter=='&')
+                    {
+                        state=entityState;
+                        entityName.clear();
+                    }
+                    break;
+                case entityState:
+                    if(letter==';')
+                    {
+                        state=textState;
+                        ExpandEntity(entityName, dirName, depth);
+                    }
+                    else if(letter=='<')
+                    {
+                        state=tagState;
+                        tag.clear();
+                        quote='\0';
+                    }
+                    else if(entityName.length()<maxEntityNameLength)
+                    {
+                        entityName+=letter;
+                    }
+                    break;
+                case tagState:
+                    if(quote!='\0')
+                    {
+                        if(letter==quote)
+                            quote='\0';
+                    }
+                    else if((letter=='"')||(letter=='\''))
+                    {
+                        quote=letter;
+                    }
+                    else if(letter=='>')
+                    {
+                        state=textState;
+                        if(ScanWatchdog::Step())
+                            ReadTag(tag);
+                        break;
+                    }
+                    if(tag.length()<maxTagLength)
+                        tag+=letter;
+
+                    if(tag=="!--")
+                    {
+                        state=commentState;
+                        prev=prev2='\0';
+                    }
+                    else if(tag=="![CDATA[")
+                    {
+                        state=cdataState;
+                        prev=prev2='\0';
+                    }
+                    else if(tag=="!DOCTYPE")
+                    {
+                        state=doctypeState;
+                        bracketDepth=0;
+                    }
+                    break;
+                case commentState:
+                case cdataState:
+                    // a comment ends at -->, a CDATA section at ]]>
+                    if((letter=='>')&&(prev==prev2)&&(prev==((state==commentState) ? '-' : ']')))
+                        state=textState;
+                    prev2=prev;
+                    prev=letter;
+                    break;
+                case doctypeState:
+                    // the declarations of the DOCTYPE are inside of brackets and may have > in them
+                    if(quote!='\0')
+                    {
+                        if(letter==quote)
+                            quote='\0';
+                    }
+                    else if((letter=='"')||(letter=='\''))
+                    {
+                        quote=letter;
+                    }
+                    else if(letter=='[')
+                    {
+                        bracketDepth++;
+                    }
+                    else if(letter==']')
+                    {
+                        bracketDepth--;
+                    }
+                    else if((letter=='>')&&(bracketDepth<=0))
+                    {
+                        state=textState;
+                        ReadDoctype(tag);
+                        break;
+                    }
+                    if(tag.length()<maxTagLength)
+                        tag+=letter;
+                    break;
+            }
+        }
+    }
+}
+
+//ReadTag
+//splits a start or end tag into its name and attributes and passes them on, an empty element tag (<D value="1"/>) is both started and ended,
+//the processing instructions (<?xml ... ?>) and declarations are ignored
+void GdmlReader::ReadTag(const string &tag)
+{
+    if(tag.empty()||(tag[0]=='?')||(tag[0]=='!'))
+        return;
+
+    size_t pos = ((tag[0]=='/') ? 1 : 0);
+    size_t end = tag.find_first_of(" \t\r\n/", pos);
+    if(end==pos)
+        return;
+    string name = tag.substr(pos, end-pos);
+    if(tag[0]=='/')
+    {
+        EndElement(name);
+        return;
+    }
+
+    std::unordered_map<string, string> attributes;
+    pos=end;
+    while(pos<tag.length())
+    {
+        pos = tag.find_first_not_of(" \t\r\n", pos);
+        if((pos==std::string::npos)||(tag[pos]=='/'))
+            break;
+        end = tag.find_first_of("= \t\r\n", pos);
+        if(end==std::string::npos)
+            break;
+        string attribute = tag.substr(pos, end-pos);
+
+        pos = tag.find_first_not_of("= \t\r\n", end);
+        if((pos==std::string::npos)||((tag[pos]!='"')&&(tag[pos]!='\'')))
+            break;
+        end = tag.find(tag[pos], pos+1);
+        if(end==std::string::npos)
+            break;
+        attributes[attribute] = tag.substr(pos+1, end-pos-1);
+        pos=end+1;
+    }
+
+    StartElement(name, attributes);
+    if(tag[tag.length()-1]=='/')
+        EndElement(name);
+}
+
+//ReadDoctype
+//keeps the entities declared in the DOCTYPE, <!ENTITY name "text"> stands for the text and <!ENTITY name SYSTEM "file"> for the
+//contents of the file, the parameter entities (<!ENTITY % name ...>) can only be used inside of the DOCTYPE and are ignored
+void GdmlReader::ReadDoctype(const string &doctype)
+{
+    size_t pos=0;
+    while((pos=doctype.find("<!ENTITY", pos))!=std::string::npos)
+    {
+        std::vector<string> words;
+        pos+=8;
+        while(pos<doctype.length())
+        {
+            pos = doctype.find_first_not_of(" \t\r\n", pos);
+            if((pos==std::string::npos)||(doctype[pos]=='>'))
+                break;
+            size_t end;
+            if((doctype[pos]=='"')||(doctype[pos]=='\''))
+            {
+                end = doctype.find(doctype[pos], pos+1);
+                if(end==std::string::npos)
+                    break;
+                words.push_back(doctype.substr(pos, end-pos+1));
+                pos=end+1;
+            }
+            else
+            {
+                end = doctype.find_first_of(" \t\r\n>", pos);
+                if(end==std::string::npos)
+                    end=doctype.length();
+                words.push_back(doctype.substr(pos, end-pos));
+                pos=end;
+            }
+        }
+
+        if((words.size()<2)||(words[0]=="%"))
+            continue;
+        // the file of a PUBLIC entity is the second quoted name after its public id
+        string &value = words.back();
+        if((value.length()<2)||((value[0]!='"')&&(value[0]!='\'')))
+            continue;
+        if((words[1]=="SYSTEM")||(words[1]=="PUBLIC"))
+            entityFiles[words[0]] = value.substr(1, value.length()-2);
+        else
+            entities[words[0]] = value.substr(1, value.length()-2);
+    }
+}
+
+//ExpandEntity
+//reads the text that the entity stands for as if it were written in its place, the entities that aren't declared in the DOCTYPE
+//(&amp;, &lt;, ...) don't hold any tags and are skipped
+void GdmlReader::ExpandEntity(const string &name, const string &dirName, int depth)
+{
+    std::unordered_map<string, string>::iterator it;
+
+    if((it=entities.find(name))!=entities.end())
+    {
+        if(depth>=maxEntityDepth)
+        {
+            cout << "\nError: the entity " << name << " is used inside of itself" << endl;
+            return;
+        }
+        std::stringstream text(it->second);
+        Scan(text, dirName, depth+1);
+    }
+    else if((it=entityFiles.find(name))!=entityFiles.end())
+    {
+        if(depth>=maxEntityDepth)
+        {
+            cout << "\nError: the entity " << name << " is used inside of itself" << endl;
+            return;
+        }
+        string fileName = ((it->second!="")&&(it->second[0]=='/')) ? it->second : dirName+it->second;
+        CompressedInput file(fileName);
+        if(!file.IsOpen())
+        {
+            cout << "\nError: could not open the file " << fileName << " of the entity " << name << endl;
+            return;
+        }
+        Scan(file, DirectoryOf(fileName), depth+1);
+    }
+}
+
+//StartElement
+//keeps the parts of the element that the isotope list needs, every other element is ignored
+void GdmlReader::StartElement(const string &name, const std::unordered_map<string, string> &attributes)
+{
+    std::unordered_map<string, string>::const_iterator ref = attributes.find("ref");
+    std::unordered_map<string, string>::const_iterator defName = attributes.find("name");
+    double value;
+
+    if((name=="constant")||(name=="variable")||(name=="quantity"))
+    {
+        if((defName!=attributes.end())&&ReadValue(attributes, "value", value))
+            constants[defName->second] = value;
+    }
+    else if((name=="isotope")||(name=="element")||(name=="material"))
+    {
+        openName = ((defName!=attributes.end()) ? defName->second : "");
+        int Z = (ReadValue(attributes, "Z", value) ? int(value+0.5) : 0);
+        if(name=="isotope")
+        {
+            GdmlIsotope isotope = {Z, (ReadValue(attributes, "N", value) ? int(value+0.5) : 0), -1.};
+            isotopes[openName] = isotope;
+            openType=isotopeDefinition;
+        }
+        else if(name=="element")
+        {
+            GdmlElement element;
+            element.Z=Z;
+            element.molarMass=-1.;
+            elements[openName] = element;
+            openType=elementDefinition;
+        }
+        else
+        {
+            GdmlMaterial material;
+            material.Z=Z;
+            material.molarMass=material.temperature=material.density=-1.;
+            material.byAtoms=false;
+            if(materials.find(openName)==materials.end())
+                materialOrder.push_back(openName);
+            materials[openName] = material;
+            openType=materialDefinition;
+        }
+    }
+    else if(name=="materialref")
+    {
+        if((ref!=attributes.end())&&usedMaterials.insert(ref->second).second)
+            usedOrder.push_back(ref->second);
+    }
+    else if(openType==isotopeDefinition)
+    {
+        if((name=="atom")&&ReadValue(attributes, "value", value))
+            isotopes[openName].molarMass = value;
+    }
+    else if(openType==elementDefinition)
+    {
+        GdmlElement &element = elements[openName];
+        if((name=="atom")&&ReadValue(attributes, "value", value))
+        {
+            element.molarMass = value;
+        }
+        else if(((name=="fraction")||(name=="composite"))&&(ref!=attributes.end())&&ReadValue(attributes, "n", value))
+        {
+            GdmlComponent component = {ref->second, value};
+            element.isotopes.push_back(component);
+        }
+    }
+    else if(openType==materialDefinition)
+    {
+        GdmlMaterial &material = materials[openName];
+        // the Tref, Dref and atomref entries name a quantity of the define section instead of giving the value
+        if(ref!=attributes.end()&&((name=="Tref")||(name=="Dref")||(name=="atomref")))
+        {
+            if(!Evaluate(ref->second, value))
+            {
+                cout << "\nError: the quantity " << ref->second << " used by the material " << openName << " is not defined" << endl;
+                return;
+            }
+            if(name=="Tref")
+                material.temperature = value;
+            else if(name=="Dref")
+                material.density = value;
+            else
+                material.molarMass = value;
+        }
+        else if((name=="T")&&ReadValue(attributes, "value", value))
+        {
+            material.temperature = value;
+        }
+        else if((name=="D")&&ReadValue(attributes, "value", value))
+        {
+            material.density = value;
+        }
+        else if((name=="atom")&&ReadValue(attributes, "value", value))
+        {
+            material.molarMass = value;
+        }
+        else if(((name=="fraction")||(name=="composite"))&&(ref!=attributes.end())&&ReadValue(attributes, "n", value))
+        {
+            GdmlComponent component = {ref->second, value};
+            material.byAtoms = (name=="composite");
+            material.components.push_back(component);
+        }
+    }
+}
+
+void GdmlReader::EndElement(const string &name)
+{
+    if((name=="isotope")||(name=="element")||(name=="material"))
+        openType=noDefinition;
+}
+
+//ReadValue
+//works out the value of the attribute in the units the reader uses, the value is multiplied by the unit attribute when it has one
+//returns false if the attribute isn't there or can't be worked out
+bool GdmlReader::ReadValue(const std::unordered_map<string, string> &attributes, string valueName, double &value)
+{
+    std::unordered_map<string, string>::const_iterator it = attributes.find(valueName);
+    if(it==attributes.end())
+        return false;
+
+    if(!Evaluate(it->second, value))
+    {
+        cout << "\nError: could not work out the value " << it->second << " given to " << valueName << " in " << openName << endl;
+        return false;
+    }
+
+    double unit;
+    it = attributes.find("unit");
+    if((valueName!="value")||(it==attributes.end()))
+        return true;
+    if(!Evaluate(it->second, unit))
+    {
+        cout << "\nError: unknown unit " << it->second << " in " << openName << endl;
+        return false;
+    }
+    value*=unit;
+    return true;
+}
+
+//Evaluate
+//works out a number, a unit, a name from the define section or a product or quotient of these (2*T0, g/cm3)
+bool GdmlReader::Evaluate(const string &text, double &value)
+{
+    size_t pos=0, end;
+    char op='*';
+    value=1.;
+
+    do
+    {
+        end = text.find_first_of("*/", pos);
+        size_t first = text.find_first_not_of(" \t\r\n", pos);
+        size_t last = text.find_last_not_of(" \t\r\n", (end==std::string::npos) ? std::string::npos : end-1);
+        if((first==std::string::npos)||(last==std::string::npos)||(first>last)||((end!=std::string::npos)&&(first>=end)))
+            return false;
+        string part = text.substr(first, last-first+1);
+
+        char *stop;
+        double factor = strtod(part.c_str(), &stop);
+        if(*stop!='\0')
+        {
+            int i, numUnits = int(sizeof(gdmlUnits)/sizeof(GdmlUnit));
+            for(i=0; (i<numUnits)&&(part!=gdmlUnits[i].symbol); i++);
+            std::unordered_map<string, double>::iterator constant = constants.find(part);
+            if(i<numUnits)
+                factor = gdmlUnits[i].value;
+            else if(constant!=constants.end())
+                factor = constant->second;
+            else
+                return false;
+        }
+
+        if(op=='*')
+            value*=factor;
+        else if(factor!=0.)
+            value/=factor;
+        else
+            return false;
+
+        if(end!=std::string::npos)
+        {
+            op = text[end];
+            pos = end+1;
+        }
+    }
+    while(end!=std::string::npos);
+
+    return true;
+}
+
+//ResolveMaterials
+//adds the isotopes of the materials used by the volumes to the table at each material's temperature, when no volume names a
+//material (a file that only holds materials) every material is added, the materials are added in the order they are defined in
+//and the materials that are used without being defined (the NIST materials) after them in the order they are used in
+void GdmlReader::ResolveMaterials(IsotopeTable &isoTable)
+{
+    bool useAll = usedMaterials.empty();
+    for(int i=0; i<int(materialOrder.size()); i++)
+    {
+        if(useAll||(usedMaterials.count(materialOrder[i])>0))
+        {
+            NameHandle name = StringPool::Intern(materialOrder[i]);
+            double temperature = materials[materialOrder[i]].temperature;
+
+            isoTable.SetCurrentMaterial(name);
+            ProvenanceReport::BeginMaterial(name, false);
+            ResolveMaterial(materialOrder[i], ((temperature<0.) ? defaultTemperature : temperature), -1., true, 0, isoTable);
+            ProvenanceReport::EndMaterial();
+        }
+    }
+
+    for(int i=0; i<int(usedOrder.size()); i++)
+    {
+        if(materials.find(usedOrder[i])==materials.end())
+        {
+            NameHandle name = StringPool::Intern(usedOrder[i]);
+            isoTable.SetCurrentMaterial(name);
+            ProvenanceReport::BeginMaterial(name, false);
+            ResolveMaterial(usedOrder[i], defaultTemperature, -1., true, 0, isoTable);
+            ProvenanceReport::EndMaterial();
+        }
+    }
+}
+
+//ResolveMaterial
+//adds the isotopes of the material to the table at the given temperature, the materials it is made from are added at the same
+//temperature, density is the share of the density (in g/cm3, negative if unknown) that it has in the material it is part of,
+//with ownDensity the material's own density is used instead
+void GdmlReader::ResolveMaterial(const string &name, double temperature, double density, bool ownDensity, int depth, IsotopeTable &isoTable)
+{
+    std::unordered_map<string, GdmlMaterial>::iterator it = materials.find(name);
+    if(it==materials.end())
+    {
+        std::vector<NistComponent> components;
+        double nistDensity;
+        if(!NistTable::GetComposition(StripPointer(name), components, nistDensity))
+        {
+            cout << "\nError: the material " << name << " is neither defined in the GDML file nor in the built-in NIST table" << endl;
+            return;
+        }
+        if(ownDensity)
+            density = nistDensity;
+        for(int i=0; i<int(components.size()); i++)
+        {
+            AddNaturalIsotopes(isoTable, components[i].Z, temperature, (density<0.) ? -1. : density*components[i].fraction);
+        }
+        return;
+    }
+
+    if(depth>=maxNestingDepth)
+    {
+        cout << "\nError: the material " << name << " is made from itself" << endl;
+        return;
+    }
+
+    const GdmlMaterial &material = it->second;
+    if(ownDensity)
+        density = material.density;
+    if(material.components.empty())
+    {
+        AddSimpleElement(name, material.Z, material.molarMass, temperature, density, isoTable);
+        return;
+    }
+
+    // the numbers of atoms are weighed with the molar masses of the elements to get each element's share of the density
+    std::vector<double> shares(material.components.size());
+    double total=0.;
+    bool known=true;
+    for(int i=0; i<int(material.components.size()); i++)
+    {
+        shares[i] = material.components[i].amount;
+        if(material.byAtoms)
+        {
+            double molarMass = FindMolarMass(material.components[i].ref);
+            if(molarMass<=0.)
+                known=false;
+            shares[i]*=molarMass;
+        }
+        total+=shares[i];
+    }
+    known = known&&(density>=0.)&&(total>0.);
+
+    for(int i=0; i<int(material.components.size()); i++)
+    {
+        AddComponent(material.components[i].ref, temperature, (known ? density*shares[i]/total : -1.), depth, isoTable);
+    }
+}
+
+//AddComponent
+//adds the isotopes of an element or material that a material is made from, an element or material that isn't defined in the file
+//is looked for in the NIST table (G4_H, G4_WATER)
+void GdmlReader::AddComponent(const string &ref, double temperature, double density, int depth, IsotopeTable &isoTable)
+{
+    std::unordered_map<string, GdmlElement>::iterator element = elements.find(ref);
+    if(element!=elements.end())
+    {
+        AddElement(ref, element->second, temperature, density, isoTable);
+        return;
+    }
+
+    string nistName = StripPointer(ref);
+    const NistElement *nistElement = NULL;
+    if((materials.find(ref)==materials.end())&&(nistName.substr(0, 3)=="G4_"))
+        nistElement = NistTable::FindElement(nistName.substr(3));
+
+    if(nistElement!=NULL)
+        AddNaturalIsotopes(isoTable, nistElement->Z, temperature, density);
+    else
+        ResolveMaterial(ref, temperature, density, false, depth+1, isoTable);
+}
+
+//AddElement
+//adds the isotopes of the element to the table, the element's density (in g/cm3, negative if unknown) is split between them by
+//their atom fractions
+void GdmlReader::AddElement(const string &name, const GdmlElement &element, double temperature, double density, IsotopeTable &isoTable)
+{
+    if(element.isotopes.empty())
+    {
+        AddSimpleElement(name, element.Z, element.molarMass, temperature, density, isoTable);
+        return;
+    }
+
+    std::vector<const GdmlIsotope*> found(element.isotopes.size(), (const GdmlIsotope*)NULL);
+    double total=0., totalMass=0.;
+    for(int i=0; i<int(element.isotopes.size()); i++)
+    {
+        std::unordered_map<string, GdmlIsotope>::iterator it = isotopes.find(element.isotopes[i].ref);
+        if(it==isotopes.end())
+        {
+            cout << "\nError: the isotope " << element.isotopes[i].ref << " of " << name << " is not defined in the GDML file" << endl;
+            continue;
+        }
+        found[i] = &it->second;
+        total+=element.isotopes[i].amount;
+        totalMass+=element.isotopes[i].amount*((it->second.molarMass>0.) ? it->second.molarMass : double(it->second.N));
+    }
+
+    double numDensity = ((total>0.) ? NumberDensity(density, totalMass/total) : -1.);
+    for(int i=0; i<int(element.isotopes.size()); i++)
+    {
+        if(found[i]==NULL)
+            continue;
+        std::stringstream numConv;
+        string zNum, massNum;
+        numConv << found[i]->Z << ' ' << found[i]->N;
+        numConv >> zNum >> massNum;
+        AddIsotopeLabel(isoTable, found[i]->Z, zNum, massNum, temperature, (numDensity<0.) ? -1. : numDensity*element.isotopes[i].amount/total);
+    }
+}
+
+//AddSimpleElement
+//adds an element given by its Z and molar mass the way Geant4 builds it, out of its natural isotopes, a whole number mass is
+//kept as the single isotope it names, the same as GetAndAddIsotope() does for the constructors
+void GdmlReader::AddSimpleElement(const string &name, int Z, double molarMass, double temperature, double density, IsotopeTable &isoTable)
+{
+    if((Z<1)||(Z>118))
+    {
+        cout << "\nError: " << name << " has no Z or isotopes to make it from" << endl;
+        return;
+    }
+    if(((molarMass<=0.)||(molarMass!=floor(molarMass)))&&AddNaturalIsotopes(isoTable, Z, temperature, density))
+        return;
+    if(molarMass<=0.)
+        return;
+
+    std::stringstream numConv;
+    string zNum, massNum;
+    numConv << Z << ' ' << int(molarMass);
+    numConv >> zNum >> massNum;
+    AddIsotopeLabel(isoTable, Z, zNum, massNum, temperature, NumberDensity(density, molarMass));
+}
+
+//FindMolarMass
+//finds the molar mass in g/mole of the element with the given name, negative if it can't be found
+double GdmlReader::FindMolarMass(const string &ref)
+{
+    std::unordered_map<string, GdmlElement>::iterator it = elements.find(ref);
+    if(it==elements.end())
+    {
+        string nistName = StripPointer(ref);
+        const NistElement *element = ((nistName.substr(0, 3)=="G4_") ? NistTable::FindElement(nistName.substr(3)) : NULL);
+        return ((element!=NULL) ? element->atomicWeight : -1.);
+    }
+
+    const GdmlElement &element = it->second;
+    if(element.isotopes.empty())
+    {
+        if(element.molarMass>0.)
+            return element.molarMass;
+        const NistElement *nistElement = NistTable::FindElement(element.Z);
+        return ((nistElement!=NULL) ? nistElement->atomicWeight : -1.);
+    }
+
+    double total=0., totalMass=0.;
+    for(int i=0; i<int(element.isotopes.size()); i++)
+    {
+        std::unordered_map<string, GdmlIsotope>::iterator isotope = isotopes.find(element.isotopes[i].ref);
+        if(isotope==isotopes.end())
+            return -1.;
+        total+=element.isotopes[i].amount;
+        totalMass+=element.isotopes[i].amount*((isotope->second.molarMass>0.) ? isotope->second.molarMass : double(isotope->second.N));
+    }
+    return ((total>0.) ? totalMass/total : -1.);
+}
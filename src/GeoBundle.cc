@@ -0,0 +1,410 @@
+#include "GeoBundle.hh"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/types.h>
+
+using namespace std;
+
+// tar files are made of 512 byte blocks, each file is a header block followed by its data padded out to a whole block
+const uint64_t tarBlockSize = 512;
+const char indexMagic[] = "DoppBroadBundle";
+const int indexVersion = 1;
+
+// the offsets of the ustar header fields that are used
+const int tarNameField = 0, tarModeField = 100, tarUidField = 108, tarGidField = 116, tarSizeField = 124, tarTimeField = 136,
+          tarSumField = 148, tarTypeField = 156, tarMagicField = 257, tarVersionField = 263, tarPrefixField = 345;
+
+static uint64_t PadToBlock(uint64_t size)
+{
+    return (size+tarBlockSize-1)/tarBlockSize*tarBlockSize;
+}
+
+//WriteNumber
+//writes the value as an octal number into a header field, values too large for it are written in the GNU base-256 format
+static void WriteNumber(char *field, int length, uint64_t value)
+{
+    if(value < (uint64_t(1)<<(3*(length-1))))
+    {
+        for(int i=length-2; i>=0; i--)
+        {
+            field[i] = char('0'+(value&7));
+            value>>=3;
+        }
+        field[length-1]='\0';
+    }
+    else
+    {
+        for(int i=length-1; i>0; i--)
+        {
+            field[i] = char(value&0xff);
+            value>>=8;
+        }
+        field[0] = char(0x80);
+    }
+}
+
+static uint64_t ReadNumber(const char *field, int length)
+{
+    uint64_t value=0;
+    if((unsigned char)field[0]&0x80)
+    {
+        for(int i=1; i<length; i++)
+        {
+            value = (value<<8)|(unsigned char)field[i];
+        }
+        return value;
+    }
+    for(int i=0; i<length; i++)
+    {
+        if((field[i]>='0')&&(field[i]<='7'))
+            value = (value<<3)+(field[i]-'0');
+        else if((field[i]!=' ')||(value!=0))
+            break;
+    }
+    return value;
+}
+
+static unsigned int HeaderChecksum(const char *header)
+{
+    unsigned int sum=0;
+    for(int i=0; i<int(tarBlockSize); i++)
+    {
+        if((i>=tarSumField)&&(i<tarSumField+8))
+            sum+=' ';
+        else
+            sum+=(unsigned char)header[i];
+    }
+    return sum;
+}
+
+//FillHeader
+//sets up a ustar header for a regular file or, with type 'L', for the GNU entry that holds the long name of the next file
+static void FillHeader(char *header, string name, uint64_t size, int64_t time, char type)
+{
+    memset(header, 0, tarBlockSize);
+
+    // names longer than the name field are split at a '/' into the prefix field when they fit
+    if(name.length()>100)
+    {
+        size_t pos = name.find('/', name.length()-101);
+        if((pos!=std::string::npos)&&(pos<=155))
+        {
+            memcpy(header+tarPrefixField, name.c_str(), pos);
+            name = name.substr(pos+1);
+        }
+    }
+    memcpy(header+tarNameField, name.c_str(), std::min(name.length(), size_t(100)));
+
+    WriteNumber(header+tarModeField, 8, 0644);
+    WriteNumber(header+tarUidField, 8, 0);
+    WriteNumber(header+tarGidField, 8, 0);
+    WriteNumber(header+tarSizeField, 12, size);
+    WriteNumber(header+tarTimeField, 12, (time>0) ? uint64_t(time) : 0);
+    header[tarTypeField] = type;
+    memcpy(header+tarMagicField, "ustar", 6);
+    memcpy(header+tarVersionField, "00", 2);
+
+    snprintf(header+tarSumField, 8, "%06o", HeaderChecksum(header));
+    header[tarSumField+7] = ' ';
+}
+
+//NeedsLongName
+//checks whether the name fits into the name and prefix fields of a ustar header
+static bool NeedsLongName(const string &name)
+{
+    if(name.length()<=100)
+        return false;
+    size_t pos = name.find('/', name.length()-101);
+    return ((pos==std::string::npos)||(pos>155));
+}
+
+GeoBundle::GeoBundle()
+{
+    file=NULL;
+    writing=false;
+    fileOffset=0;
+}
+
+GeoBundle::~GeoBundle()
+{
+    Close();
+}
+
+//Create
+//starts a new bundle that files are added to with Add(), the bundle is finished and its index written by Close()
+bool GeoBundle::Create(string name)
+{
+    Close();
+    entries.clear();
+    entryIndex.clear();
+
+    fileName = name;
+    file = fopen(fileName.c_str(), "wb");
+    if(file==NULL)
+        return false;
+
+    writing=true;
+    fileOffset=0;
+    return true;
+}
+
+//Add
+//appends a file with the given name and data to the bundle
+bool GeoBundle::Add(string name, const string &data, int64_t time)
+{
+    char header[tarBlockSize];
+    char padding[tarBlockSize];
+    bool success=true;
+
+    if((file==NULL)||!writing)
+        return false;
+    memset(padding, 0, tarBlockSize);
+
+    // GNU tar's long name entry holds names that don't fit into the header
+    if(NeedsLongName(name))
+    {
+        uint64_t nameSize = name.length()+1;
+        FillHeader(header, "././@LongLink", nameSize, 0, 'L');
+        success = success&&(fwrite(header, 1, tarBlockSize, file)==tarBlockSize);
+        success = success&&(fwrite(name.c_str(), 1, nameSize, file)==nameSize);
+        success = success&&(fwrite(padding, 1, PadToBlock(nameSize)-nameSize, file)==PadToBlock(nameSize)-nameSize);
+        fileOffset += tarBlockSize+PadToBlock(nameSize);
+    }
+
+    FillHeader(header, name, data.size(), time, '0');
+    success = success&&(fwrite(header, 1, tarBlockSize, file)==tarBlockSize);
+    fileOffset += tarBlockSize;
+
+    BundleEntry entry = {name, fileOffset, uint64_t(data.size()), time};
+    success = success&&(fwrite(data.data(), 1, data.size(), file)==data.size());
+    success = success&&(fwrite(padding, 1, PadToBlock(data.size())-data.size(), file)==PadToBlock(data.size())-data.size());
+    fileOffset += PadToBlock(data.size());
+
+    AddEntry(entry);
+    return success;
+}
+
+//Close
+//finishes a bundle that is being written with the two empty blocks that end a tar file and writes its index
+bool GeoBundle::Close()
+{
+    bool success=true;
+
+    if(file==NULL)
+        return true;
+
+    if(writing)
+    {
+        char padding[2*tarBlockSize];
+        memset(padding, 0, 2*tarBlockSize);
+        success = (fwrite(padding, 1, 2*tarBlockSize, file)==2*tarBlockSize);
+        fileOffset += 2*tarBlockSize;
+    }
+    if(fclose(file)!=0)
+        success=false;
+    file=NULL;
+
+    if(writing&&success)
+        success=WriteIndex();
+    writing=false;
+    return success;
+}
+
+//Open
+//opens an existing bundle for reading, the files in it are found through its index or by walking through the tar headers
+bool GeoBundle::Open(string name)
+{
+    Close();
+    entries.clear();
+    entryIndex.clear();
+
+    fileName = name;
+    file = fopen(fileName.c_str(), "rb");
+    if(file==NULL)
+        return false;
+
+    if(fseeko(file, 0, SEEK_END)!=0)
+    {
+        Close();
+        return false;
+    }
+    uint64_t bundleSize = uint64_t(ftello(file));
+
+    // the index is only trusted while it was made for a bundle of the same size
+    if(LoadIndex(bundleSize))
+        return true;
+
+    entries.clear();
+    entryIndex.clear();
+    if(!ScanHeaders(bundleSize))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+//Find
+//returns the entry of the file with the given name, if the bundle holds more than one file with the name the last one is returned
+const BundleEntry* GeoBundle::Find(string name)
+{
+    std::unordered_map<string, int>::iterator it = entryIndex.find(name);
+    if(it==entryIndex.end())
+        return NULL;
+    return &entries[it->second];
+}
+
+//Read
+//copies the data of the file with the given name out of the bundle
+bool GeoBundle::Read(string name, string &data)
+{
+    const BundleEntry *entry = Find(name);
+    if((entry==NULL)||(file==NULL)||writing)
+        return false;
+
+    data.resize(entry->size);
+    if(fseeko(file, off_t(entry->offset), SEEK_SET)!=0)
+        return false;
+    return (fread(&data[0], 1, entry->size, file)==entry->size);
+}
+
+void GeoBundle::AddEntry(const BundleEntry &entry)
+{
+    entryIndex[entry.name] = int(entries.size());
+    entries.push_back(entry);
+}
+
+//WriteIndex
+//the index is a text file with the size of the bundle on the first line and then one line for each file giving the offset and
+//size of its data, its modification time and its name
+bool GeoBundle::WriteIndex()
+{
+    std::ofstream out(IndexName(fileName).c_str(), std::ios::out | std::ios::trunc);
+    if(!out.good())
+        return false;
+
+    out << indexMagic << ' ' << indexVersion << ' ' << fileOffset << '\n';
+    for(int i=0; i<int(entries.size()); i++)
+    {
+        out << entries[i].offset << ' ' << entries[i].size << ' ' << entries[i].time << ' ' << entries[i].name << '\n';
+    }
+    out.close();
+    return !out.fail();
+}
+
+bool GeoBundle::LoadIndex(uint64_t bundleSize)
+{
+    std::ifstream in(IndexName(fileName).c_str());
+    string magic, line;
+    int version=0;
+    uint64_t indexedSize=0;
+
+    if(!(in >> magic >> version >> indexedSize))
+        return false;
+    if((magic!=indexMagic)||(version!=indexVersion)||(indexedSize!=bundleSize))
+        return false;
+    getline(in, line);
+
+    while(getline(in, line))
+    {
+        std::stringstream fields(line);
+        BundleEntry entry;
+        if(!(fields >> entry.offset >> entry.size >> entry.time))
+            return false;
+        fields.get();
+        getline(fields, entry.name);
+        if((entry.name=="")||(entry.offset+entry.size>bundleSize))
+            return false;
+        AddEntry(entry);
+    }
+    return true;
+}
+
+//ScanHeaders
+//finds the files in a bundle that has no index by reading each tar header and seeking past the file data that follows it
+//GNU long names and the path records of pax headers are followed, entries that aren't regular files are skipped
+bool GeoBundle::ScanHeaders(uint64_t bundleSize)
+{
+    char header[tarBlockSize];
+    char zeros[tarBlockSize];
+    uint64_t pos=0;
+    string longName;
+
+    memset(zeros, 0, tarBlockSize);
+
+    while(pos+tarBlockSize<=bundleSize)
+    {
+        if((fseeko(file, off_t(pos), SEEK_SET)!=0)||(fread(header, 1, tarBlockSize, file)!=tarBlockSize))
+            return false;
+        if(memcmp(header, zeros, tarBlockSize)==0)
+            break;
+        if(ReadNumber(header+tarSumField, 8)!=HeaderChecksum(header))
+            return false;
+
+        uint64_t size = ReadNumber(header+tarSizeField, 12);
+        uint64_t dataOffset = pos+tarBlockSize;
+        char type = header[tarTypeField];
+        if(dataOffset+size>bundleSize)
+            return false;
+
+        if((type=='L')||(type=='x'))
+        {
+            string data(size, '\0');
+            if((size>0)&&(fread(&data[0], 1, size, file)!=size))
+                return false;
+
+            if(type=='L')
+            {
+                longName = data.substr(0, data.find('\0'));
+            }
+            else
+            {
+                // pax records have the form "<length> <key>=<value>\n"
+                size_t recordPos=0;
+                while(recordPos<data.length())
+                {
+                    size_t recordLength = size_t(atol(data.c_str()+recordPos));
+                    size_t keyPos = data.find(' ', recordPos);
+                    if((recordLength==0)||(keyPos==std::string::npos)||(recordPos+recordLength>data.length()))
+                        break;
+                    string record = data.substr(keyPos+1, recordPos+recordLength-keyPos-2);
+                    if(record.substr(0,5)=="path=")
+                        longName = record.substr(5);
+                    recordPos+=recordLength;
+                }
+            }
+        }
+        else if((type=='0')||(type=='\0')||(type=='7'))
+        {
+            BundleEntry entry;
+            if(longName!="")
+            {
+                entry.name = longName;
+            }
+            else
+            {
+                entry.name = string(header+tarNameField, strnlen(header+tarNameField, 100));
+                if((memcmp(header+tarMagicField, "ustar", 5)==0)&&(header[tarPrefixField]!='\0'))
+                    entry.name = string(header+tarPrefixField, strnlen(header+tarPrefixField, 155))+'/'+entry.name;
+            }
+            while(entry.name.substr(0,2)=="./")
+                entry.name = entry.name.substr(2);
+
+            entry.offset = dataOffset;
+            entry.size = size;
+            entry.time = int64_t(ReadNumber(header+tarTimeField, 12));
+            AddEntry(entry);
+            longName.clear();
+        }
+        else
+        {
+            longName.clear();
+        }
+
+        pos = dataOffset+PadToBlock(size);
+    }
+    return true;
+}
@@ -0,0 +1,259 @@
+#include "GeoSnapshot.hh"
+#include "MacroCreator.hh"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// snapshot file layout, every section starts on an 8 byte boundary
+//   SnapHeader
+//   Z column          uint8_t[numRows]
+//   A column          uint16_t[numRows]
+//   temperature       double[numRows]
+//   number density    double[numRows]     from version 2 on, version 1 snapshots are loaded with unknown densities
+//   material column   uint32_t[numRows]   index into the string table
+//   label column      uint32_t[numRows]   index into the string table
+//   string offsets    uint32_t[numStrings+1]
+//   string data       char[stringBytes]
+const char snapMagic[8] = {'D','B','M','S','N','A','P','\0'};
+const uint32_t snapVersion = 2;
+
+struct SnapHeader
+{
+    char magic[8];
+    uint32_t version, numRows, numStrings, stringBytes;
+    SnapshotStamp stamp;
+};
+
+static uint64_t Align8(uint64_t size)
+{
+    return (size+7)&~uint64_t(7);
+}
+
+GeoSnapshot::GeoSnapshot()
+{
+    //ctor
+}
+
+GeoSnapshot::~GeoSnapshot()
+{
+    //dtor
+}
+
+//MakeStamp
+//records the size and modification time of the geometry files together with a hash of the settings that affect parsing
+//returns false if either file can't be found, a geometry that is a single file (GDML) has no header name and a header size and time of 0
+bool GeoSnapshot::MakeStamp(string sourceName, string headerName, string settings, SnapshotStamp &stamp)
+{
+    struct stat sourceInfo, headerInfo;
+
+    memset(&stamp, 0, sizeof(stamp));
+    stamp.settingsHash = HashString(settings);
+    if((stat(sourceName.c_str(), &sourceInfo)!=0)||((headerName!="")&&(stat(headerName.c_str(), &headerInfo)!=0)))
+        return false;
+
+    stamp.sourceSize = sourceInfo.st_size;
+    stamp.sourceTime = sourceInfo.st_mtime;
+    if(headerName!="")
+    {
+        stamp.headerSize = headerInfo.st_size;
+        stamp.headerTime = headerInfo.st_mtime;
+    }
+    return true;
+}
+
+bool GeoSnapshot::Matches(const SnapshotStamp &a, const SnapshotStamp &b)
+{
+    return ((a.sourceSize==b.sourceSize)&&(a.headerSize==b.headerSize)&&(a.sourceTime==b.sourceTime)
+            &&(a.headerTime==b.headerTime)&&(a.settingsHash==b.settingsHash));
+}
+
+//SnapshotName
+//names the snapshot after the geometry the same way the macrofile is named
+string GeoSnapshot::SnapshotName(string geoFileName, string snapDirName)
+{
+    string name = CreateMacroName(geoFileName, snapDirName);
+    return name.substr(0, name.length()-4)+".snap";
+}
+
+//HashString
+//64 bit FNV-1a hash, it is stable between builds unlike std::hash
+uint64_t GeoSnapshot::HashString(const string &text)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(int i=0; i<int(text.length()); i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//Write
+//stores the isotope table into the snapshot file, the file is written under a temporary name and renamed so readers never see half of it
+bool GeoSnapshot::Write(string fileName, const IsotopeTable &isoTable, const SnapshotStamp &stamp)
+{
+    SnapHeader header;
+    std::vector<uint32_t> matIndex(isoTable.GetSize()), labelIndex(isoTable.GetSize()), offsets(1, 0);
+    std::unordered_map<NameHandle, uint32_t> stringIndex;
+    string stringData;
+    int rows = isoTable.GetSize();
+
+    // the names are stored once each no matter how many rows use them
+    for(int i=0; i<2*rows; i++)
+    {
+        NameHandle handle = (i<rows) ? isoTable.GetMaterial(i) : isoTable.GetLabel(i-rows);
+        std::unordered_map<NameHandle, uint32_t>::iterator it = stringIndex.find(handle);
+        uint32_t index;
+        if(it==stringIndex.end())
+        {
+            index = uint32_t(offsets.size()-1);
+            stringIndex[handle]=index;
+            stringData += StringPool::GetName(handle);
+            offsets.push_back(uint32_t(stringData.length()));
+        }
+        else
+        {
+            index = it->second;
+        }
+        if(i<rows)
+            matIndex[i]=index;
+        else
+            labelIndex[i-rows]=index;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, snapMagic, sizeof(snapMagic));
+    header.version = snapVersion;
+    header.numRows = rows;
+    header.numStrings = uint32_t(offsets.size()-1);
+    header.stringBytes = uint32_t(stringData.length());
+    header.stamp = stamp;
+
+    string tempName = fileName+".tmp";
+    std::ofstream out(tempName.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    const char pad[8] = {0,0,0,0,0,0,0,0};
+    uint64_t size;
+
+    out.write((const char*)&header, sizeof(header));
+    out.write(pad, Align8(sizeof(header))-sizeof(header));
+
+    size = rows*sizeof(uint8_t);
+    if(rows>0)
+        out.write((const char*)&(isoTable.GetZColumn()[0]), size);
+    out.write(pad, Align8(size)-size);
+
+    size = rows*sizeof(uint16_t);
+    if(rows>0)
+        out.write((const char*)&(isoTable.GetAColumn()[0]), size);
+    out.write(pad, Align8(size)-size);
+
+    if(rows>0)
+    {
+        out.write((const char*)&(isoTable.GetTemperatureColumn()[0]), rows*sizeof(double));
+        out.write((const char*)&(isoTable.GetNumDensityColumn()[0]), rows*sizeof(double));
+        out.write((const char*)&matIndex[0], rows*sizeof(uint32_t));
+    }
+    size = rows*sizeof(uint32_t);
+    out.write(pad, Align8(size)-size);
+    if(rows>0)
+        out.write((const char*)&labelIndex[0], size);
+    out.write(pad, Align8(size)-size);
+
+    size = offsets.size()*sizeof(uint32_t);
+    out.write((const char*)&offsets[0], size);
+    out.write(pad, Align8(size)-size);
+    out.write(stringData.c_str(), stringData.length());
+    out.close();
+
+    if(out.fail()||(rename(tempName.c_str(), fileName.c_str())!=0))
+    {
+        cout << "\nError: couldn't write the snapshot " << fileName << endl;
+        unlink(tempName.c_str());
+        return false;
+    }
+    return true;
+}
+
+//Load
+//maps the snapshot file into memory and adds its rows to the isotope table, returns false if the file is missing or not a valid snapshot
+bool GeoSnapshot::Load(string fileName, IsotopeTable &isoTable, SnapshotStamp *stamp)
+{
+    struct stat info;
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd<0)
+        return false;
+    if((fstat(fd, &info)!=0)||(uint64_t(info.st_size)<sizeof(SnapHeader)))
+    {
+        close(fd);
+        return false;
+    }
+
+    uint64_t fileSize = info.st_size;
+    void *data = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data==MAP_FAILED)
+        return false;
+
+    const char *base = (const char*)data;
+    const SnapHeader *header = (const SnapHeader*)base;
+    bool valid = (memcmp(header->magic, snapMagic, sizeof(snapMagic))==0)&&(header->version>=1)&&(header->version<=snapVersion);
+    uint64_t rows=0, zPos=0, aPos=0, tempPos=0, densityPos=0, matPos=0, labelPos=0, offsetPos=0, stringPos=0;
+
+    if(valid)
+    {
+        rows = header->numRows;
+        zPos = Align8(sizeof(SnapHeader));
+        aPos = zPos+Align8(rows*sizeof(uint8_t));
+        tempPos = aPos+Align8(rows*sizeof(uint16_t));
+        densityPos = tempPos+rows*sizeof(double);
+        matPos = (header->version>=2) ? densityPos+rows*sizeof(double) : densityPos;
+        labelPos = matPos+Align8(rows*sizeof(uint32_t));
+        offsetPos = labelPos+Align8(rows*sizeof(uint32_t));
+        stringPos = offsetPos+Align8((uint64_t(header->numStrings)+1)*sizeof(uint32_t));
+        valid = (stringPos+header->stringBytes<=fileSize);
+    }
+
+    if(valid)
+    {
+        const uint8_t *zCol = (const uint8_t*)(base+zPos);
+        const uint16_t *aCol = (const uint16_t*)(base+aPos);
+        const double *tempCol = (const double*)(base+tempPos);
+        const double *densityCol = (header->version>=2) ? (const double*)(base+densityPos) : NULL;
+        const uint32_t *matCol = (const uint32_t*)(base+matPos);
+        const uint32_t *labelCol = (const uint32_t*)(base+labelPos);
+        const uint32_t *offsets = (const uint32_t*)(base+offsetPos);
+        std::vector<NameHandle> handles(header->numStrings);
+        IsotopeTable loaded;
+
+        for(uint32_t i=0; valid&&(i<header->numStrings); i++)
+        {
+            valid = (offsets[i]<=offsets[i+1])&&(offsets[i+1]<=header->stringBytes);
+            if(valid)
+                handles[i] = StringPool::Intern(string(base+stringPos+offsets[i], offsets[i+1]-offsets[i]));
+        }
+        for(uint64_t i=0; valid&&(i<rows); i++)
+        {
+            valid = (matCol[i]<header->numStrings)&&(labelCol[i]<header->numStrings);
+            if(valid)
+                loaded.Add(zCol[i], aCol[i], handles[labelCol[i]], tempCol[i], handles[matCol[i]], (densityCol!=NULL) ? densityCol[i] : -1.);
+        }
+        // nothing is added to the table unless the whole file is valid
+        if(valid)
+            isoTable.Merge(loaded);
+        if(stamp!=NULL)
+            *stamp = header->stamp;
+    }
+
+    munmap(data, fileSize);
+    if(!valid)
+        cout << "\nError: " << fileName << " is not a valid snapshot" << endl;
+    return valid;
+}
@@ -0,0 +1,94 @@
+#include "IsotopeCollector.hh"
+#include <algorithm>
+
+using namespace std;
+
+IsotopeCollector::IsotopeCollector(int numShards)
+{
+    Reset(numShards);
+}
+
+IsotopeCollector::~IsotopeCollector()
+{
+    Reset(0);
+}
+
+//Reset
+//empties the collector and gives it a shard for each of numShards workers
+void IsotopeCollector::Reset(int numShards)
+{
+    for(int i=0; i<int(shards.size()); i++)
+    {
+        delete shards[i];
+    }
+    shards.clear();
+
+    for(int i=0; i<numShards; i++)
+    {
+        shards.push_back(new Shard);
+    }
+}
+
+//Insert
+//adds an isotope to the worker's shard, if the shard already has the isotope at this temperature only the earliest order key is kept
+//along with the larger of the number densities
+void IsotopeCollector::Insert(int shard, uint64_t order, int Z, double A, NameHandle label, double temperature, NameHandle material, double numDensity)
+{
+    Shard &own = *shards[shard];
+    std::pair<std::unordered_multimap<NameHandle, int>::iterator, std::unordered_multimap<NameHandle, int>::iterator> range;
+
+    range = own.labelIndex.equal_range(label);
+    for(std::unordered_multimap<NameHandle, int>::iterator it=range.first; it!=range.second; it++)
+    {
+        Entry &entry = own.entries[it->second];
+        if(entry.temperature==temperature)
+        {
+            entry.numDensity = IsotopeTable::CombineDensity(entry.numDensity, numDensity);
+            if(order<entry.order)
+            {
+                entry.order=order;
+                entry.Z=Z;
+                entry.A=A;
+                entry.material=material;
+            }
+            return;
+        }
+    }
+
+    Entry entry = {order, A, temperature, numDensity, label, material, Z};
+    own.labelIndex.insert(std::make_pair(label, int(own.entries.size())));
+    own.entries.push_back(entry);
+}
+
+//Insert
+//adds every row of the table of the material at matIndex in the material list to the worker's shard
+void IsotopeCollector::Insert(int shard, uint32_t matIndex, const IsotopeTable &matTable)
+{
+    for(int i=0; i<matTable.GetSize(); i++)
+    {
+        Insert(shard, OrderKey(matIndex, uint32_t(i)), matTable.GetZ(i), matTable.GetA(i), matTable.GetLabel(i),
+                matTable.GetTemperature(i), matTable.GetMaterial(i), matTable.GetNumDensity(i));
+    }
+}
+
+//Drain
+//adds the isotopes of every shard to the table in the order of their keys and empties the shards
+//must only be called once all the workers have finished inserting
+void IsotopeCollector::Drain(IsotopeTable &isoTable)
+{
+    std::vector<Entry> merged;
+    for(int i=0; i<int(shards.size()); i++)
+    {
+        merged.insert(merged.end(), shards[i]->entries.begin(), shards[i]->entries.end());
+        shards[i]->entries.clear();
+        shards[i]->labelIndex.clear();
+    }
+
+    std::sort(merged.begin(), merged.end(), OrderLess);
+
+    // the table keeps the first of the entries that different shards have for the same isotope and temperature
+    for(int i=0; i<int(merged.size()); i++)
+    {
+        isoTable.Add(merged[i].Z, merged[i].A, merged[i].label, merged[i].temperature, merged[i].material, merged[i].numDensity);
+    }
+}
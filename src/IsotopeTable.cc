@@ -0,0 +1,196 @@
+#include "IsotopeTable.hh"
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+
+using namespace std;
+
+IsotopeTable::IsotopeTable()
+{
+    currentMaterial=0;
+}
+
+IsotopeTable::~IsotopeTable()
+{
+    //dtor
+}
+
+//Add
+//adds the isotope at the given temperature unless the table already has it, returns true if a row was added
+//an isotope that the table already has keeps the larger of the two number densities
+bool IsotopeTable::Add(int Z, double A, NameHandle label, double temperature)
+{
+    return Add(Z, A, label, temperature, currentMaterial);
+}
+
+bool IsotopeTable::Add(int Z, double A, NameHandle label, double temperature, NameHandle material, double numDensity)
+{
+    std::pair<std::unordered_multimap<NameHandle, int>::iterator, std::unordered_multimap<NameHandle, int>::iterator> range;
+    range = labelIndex.equal_range(label);
+    for(std::unordered_multimap<NameHandle, int>::iterator it=range.first; it!=range.second; it++)
+    {
+        if(tempCol[it->second]==temperature)
+        {
+            densityCol[it->second] = CombineDensity(densityCol[it->second], numDensity);
+            return false;
+        }
+    }
+
+    long mass = lround(A);
+    zCol.push_back(uint8_t(((Z>=0)&&(Z<=255)) ? Z : 0));
+    aCol.push_back(uint16_t(((mass>=0)&&(mass<=65535)) ? mass : 0));
+    tempCol.push_back(temperature);
+    densityCol.push_back((numDensity<0.) ? -1. : numDensity);
+    matCol.push_back(material);
+    labelCol.push_back(label);
+    labelIndex.insert(std::make_pair(label, int(labelCol.size())-1));
+    return true;
+}
+
+//Merge
+//appends the rows of the other table that this table doesn't have yet, keeping their order
+void IsotopeTable::Merge(const IsotopeTable &other)
+{
+    for(int i=0; i<other.GetSize(); i++)
+    {
+        Add(other.zCol[i], other.aCol[i], other.labelCol[i], other.tempCol[i], other.matCol[i], other.densityCol[i]);
+    }
+}
+
+//Select
+//removes every row whose entry in keep is false
+void IsotopeTable::Select(const std::vector<bool> &keep)
+{
+    int size=0;
+    for(int i=0; i<GetSize(); i++)
+    {
+        if(keep[i])
+        {
+            zCol[size]=zCol[i];
+            aCol[size]=aCol[i];
+            tempCol[size]=tempCol[i];
+            densityCol[size]=densityCol[i];
+            matCol[size]=matCol[i];
+            labelCol[size]=labelCol[i];
+            size++;
+        }
+    }
+    zCol.resize(size);
+    aCol.resize(size);
+    tempCol.resize(size);
+    densityCol.resize(size);
+    matCol.resize(size);
+    labelCol.resize(size);
+    RebuildIndex();
+}
+
+void IsotopeTable::Clear()
+{
+    zCol.clear();
+    aCol.clear();
+    tempCol.clear();
+    densityCol.clear();
+    matCol.clear();
+    labelCol.clear();
+    labelIndex.clear();
+    currentMaterial=0;
+}
+
+//SortByIsotope
+//orders the rows by Z, then A, then temperature, rows that tie keep their order
+void IsotopeTable::SortByIsotope()
+{
+    std::vector<int> order(GetSize());
+    for(int i=0; i<int(order.size()); i++)
+        order[i]=i;
+
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b)
+    {
+        if(zCol[a]!=zCol[b])
+            return zCol[a]<zCol[b];
+        if(aCol[a]!=aCol[b])
+            return aCol[a]<aCol[b];
+        return tempCol[a]<tempCol[b];
+    });
+    Permute(order);
+}
+
+//SortByTemperature
+//orders the rows by temperature, then Z and then A, rows that tie keep their order
+void IsotopeTable::SortByTemperature()
+{
+    std::vector<int> order(GetSize());
+    for(int i=0; i<int(order.size()); i++)
+        order[i]=i;
+
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b)
+    {
+        if(tempCol[a]!=tempCol[b])
+            return tempCol[a]<tempCol[b];
+        if(zCol[a]!=zCol[b])
+            return zCol[a]<zCol[b];
+        return aCol[a]<aCol[b];
+    });
+    Permute(order);
+}
+
+//GroupByTemperature
+//fills groupStart with the first row of each run of equal temperatures followed by the size of the table
+//after SortByTemperature() each group holds all of the isotopes at one temperature
+void IsotopeTable::GroupByTemperature(std::vector<int> &groupStart) const
+{
+    groupStart.clear();
+    for(int i=0; i<GetSize(); i++)
+    {
+        if((i==0)||(tempCol[i]!=tempCol[i-1]))
+            groupStart.push_back(i);
+    }
+    groupStart.push_back(GetSize());
+}
+
+//Emit
+//writes one macrofile line per row, the label followed by the temperature
+void IsotopeTable::Emit(std::ostream &out) const
+{
+    out.fill(' ');
+    for(int i=0; i<GetSize(); i++)
+    {
+        out << std::setw(20) << std::left << StringPool::GetName(labelCol[i]) << std::setw(14) << std::left << tempCol[i] << '\n';
+    }
+}
+
+//Permute
+//reorders every column so that row i of the result is row order[i] of the current table
+void IsotopeTable::Permute(const std::vector<int> &order)
+{
+    std::vector<uint8_t> zNew(order.size());
+    std::vector<uint16_t> aNew(order.size());
+    std::vector<double> tempNew(order.size()), densityNew(order.size());
+    std::vector<NameHandle> matNew(order.size()), labelNew(order.size());
+
+    for(int i=0; i<int(order.size()); i++)
+    {
+        zNew[i]=zCol[order[i]];
+        aNew[i]=aCol[order[i]];
+        tempNew[i]=tempCol[order[i]];
+        densityNew[i]=densityCol[order[i]];
+        matNew[i]=matCol[order[i]];
+        labelNew[i]=labelCol[order[i]];
+    }
+    zCol.swap(zNew);
+    aCol.swap(aNew);
+    tempCol.swap(tempNew);
+    densityCol.swap(densityNew);
+    matCol.swap(matNew);
+    labelCol.swap(labelNew);
+    RebuildIndex();
+}
+
+void IsotopeTable::RebuildIndex()
+{
+    labelIndex.clear();
+    for(int i=0; i<GetSize(); i++)
+    {
+        labelIndex.insert(std::make_pair(labelCol[i], i));
+    }
+}
@@ -0,0 +1,1880 @@
+#include "MacroCreator.hh"
+#include "ElementNames.hh"
+#include "StringPool.hh"
+#include "ProvenanceReport.hh"
+#include "MaterialResolution.hh"
+#include "CompressedInput.hh"
+#include "NistTable.hh"
+#include "CSDataIndex.hh"
+#include "ScanFilter.hh"
+#include "ScanWatchdog.hh"
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <iomanip>
+#include <unordered_set>
+
+// atoms per mole
+const double avogadro = 6.02214076e23;
+// how many variables deep a density or fraction is followed, a variable defined by another one is one level
+const int maxQuantityDepth = 4;
+// how many variables deep findDouble() follows a temperature, this stops a variable that is set to itself
+const int maxLookupDepth = 64;
+
+// the unit symbols of Geant4 as multiples of a gram, a centimetre and a mole, which gives densities in g/cm3 and molar masses in g/mole
+struct UnitSymbol
+{
+    const char *symbol;
+    double value;
+};
+const UnitSymbol unitSymbols[] = {{"g", 1.}, {"gram", 1.}, {"kg", 1e3}, {"kilogram", 1e3}, {"mg", 1e-3}, {"milligram", 1e-3},
+                                  {"cm", 1.}, {"mm", 0.1}, {"m", 100.}, {"cm2", 1.}, {"mm2", 1e-2}, {"m2", 1e4},
+                                  {"cm3", 1.}, {"mm3", 1e-3}, {"m3", 1e6}, {"L", 1e3}, {"liter", 1e3}, {"dm3", 1e3},
+                                  {"mole", 1.}, {"perCent", 1e-2}, {"perThousand", 1e-3}, {"perMillion", 1e-6}, {"kelvin", 1.}};
+
+void GetDataStream( string geoFileName, std::stringstream& ss)
+{
+    string* data=NULL;
+
+    // compressed files are decompressed a chunk at a time straight into the data string instead of being extracted to disk first
+    if(CompressedInput::DetectType(geoFileName)!=uncompressed)
+    {
+        CompressedInput in(geoFileName);
+        if(in.IsOpen())
+        {
+            char chunk[65536];
+            data = new string;
+            while(in.read(chunk, sizeof(chunk))||(in.gcount()>0))
+            {
+                data->append(chunk, size_t(in.gcount()));
+            }
+        }
+        else
+        {
+            ss.setstate( std::ios::badbit );
+        }
+    }
+    // Use regular text file
+    else
+    {
+        std::ifstream thefData( geoFileName.c_str() , std::ios::in | std::ios::ate );
+        if ( thefData.good() )
+        {
+            // determines the size of the file in characters
+            int file_size = thefData.tellg();
+            thefData.seekg( 0 , std::ios::beg );
+
+            // creates a character array based off the size of the file
+            char* filedata = new char[ file_size ];
+            while ( thefData )
+            {
+                // stores the file data into the character array
+                thefData.read( filedata , file_size );
+            }
+            thefData.close();
+            // stores the character array into a string
+            data = new string ( filedata , file_size );
+            delete [] filedata;
+        }
+        else
+        {
+        // found no data file
+        //                 set error bit to the stream
+            ss.setstate( std::ios::badbit );
+        }
+    }
+    if (data != NULL)
+    {
+        //stores the string into a stringstream
+        ss.str(*data);
+        if(data->empty()||(data->back()!='\n'))
+            ss << "\n";
+        ss.seekg( 0 , std::ios::beg );
+    }
+
+    delete data;
+}
+
+void FormatData(std::stringstream& stream, std::stringstream& stream2)
+{
+    IsotopeTable isoTable;
+
+    // extracts the isotope names and temperatures used in the geometry
+    GetGeoIsotopes(stream, stream2, isoTable);
+
+    stream.str("");
+    stream.clear();
+
+    // replaces the contents of the source stream with the macrofile data
+    WriteMacroData(stream, isoTable);
+}
+
+//GetGeoIsotopes
+//finds the isotopes and their temperatures used in the geometry described by the given source and header streams
+void GetGeoIsotopes(std::stringstream& stream, std::stringstream& stream2, IsotopeTable &isoTable, int numThreads)
+{
+    std::stringstream original;
+
+    CropMaterialSection(stream, stream2, original);
+    ResolveIsotopes(stream, original, isoTable, numThreads);
+}
+
+//CropMaterialSection
+//cuts the source stream down to the ConstructMaterials() function and fills original with the header and source text that
+//the temperature variables are looked up in
+void CropMaterialSection(std::stringstream& stream, std::stringstream& stream2, std::stringstream& original)
+{
+    // combines the source file stream and the header file stream into one stream for advanced searching of variables
+    original.str(stream2.str()+stream.str());
+
+    // searches throught the source stream for the ConstructMaterials() function and moves the file pointer past that position
+    bool found = MovePastWord(stream, "::ConstructMaterials()");
+    int pos = stream.tellg();
+
+    // the functions after ConstructMaterials() (the world volume, detectors and visualization) are left out of the material search
+    int end = found ? FindSectionEnd(stream.str(), pos) : 0;
+
+    // the provenance report gives the lines of the materials in the uncropped source file
+    std::vector<LineMark> lineMarks;
+    if(ProvenanceReport::IsActive())
+    {
+        const string text = stream.str();
+        LineMark mark = {1, 1+long(std::count(text.begin(), text.begin()+pos, '\n'))};
+        lineMarks.push_back(mark);
+    }
+
+    // removes the information in the source stream before the current position and after the end of the function
+    CropStream(stream, pos, end);
+    if(end!=0)
+    {
+        // every stream the parser searches ends with a new line, see GetDataStream()
+        stream.seekp(0, std::ios::end);
+        stream << '\n';
+        stream.seekg(0, std::ios::beg);
+    }
+    ProvenanceReport::MapLines(stream, lineMarks);
+}
+
+//FindSectionEnd
+//returns the position just after the '}' that closes the first block opened after pos, braces inside of comments and literals
+//are skipped the same way that StatementIndex skips them, returns 0 if the block is never closed
+int FindSectionEnd(const string &text, int pos)
+{
+    enum {code=0, lineComment, blockComment, literal} state=code;
+    char prev='\0', quote='\0', letter;
+    int depth=0;
+
+    for(int i=pos; i<int(text.length()); i++)
+    {
+        letter=text[i];
+        switch(state)
+        {
+            case lineComment:
+                if(letter=='\n')
+                    state=code;
+                break;
+            case blockComment:
+                if((prev=='*')&&(letter=='/'))
+                {
+                    state=code;
+                    letter='\0';
+                }
+                break;
+            case literal:
+                if(prev=='\\')
+                    letter='\0';
+                else if(letter==quote)
+                    state=code;
+                break;
+            default:
+                if((prev=='/')&&((letter=='/')||(letter=='*')))
+                {
+                    state = (letter=='/') ? lineComment : blockComment;
+                    letter='\0';
+                }
+                else if((letter=='"')||(letter=='\''))
+                {
+                    state=literal;
+                    quote=letter;
+                }
+                else if(letter=='{')
+                {
+                    depth++;
+                }
+                else if((letter=='}')&&(depth>0))
+                {
+                    depth--;
+                    if(depth==0)
+                        return i+1;
+                }
+                break;
+        }
+        prev=letter;
+    }
+    return 0;
+}
+
+//ResolveIsotopes
+//finds the isotopes and their temperatures of the materials stored in the material map of the stream
+//the stream holds the material section of the source and original holds the text that temperature variables are looked up in
+void ResolveIsotopes(std::stringstream& stream, std::stringstream& original, IsotopeTable &isoTable, int numThreads)
+{
+    std::vector<NameHandle> matNameList;
+
+    // finds the material map used in the geometry file and stores it into the matNameList vector
+    FindMaterialList(stream, matNameList);
+
+    //Gets the isotope list using the matNameList and the source and the header stream
+    GetIsotopeList(stream, matNameList, isoTable, original, numThreads);
+}
+
+//WriteMacroData
+//prints the macrofile parameter block followed by the given isotope list into the stream
+//with a source index the CS data with the closest temperature is written after each isotope, returns the number of isotopes that
+//have no CS data in the index
+int WriteMacroData(std::stringstream& stream, const IsotopeTable &isoTable, const CSDataIndex *sourceIndex)
+{
+    // prints a list of variables (that will determine what the doppler broadening program will do with the information) the user must fill in after the macrofile has been created
+    stream << "(int: # of parameters)\n" << "(string: CS data input file or directory)\n" << "(string: CS data output file or directory)\n"
+            << "(bool: use the file in the input directory with the closest temperature)\n" << "(double: use the file in the input directory with this temperature)\n"
+            << "[Optional](string: choose either ascii or compressed for the output file type {Default=ascii})\n" << "[Optional](bool: create log file to show progress and errors {Default=false})\n"
+            << "[Optional](bool: regenerate any existing doppler broadened data file with the same name {Default=true})\n" << isoTable.GetSize() << "\n\n"
+            << "Fill in the above parameters and then delete this line before running.\n" << "The order of the parameters must be mantianed,\n"
+            << "to enter an option the user must enter the previous options on the list \nleave the number at the bottom this is your # of isotopes\n\n";
+
+    // adds a line with the name and temperature of each isotope
+    if(sourceIndex==NULL)
+    {
+        isoTable.Emit(stream);
+        return 0;
+    }
+
+    int numMissing=0;
+    stream.fill(' ');
+    for(int i=0; i<isoTable.GetSize(); i++)
+    {
+        const string &label = StringPool::GetName(isoTable.GetLabel(i));
+        const CSDataFile *source = sourceIndex->FindClosest(label, isoTable.GetTemperature(i));
+        stream << std::setw(20) << std::left << label << std::setw(14) << std::left << isoTable.GetTemperature(i);
+        if(source!=NULL)
+            stream << source->path;
+        else
+            numMissing++;
+        stream << '\n';
+    }
+    return numMissing;
+}
+
+//ReadMacroIsotopes
+//adds the isotope lines of a macrofile, or of any file with a Z_A_ElementName label and a temperature at the start of its lines,
+//to the isotope table, returns false if the file can't be opened
+bool ReadMacroIsotopes(string macroFileName, IsotopeTable &isoTable)
+{
+    std::ifstream in(macroFileName.c_str());
+    string line, label, tempText;
+    char *end;
+
+    if(!in)
+        return false;
+
+    while(getline(in, line))
+    {
+        std::stringstream lineStream(line);
+        if(!(lineStream >> label >> tempText))
+            continue;
+        // the parameter block and the instructions at the top of a macrofile don't start with a label
+        if(!isdigit((unsigned char)label[0])||(std::count(label.begin(), label.end(), '_')<2))
+            continue;
+        double temperature = strtod(tempText.c_str(), &end);
+        if(*end!='\0')
+            continue;
+
+        size_t pos = label.find('_');
+        int Z = int(strtol(label.c_str(), NULL, 10));
+        isoTable.Add(((Z>=0)&&(Z<=118)) ? Z : 0, strtod(label.c_str()+pos+1, NULL), StringPool::Intern(label), temperature);
+    }
+    return true;
+}
+
+//DiffMacroIsotopes
+//adds the isotopes of the current table that the previous one doesn't have to added and the ones of the previous table that the
+//current one doesn't have to removed, the temperatures are compared the way they are written into the macrofile
+void DiffMacroIsotopes(const IsotopeTable &previous, const IsotopeTable &current, IsotopeTable &added, IsotopeTable &removed)
+{
+    std::unordered_set<string> previousKeys, currentKeys;
+
+    for(int i=0; i<previous.GetSize(); i++)
+    {
+        previousKeys.insert(MacroKey(previous.GetLabel(i), previous.GetTemperature(i)));
+    }
+    for(int i=0; i<current.GetSize(); i++)
+    {
+        string key = MacroKey(current.GetLabel(i), current.GetTemperature(i));
+        currentKeys.insert(key);
+        if(previousKeys.count(key)==0)
+        {
+            added.Add(current.GetZ(i), current.GetA(i), current.GetLabel(i), current.GetTemperature(i), current.GetMaterial(i),
+                        current.GetNumDensity(i));
+        }
+    }
+    for(int i=0; i<previous.GetSize(); i++)
+    {
+        if(currentKeys.count(MacroKey(previous.GetLabel(i), previous.GetTemperature(i)))==0)
+        {
+            removed.Add(previous.GetZ(i), previous.GetA(i), previous.GetLabel(i), previous.GetTemperature(i), previous.GetMaterial(i),
+                        previous.GetNumDensity(i));
+        }
+    }
+}
+
+string MacroKey(NameHandle label, double temperature)
+{
+    std::stringstream key;
+    key << StringPool::GetName(label) << ' ' << temperature;
+    return key.str();
+}
+
+// MovePastWord
+// breaks up the given string into words then it searches throught the stream ignoring whitespace looking for match between the words extracted from the string and those in the stream
+// a match occurs when the stream has the words in the same order as they are in the string and without any words inbetween them
+// when a match is found the file pointer is set to the position just after the match and then the function returns true
+bool MovePastWord(std::stringstream& stream, string word)
+{
+    std::vector<string> wordParts;
+    int pos=0, start;
+    bool check=true;
+
+    start = stream.tellg();
+
+    for(int i=0; i<int(word.length()); i++)
+    {
+        if(word[i]==' ')
+        {
+            if(check)
+            {
+                pos=i+1;
+            }
+            else
+            {
+                wordParts.push_back(word.substr(pos,i-pos));
+                pos=i+1;
+                check=true;
+            }
+        }
+        else
+        {
+            check=false;
+            if(i==int(word.length()-1))
+            {
+                wordParts.push_back(word.substr(pos,i-pos+1));
+            }
+        }
+    }
+
+    if(wordParts.size()==0)
+    {
+        wordParts.push_back(word);
+    }
+
+    string wholeWord;
+    SearchWalk exactWalk, partWalk, tokenWalk;
+    bool inStep=true, partDone=false, partFound=false, partStart;
+    check=false;
+
+    // a word that isn't in the text, or that was already searched for from here without success, isn't searched for again
+    if(ScanFilter::RulesOut(stream, start, word, wordParts))
+    {
+        stream.clear();
+        stream.seekg(start, std::ios::beg);
+        ProvenanceReport::CountScan(stream, false);
+        return false;
+    }
+
+    // the text is walked through once looking for an exact match of the words, the walk that looks for a match by the start or end
+    // of the tokens only differs from it where a token could begin such a match, so it is only stepped on its own from there until
+    // the two walks are in step again, its first match is used if there turns out to be no exact match
+    // every step of the walks counts against the budget of the geometry, a walk that runs out of it ends without a match
+    while(!check)
+    {
+        if((!stream)||!ScanWatchdog::Step())
+        {
+            break;
+        }
+        if((!inStep)&&(!partDone))
+        {
+            SaveWalk(stream, exactWalk, wholeWord);
+            while((!partDone)&&(partWalk.pos<exactWalk.pos)&&ScanWatchdog::Step())
+            {
+                LoadWalk(stream, partWalk);
+                partFound = SearchStep(stream, wordParts, false, partWalk.lastToken, tokenWalk, partStart);
+                SaveWalk(stream, partWalk, partWalk.lastToken);
+                partDone = (partFound||(!stream));
+            }
+            inStep = ((!partDone)&&SameWalk(partWalk, exactWalk));
+            LoadWalk(stream, exactWalk);
+        }
+
+        check = SearchStep(stream, wordParts, true, wholeWord, tokenWalk, partStart);
+
+        if((!check)&&inStep&&partStart&&(!partDone))
+        {
+            SaveWalk(stream, exactWalk, wholeWord);
+            partWalk = tokenWalk;
+            LoadWalk(stream, partWalk);
+            partFound = SearchStep(stream, wordParts, false, partWalk.lastToken, tokenWalk, partStart);
+            SaveWalk(stream, partWalk, partWalk.lastToken);
+            partDone = (partFound||(!stream));
+            inStep = ((!partDone)&&SameWalk(partWalk, exactWalk));
+            LoadWalk(stream, exactWalk);
+        }
+    }
+
+    // the exact walk ended on its own, the partial walk has the rest of the text to go
+    while((!check)&&(!inStep)&&(!partDone)&&ScanWatchdog::Step())
+    {
+        LoadWalk(stream, partWalk);
+        partFound = SearchStep(stream, wordParts, false, partWalk.lastToken, tokenWalk, partStart);
+        SaveWalk(stream, partWalk, partWalk.lastToken);
+        partDone = (partFound||(!stream));
+    }
+
+    if((!check)&&partFound)
+    {
+        LoadWalk(stream, partWalk);
+        check=true;
+    }
+
+    if(!check)
+    {
+        stream.clear();
+        stream.seekg(start, std::ios::beg);
+        if(!ScanWatchdog::Tripped())
+            ScanFilter::AddMiss(stream, start, word);
+    }
+
+    ProvenanceReport::CountScan(stream, check);
+    return check;
+}
+
+//SearchStep
+//takes one step of a walk through the text for the given word parts, it skips a comment, a line end, a tab or a space, or compares
+//the tokens at the position with the parts, either exactly or by their start (or for the first part its end as well)
+//returns true if the tokens match, tokenWalk is set to where the tokens start (its pos is -1 when none were compared) and partStart
+//is set when an exact comparison fails on tokens that could still match by their start or end
+//wholeWord is the last token read by the walk, a read that runs into the end of the text compares it again just like >> leaves it
+bool SearchStep(std::stringstream& stream, const std::vector<string> &wordParts, bool exact, string &wholeWord, SearchWalk &tokenWalk, bool &partStart)
+{
+    string partWord;
+    bool check=false;
+    char line[256];
+
+    tokenWalk.pos=-1;
+    partStart=false;
+    if(stream.peek()=='/')
+    {
+        stream.get();
+        if(stream.peek()=='/')
+        {
+            stream.getline(line,256);
+        }
+        else if(stream.peek()=='*')
+        {
+            stream.get();
+            while(stream)
+            {
+                if(stream.get()=='*')
+                {
+                    if(stream.get()=='/')
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    else if(stream.peek()=='\n')
+    {
+        stream.getline(line,256);
+    }
+    else if(stream.peek()=='\t')
+    {
+        stream.get();
+    }
+    else if(stream.peek()==' ')
+    {
+        stream.get();
+    }
+    else
+    {
+        SaveWalk(stream, tokenWalk, wholeWord);
+        for(int i=0; i<int(wordParts.size()); i++)
+        {
+            stream >> wholeWord;
+            if(int(wholeWord.length())>=int((wordParts[i]).length()))
+            {
+                if(exact)
+                {
+                    check=(wholeWord==(wordParts[i]));
+                    if(!check)
+                    {
+                        partStart = (i>0)||(wholeWord.compare(0, (wordParts[i]).length(), wordParts[i])==0)
+                                    ||(wholeWord.compare(wholeWord.length()-(wordParts[i]).length(), (wordParts[i]).length(), wordParts[i])==0);
+                        break;
+                    }
+                }
+                else
+                {
+                    partWord = wholeWord.substr(0, (wordParts[i]).length());
+                    check=(partWord==(wordParts[i]));
+
+                    if(check)
+                    {
+                        stream.seekg((partWord.length()-wholeWord.length()),std::ios_base::cur);
+                    }
+                    else if(0==i)
+                    {
+                        partWord = wholeWord.substr(wholeWord.length()-(wordParts[i]).length(), (wordParts[i]).length());
+                        check=(partWord==(wordParts[i]));
+                    }
+
+                    if(!check)
+                    {
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                partStart = exact&&(i>0);
+                break;
+            }
+        }
+    }
+    return check;
+}
+
+//SaveWalk
+//keeps the position and state of the stream, which are taken straight from its buffer so that a failed stream keeps its position
+void SaveWalk(std::stringstream& stream, SearchWalk &walk, const string &lastToken)
+{
+    walk.pos = int(stream.rdbuf()->pubseekoff(0, std::ios::cur, std::ios::in));
+    walk.state = stream.rdstate();
+    if(&walk.lastToken!=&lastToken)
+        walk.lastToken = lastToken;
+}
+
+void LoadWalk(std::stringstream& stream, const SearchWalk &walk)
+{
+    stream.clear();
+    stream.rdbuf()->pubseekpos(walk.pos, std::ios::in);
+    stream.setstate(walk.state);
+}
+
+bool SameWalk(const SearchWalk &walk1, const SearchWalk &walk2)
+{
+    return ((walk1.pos==walk2.pos)&&(walk1.state==walk2.state)&&(walk1.lastToken==walk2.lastToken));
+}
+
+// ExtractString
+// starting from the current position in the stream the function looks through the stream character by character checking if it meets the given format
+// and if so adding it to a string which is returned when the delimeter is found
+string ExtractString(std::stringstream &stream, char delim, int outType)
+{
+    string value="";
+    bool charOut=false, numOut=false, symOut=false;
+    char letter;
+    //bool first=true;
+
+    if(outType==0)
+    {
+
+    }
+    else if(outType==1)
+    {
+        charOut=true;
+    }
+    else if(outType==2)
+    {
+        numOut=true;
+    }
+    else if(outType==3)
+    {
+        charOut=true;
+        numOut=true;
+    }
+    else if(outType==4)
+    {
+        symOut=true;
+    }
+    else if(outType==5)
+    {
+        charOut=true;
+        symOut=true;
+    }
+    else if(outType==6)
+    {
+        numOut=true;
+        symOut=true;
+    }
+    else
+    {
+        charOut=true;
+        numOut=true;
+        symOut=true;
+    }
+
+    while(stream&&(stream.peek()!=delim)&&ScanWatchdog::Step())
+    {
+        letter = stream.get();
+        if(((letter>='A')&&(letter<='Z'))||((letter>='a')&&(letter<='z')))
+        {
+            if(charOut)
+            {
+                value+=letter;
+                //first=true;
+            }
+            /*else if(first)
+            {
+                value+=' ';
+                first=false;
+            }*/
+        }
+        else if(((letter>='0')&&(letter<='9'))||(letter=='.')||(letter=='-'))
+        {
+            if(numOut)
+            {
+                value+=letter;
+                //first=true;
+            }
+            /*else if(first)
+            {
+                value+=' ';
+                first=false;
+            }*/
+        }
+        else
+        {
+            if(symOut)
+            {
+                value+=letter;
+                //first=true;
+            }
+            /*else if(first)
+            {
+                value+=' ';
+                first=false;
+            }*/
+        }
+    }
+    return value;
+}
+
+// CropStream
+// overwirtes the given stream with the data between the given firstchar and last char of the stream
+void CropStream(std::stringstream& stream, int firstChar, int lastChar)
+{
+    if(lastChar==0)
+        stream.seekg( 0 , std::ios::end );
+    else
+        stream.seekg( lastChar , std::ios::beg );
+
+    int file_size = int(stream.tellg())-firstChar;
+    stream.seekg( firstChar , std::ios::beg );
+    char* filedata = new char[ file_size ];
+
+    stream.read( filedata , file_size );
+    if(!stream)
+    {
+        cout << "\n #### Error reading string stream ###" << endl;
+        return;
+    }
+    stream.str("");
+    stream.clear();
+
+    stream.write( filedata, file_size);
+    stream.seekg(0 , std::ios::beg);
+
+    delete filedata;
+}
+
+//FindMaterialList
+//Gets the G4Material objects stroed in the material map
+void FindMaterialList(std::stringstream& stream, std::vector<NameHandle> &matNameList)
+{
+    string name="";
+    while(MovePastWord(stream, "matMap["))
+    {
+        stream.get();
+
+        ExtractString(stream, '=', 0);
+
+        stream.get();
+
+        name=ExtractString(stream, ';', int(characters+numbers));
+        if(name!="")
+        {
+            matNameList.push_back(StringPool::Intern(name));
+        }
+        else
+        {
+            cout << "\nError: found a blank when trying to extract material name\n" << endl;
+        }
+        name.clear();
+
+    }
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+}
+
+//GetIsotopeList
+//takes in a data stream and a material name list and it searches the data stream for the isotopes that make up the material and their respective temperatures
+//then it outputs the information into a list of isotope names and a list of isotope temperatures
+void GetIsotopeList(std::stringstream& stream, std::vector<NameHandle> &matNameList, IsotopeTable &isoTable, std::stringstream &original, int numThreads)
+{
+    std::vector<MaterialTask> taskList, nestedList;
+
+    for(int i=0; i<int(matNameList.size()); i++)
+    {
+        MaterialTask task = {matNameList[i], false, 0., -1.};
+        taskList.push_back(task);
+    }
+
+    // the report follows the material being resolved on the parsing thread so it needs the materials to be resolved there
+    if((numThreads>1)&&!ProvenanceReport::IsActive())
+    {
+        ResolveMaterialsParallel(stream, original, taskList, isoTable, numThreads);
+        return;
+    }
+
+    // the text isn't changed while the materials are resolved, so the searches for words that aren't in it can be turned down
+    ScanFilter::Attach(stream, std::make_shared<ScanFilter>(stream.str()));
+    ScanFilter::Attach(original, std::make_shared<ScanFilter>(original.str()));
+
+    //if the material list is extended due to AddMaterial() being used in the geometry file the added materials are resolved after the others
+    //the rest of the materials are left once the geometry has used up its scanning budget
+    for(int i=0; (i<int(taskList.size()))&&!ScanWatchdog::Tripped(); i++)
+    {
+        nestedList.clear();
+        ResolveMaterial(stream, original, taskList[i], isoTable, nestedList);
+        taskList.insert(taskList.end(), nestedList.begin(), nestedList.end());
+    }
+
+    ScanFilter::Detach(stream);
+    ScanFilter::Detach(original);
+}
+
+//ResolveMaterial
+//finds the isotopes that make up one material and their temperatures, the materials that it is mixed from are added to the nestedList
+//along with the temperature of this material which they inherit
+void ResolveMaterial(std::stringstream& stream, std::stringstream &original, const MaterialTask &task, IsotopeTable &isoTable, std::vector<MaterialTask> &nestedList)
+{
+    std::vector<NameHandle> elemNameList, addedList;
+    std::vector<string> elemAmounts, addedAmounts;
+    std::vector<double> elemDensities;
+    double matTemp = task.temperature;
+    double matDensity = (task.nested ? task.density : -1.);
+    const string &matName = StringPool::GetName(task.name);
+
+    isoTable.SetCurrentMaterial(task.name);
+    ProvenanceReport::BeginMaterial(task.name, task.nested);
+
+    // find the constructor of the material object in the data stream
+    if(FindConstructor(stream, matName, isoTable, "Material", matTemp, &original, task.nested, matDensity))
+    {
+        //if this material is not part of another material, find the temperature and the density of the material
+        if(!task.nested)
+        {
+            matDensity=ReadDensity(stream, 0, &original);
+            matTemp=FindMatTemp(stream, matName, true, &original );
+        }
+
+        //find the G4Element objects that make up this material and if any materials are used to create the current material added them to the nestedList
+        FindElementList(stream, matName, addedList, elemNameList, isoTable, matTemp, addedAmounts, elemAmounts);
+        for(int j=0; j<int(addedList.size()); j++)
+        {
+            double fraction;
+            MaterialTask nested = {addedList[j], true, matTemp, -1.};
+            if((matDensity>=0.)&&ReadQuantity(addedAmounts[j], &original, fraction)&&(fraction>=0.))
+                nested.density = matDensity*fraction;
+            nestedList.push_back(nested);
+        }
+
+        //find the isotopes used to construct each element, along with the share of the material's density that each element has
+        FindElementDensities(stream, matDensity, elemNameList, elemAmounts, elemDensities, &original);
+        for(int j=0; j<int(elemNameList.size()); j++)
+        {
+            FindIsotopeList(stream, StringPool::GetName(elemNameList[j]), elemNameList, isoTable, matTemp,
+                            (j<int(elemDensities.size())) ? elemDensities[j] : -1., &original);
+        }
+    }
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+    ProvenanceReport::EndMaterial();
+}
+
+//ResolveMaterialsParallel
+//resolves the materials on a scheduler with numThreads workers, see MaterialResolution
+void ResolveMaterialsParallel(std::stringstream& stream, std::stringstream &original, const std::vector<MaterialTask> &taskList, IsotopeTable &isoTable, int numThreads)
+{
+    MaterialResolution resolution(stream.str(), original.str(), taskList, numThreads, ScanWatchdog::GetActive());
+    TaskScheduler scheduler(numThreads);
+
+    scheduler.Submit([&resolution, &scheduler](int worker){ resolution.Start(scheduler, worker, [](int){}); });
+    scheduler.Wait();
+
+    resolution.Drain(isoTable);
+}
+
+//FindConstructor
+//searches the data stream for the constructor of the given object
+bool FindConstructor(std::stringstream& stream, string name, IsotopeTable &isoTable, string matType,
+                    double matTemp, std::stringstream *original, bool matSet, double density)
+{
+    string check;
+    std::stringstream line;
+    int pos;
+    if(!MovePastWord(stream, (name+" =")))
+    {
+        cout << "\nError: could not find constructor for " << name << "\n" << endl;
+        return false;
+    }
+    else
+    {
+        pos=stream.tellg();
+        int count=0;
+
+        // materials and elements made by G4NistManager have no constructor to search, their makeup comes from the built-in table
+        if(matType!="Isotope")
+        {
+            string statement;
+            getline(stream, statement, ';');
+            stream.clear();
+            stream.seekg(pos, std::ios::beg);
+            if((statement.find("FindOrBuild")!=std::string::npos)||(statement.find("BuildMaterialWithNewDensity")!=std::string::npos))
+            {
+                if((matType=="Material")&&!matSet)
+                    matTemp=FindMatTemp(stream, name, true, original);
+                AddNistIsotopes(statement, name, isoTable, matTemp, density, (matType=="Material")&&!matSet, original);
+                return false;
+            }
+        }
+
+        if(matType=="Material")
+        {
+            bool intType=true;
+            int pos1=pos;
+            while((stream.peek()!=')')&&ScanWatchdog::Step(stream))
+            {
+                if(stream.get()==',')
+                {
+                    if(count==0)
+                    {
+                        pos1=stream.tellg();
+                    }
+                    count++;
+                }
+                if(count==3)
+                {
+                    line.str(ExtractString(stream, ')', int(characters+numbers+symbols))+")");
+                    line.seekg(0,std::ios::beg);
+                    bool test=false;
+                    while((line.peek()!=')')&&(line.peek()!=','))
+                    {
+                        if(line.get()=='.')
+                        {
+                            intType=false;
+                            break;
+                        }
+                        if(line.peek()==',')
+                        {
+                            test=true;
+                        }
+                    }
+                    if(intType)
+                    {
+                        line.seekg(0,std::ios::beg);
+                        string variable;
+                        double num;
+                        if(test)
+                        {
+                            variable = ExtractString(line, ',', int(characters+numbers));
+                        }
+                        else
+                        {
+                            variable = ExtractString(line, ')', int(characters+numbers));
+                        }
+                        if (findDouble(original, variable, num))
+                        {
+                            stringstream numConv;
+                            numConv << num;
+                            while(numConv)
+                            {
+                                if(numConv.get()=='.')
+                                {
+                                    intType=false;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                    if(intType)
+                    {
+                        intType = (!MovePastWord(line, "kState"));
+                    }
+                    line.str("");
+                    line.clear();
+                    break;
+                }
+            }
+            if(intType)
+            {
+                stream.seekg(pos1, std::ios::beg);
+                return true;
+            }
+            else
+            {
+                stream.seekg(pos1, std::ios::beg);
+                // the density of a single element material follows its Z and molar mass
+                if(!matSet)
+                {
+                    density=ReadDensity(stream, 2, original);
+                    matTemp=FindMatTemp(stream, name, false, original);
+                }
+                stream.seekg(pos1, std::ios::beg);
+                GetAndAddIsotope(stream, isoTable, matTemp, true, density);
+                return false;
+            }
+
+        }
+        else if(matType=="Element")
+        {
+            int count=0, pos1=0, pos2=0;
+            while((stream.peek()!=';')&&ScanWatchdog::Step(stream))
+            {
+                if(stream.get()==',')
+                {
+                    pos1=pos2;
+                    pos2=stream.tellg();
+                    count++;
+                }
+            }
+            if(count==3)
+            {
+                stream.seekg(pos1, std::ios::beg);
+                GetAndAddIsotope(stream, isoTable, matTemp, true, density);
+                return false;
+            }
+            else
+            {
+                stream.seekg(pos, std::ios::beg);
+                return true;
+            }
+        }
+        else
+        {
+            return true;
+        }
+    }
+}
+
+// FindMatTemp
+//finds the temperature of the given material in the data stream
+double FindMatTemp(std::stringstream& stream, string matName, bool normal, std::stringstream *original)
+{
+    int count=0, limit;
+    bool celsius=false, standard=true, number=true, first=true;
+    double temperature=0.;
+    char letter;
+    std::stringstream temp;
+
+    if(normal)
+    {
+        limit=3;
+    }
+    else
+    {
+        limit=4;
+    }
+
+    while((stream.peek()!=';')&&ScanWatchdog::Step(stream))
+    {
+        if((stream.get())==',')
+        {
+            count++;
+        }
+        if(limit==count)
+        {
+            standard=false;
+            break;
+        }
+    }
+    if(standard)
+    {
+        temperature=273.15;
+    }
+    else
+    {
+        while((stream.peek()!=',')&&(stream.peek()!=')')&&ScanWatchdog::Step(stream))
+        {
+            letter=stream.get();
+            if(((letter>='0')&&(letter<='9'))||(letter=='.')||(letter=='-'))
+            {
+                if(first)
+                {
+                    number=true;
+                    first=false;
+                }
+                temp << letter;
+            }
+            else if((((letter>='A')&&(letter<='Z'))||((letter>='a')&&(letter<='z')))||(letter=='[')||(letter==']')||(letter==','))
+            {
+                if((letter=='c')||(letter=='C'))
+                {
+                    celsius=true;
+                }
+                if(first)
+                {
+                    number=false;
+                    first=false;
+                }
+                if(!number)
+                    temp << letter;
+            }
+        }
+
+        if(temp.str()!="")
+        {
+            if(number)
+            {
+                temp >> temperature;
+                if(celsius)
+                {
+                    temperature+=273.15;
+                }
+            }
+            else if(original!=NULL)
+            {
+                if(!findDouble(original, temp.str(), temperature))
+                {
+                    cout << "\nError: couldn't find material temperature " << matName << endl;
+                }
+            }
+        }
+        else
+        {
+            cout << "\nError: unable to find temperature for " << matName << " in the expected position\n" << endl;
+        }
+    }
+
+    return temperature;
+}
+
+//findDouble
+//finds the value stored in the given variable, a variable that is set to another variable is followed up to maxLookupDepth deep
+bool findDouble(std::stringstream *stream, string variable, double &temperature, int depth)
+{
+    bool arrayElem=false, number=false, celsius=false, first=true;
+    std::vector<int> arrayIndex;
+    int index, pos1, pos2, count=0;
+    stringstream numConv, temp;
+    char letter;
+    stream->seekg(0, std::ios::beg);
+    ProvenanceReport::CountLookup();
+
+    while((!variable.empty())&&(variable.back()==']'))
+    {
+        arrayElem=true;
+        pos1=variable.find_first_of('[',0);
+        pos2=variable.find_first_of(']',0);
+        if(pos1<0)
+            break;
+        numConv.str(variable.substr(pos1,pos1-pos2-1));
+        numConv >> index;
+        numConv.clear();
+        numConv.str("");
+        arrayIndex.push_back(index);
+        variable.erase(pos1, pos2-pos1+1);
+    }
+
+    if(variable!="")
+    {
+        if(*stream)
+        {
+            if(MovePastWord((*stream),variable+" ="))
+            {
+                temp.str(ExtractString((*stream),';',int(numbers+characters)));
+                temp.str(temp.str()+';');
+
+                if(arrayElem)
+                {
+                    for(int i=0; i<int(arrayIndex.size()); i++)
+                    {
+                        ExtractString(temp,'{',0);
+                        temp.get();
+                        while((count!=arrayIndex[i])&&ScanWatchdog::Step(temp))
+                        {
+                            letter=temp.get();
+                            if(letter=='{')
+                            {
+                               ExtractString(temp,'}',0);
+                               temp.get();
+                            }
+                            else if(letter==',')
+                            {
+                                count++;
+                            }
+                        }
+                    }
+                }
+                while((temp.peek()!=',')&&(temp.peek()!=';')&&ScanWatchdog::Step(temp))
+                {
+                    letter=temp.get();
+                    if(((letter>='0')&&(letter<='9'))||(letter=='.')||(letter=='-'))
+                    {
+                        if(first)
+                        {
+                            number=true;
+                            first=false;
+                        }
+                        numConv << letter;
+                    }
+                    else if((((letter>='A')&&(letter<='Z'))||((letter>='a')&&(letter<='z')))||(letter=='[')||(letter==']')||(letter==','))
+                    {
+                        if((letter=='c')||(letter=='C'))
+                        {
+                            celsius=true;
+                        }
+                        if(first)
+                        {
+                            number=false;
+                            first=false;
+                        }
+                        if(!number)
+                            numConv << letter;
+                    }
+                }
+                if(number)
+                {
+                    numConv >> temperature;
+                    if(celsius)
+                    {
+                        temperature+=273.15;
+                    }
+                }
+                else if(depth>=maxLookupDepth)
+                {
+                    cout << "\nError: the value of " << variable << " is set through more than " << maxLookupDepth << " variables,"
+                         << " it may be set to itself" << endl;
+                    return false;
+                }
+                else
+                {
+                    (*stream).seekg(0,std::ios::beg);
+                    return findDouble(stream, numConv.str(), temperature, depth+1);
+                }
+
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+//FindElementList
+//Finds the elements used to create the given material
+//the mass fraction or number of atoms given with each element and the mass fraction of each material are added to the amount lists
+int FindElementList(std::stringstream& stream, string matName, std::vector<NameHandle> &matNameList, std::vector<NameHandle> &elemNameList, IsotopeTable &isoTable, double matTemp,
+                    std::vector<string> &matAmounts, std::vector<string> &elemAmounts)
+{
+    string name="", amount;
+    int addMat=0;
+    std::stringstream checkCon;
+
+    while(MovePastWord(stream, matName+" ->"))
+    {
+        name.clear();
+        name=ExtractString(stream, '(', int(characters));
+
+        stream.get();
+
+        if(name=="AddElement")
+        {
+            name.clear();
+            name=ExtractString(stream, ',', int(characters+numbers));
+            stream.get();
+            checkCon.clear();
+            checkCon.str(name);
+            if(MovePastWord(checkCon, "new G4Element"))
+            {
+                ExtractString(stream, ',', 0);
+                GetAndAddIsotope(stream, isoTable, matTemp, true);
+            }
+            else if(name!="")
+            {
+                elemNameList.push_back(StringPool::Intern(name));
+                ReadArgument(stream, amount);
+                elemAmounts.push_back(amount);
+            }
+            else
+            {
+                cout << "\nError: found a blank when trying to extract element name\n" << endl;
+            }
+        }
+        else if(name=="AddMaterial")
+        {
+            name.clear();
+
+            name=ExtractString(stream, ',', int(characters+numbers));
+            stream.get();
+            checkCon.clear();
+            checkCon.str(name);
+            if(MovePastWord(checkCon, "new G4Material"))
+            {
+                GetAndAddIsotope(stream, isoTable, matTemp, true);
+            }
+            else if(name!="")
+            {
+                matNameList.push_back(StringPool::Intern(name));
+                ReadArgument(stream, amount);
+                matAmounts.push_back(amount);
+                addMat++;
+            }
+            else
+            {
+                cout << "\nError: found a blank when trying to extract material name\n" << endl;
+            }
+        }
+
+    }
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+
+    return addMat;
+}
+
+// FindIsotopeList
+// finds the isotopes used to create the given element
+// density is the element's share of the material's density in g/cm3, it is split between the isotopes by their abundance and mass
+void FindIsotopeList(std::stringstream& stream, string elemName, std::vector<NameHandle> &elemNameList, IsotopeTable &isoTable, double matTemp,
+                     double density, std::stringstream *original)
+{
+    std::vector<NameHandle> isoObjectNameList;
+    std::vector<double> abundanceList;
+    std::vector<string> zNumList, massNumList;
+    std::vector<int> zList;
+    std::stringstream checkCon;
+    bool inlineIsotopes=false;
+
+    if(FindConstructor(stream, elemName, isoTable, "Element", matTemp, original, false, density))
+    {
+        string name="", amount;
+        while(MovePastWord(stream, elemName+" ->"))
+        {
+            name.clear();
+            name=ExtractString(stream, '(', int(characters));
+
+            stream.get();
+
+            if(name=="AddIsotope")
+            {
+                name.clear();
+                name=ExtractString(stream, ',', int(characters+numbers));
+                stream.get();
+                checkCon.clear();
+                checkCon.str(name);
+                if(MovePastWord(checkCon, "new G4Isotope"))
+                {
+                    GetAndAddIsotope(stream, isoTable, matTemp);
+                    inlineIsotopes=true;
+                }
+                else if(name!="")
+                {
+                    double abundance;
+                    isoObjectNameList.push_back(StringPool::Intern(name));
+                    ReadArgument(stream, amount);
+                    abundanceList.push_back(ReadQuantity(amount, original, abundance) ? abundance : -1.);
+                }
+                else
+                {
+                    cout << "\nError: found a blank when trying to extract isotope name\n" << endl;
+                }
+            }
+            else if(name=="AddElement")
+            {
+                name.clear();
+                name=ExtractString(stream, ',', int(characters+numbers));
+                stream.get();
+                checkCon.clear();
+                checkCon.str(name);
+                if(MovePastWord(checkCon, "new G4Element"))
+                {
+                    ExtractString(stream, ',', 0);
+                    GetAndAddIsotope(stream, isoTable, matTemp, true);
+                }
+                else if(name!="")
+                {
+                    elemNameList.push_back(StringPool::Intern(name));
+                }
+                else
+                {
+                    cout << "\nError: found a blank when trying to extract element name\n" << endl;
+                }
+            }
+        }
+        stream.clear();
+        stream.seekg(0, std::ios::beg);
+    }
+
+    for(int i=0; i<int(isoObjectNameList.size()); i++)
+    {
+        string zNum, massNum;
+        int Z=-1;
+        if(FindConstructor(stream, StringPool::GetName(isoObjectNameList[i]), isoTable, "Isotope"))
+        {
+            ExtractString(stream, ',', 0);
+            stream.get();
+
+            Z = ReadIsotope(stream, zNum, massNum);
+        }
+        else
+        {
+            cout << "\nError: couldn't fin isotope constructor for " << StringPool::GetName(isoObjectNameList[i]) << endl;
+        }
+        zList.push_back(Z);
+        zNumList.push_back(zNum);
+        massNumList.push_back(massNum);
+        //I changed this check and make sure it still works
+        stream.clear();
+        stream.seekg(0, std::ios::beg);
+    }
+
+    // the abundances count atoms, so each isotope's share of the element's mass is its abundance times its mass number
+    double totalMass = (inlineIsotopes ? -1. : 0.);
+    for(int i=0; (i<int(zList.size()))&&(totalMass>=0.); i++)
+    {
+        double A = strtod(massNumList[i].c_str(), NULL);
+        if((zList[i]<0)||(abundanceList[i]<0.)||(A<=0.))
+            totalMass=-1.;
+        else
+            totalMass+=abundanceList[i]*A;
+    }
+
+    for(int i=0; i<int(zList.size()); i++)
+    {
+        if(zList[i]>=0)
+        {
+            double numDensity = ((density>=0.)&&(totalMass>0.)) ? density*avogadro*abundanceList[i]/totalMass : -1.;
+            AddIsotopeLabel(isoTable, zList[i], zNumList[i], massNumList[i], matTemp, numDensity);
+        }
+    }
+}
+
+//GetAndAddIsotope
+//finds the isotope object, gets the isotope name and adds it to the isotope table along with the material temperature
+//density is the mass density in g/cm3 that the isotope or element has in the material, it is negative when it isn't known
+void GetAndAddIsotope(std::stringstream& stream, IsotopeTable &isoTable, double matTemp, bool natural, double density)
+{
+    string isoName, massNum;
+    int Z;
+
+    Z = ReadIsotope(stream, isoName, massNum);
+
+    // Geant4 builds an element that is given by its Z and its molar mass out of the natural isotopes of the element, a whole
+    // number mass is kept as the single isotope it names
+    double A = strtod(massNum.c_str(), NULL);
+    if(natural&&(A!=floor(A))&&AddNaturalIsotopes(isoTable, Z, matTemp, density))
+        return;
+
+    AddIsotopeLabel(isoTable, Z, isoName, massNum, matTemp, NumberDensity(density, A));
+}
+
+//ReadIsotope
+//reads the Z and the mass number (or molar mass) that come next in the stream, they are kept as they were written for the label
+//returns the Z, or 0 if it isn't the Z of an element
+int ReadIsotope(std::stringstream& stream, string &isoName, string &massNum)
+{
+    int Z;
+
+    isoName = ExtractString(stream, ',', int(numbers));
+
+    stream.get();
+    Z = int(strtol(isoName.c_str(), NULL, 10));
+    if((Z<0)||(Z>118))
+        Z=0;
+
+    massNum = ExtractString(stream, ',', int(numbers));
+    return Z;
+}
+
+//AddIsotopeLabel
+//adds the isotope with the given Z and mass number to the isotope table under the label Z_A_ElementName, the Z and A are written
+//into the label as they were given
+void AddIsotopeLabel(IsotopeTable &isoTable, int Z, string isoName, string massNum, double matTemp, double numDensity)
+{
+    isoName += '_';
+    isoName += massNum;
+    isoName += '_';
+    isoName += ElementNames::GetName(Z);
+
+    // the table ignores isotopes that it already has at this temperature
+    NameHandle label = StringPool::Intern(isoName);
+    isoTable.Add(Z, strtod(massNum.c_str(), NULL), label, matTemp, isoTable.GetCurrentMaterial(), numDensity);
+    ProvenanceReport::AddIsotope(label, matTemp);
+}
+
+//AddNistIsotopes
+//adds the natural isotopes of the elements of a material or element that is built by G4NistManager in the given statement,
+//FindOrBuildMaterial("G4_WATER") and FindOrBuildSimpleMaterial() name the material, BuildMaterialWithNewDensity() names the
+//material it copies second and FindOrBuildElement() takes the symbol or the Z of the element
+//density is the mass density it has in the material it is part of, with ownDensity the density of the NIST material is used instead
+void AddNistIsotopes(const string &statement, string name, IsotopeTable &isoTable, double matTemp, double density, bool ownDensity,
+                     std::stringstream *original)
+{
+    std::vector<string> quoted, args;
+    std::vector<NistComponent> components;
+    size_t pos=0, end;
+    double nistDensity;
+
+    while((pos=statement.find('"', pos))!=std::string::npos)
+    {
+        end = statement.find('"', pos+1);
+        if(end==std::string::npos)
+            break;
+        quoted.push_back(statement.substr(pos+1, end-pos-1));
+        pos=end+1;
+    }
+
+    if(statement.find("FindOrBuildElement")!=std::string::npos)
+    {
+        const NistElement *element=NULL;
+        if(!quoted.empty())
+        {
+            element = NistTable::FindElement(quoted[0]);
+        }
+        else if((pos=statement.find('(', statement.find("FindOrBuildElement")))!=std::string::npos)
+        {
+            element = NistTable::FindElement(int(strtol(statement.c_str()+pos+1, NULL, 10)));
+        }
+
+        if(element!=NULL)
+        {
+            NistComponent component = {element->Z, 1.};
+            components.push_back(component);
+        }
+    }
+    else
+    {
+        size_t argIndex = (statement.find("BuildMaterialWithNewDensity")!=std::string::npos) ? 1 : 0;
+        if(argIndex<quoted.size()&&NistTable::GetComposition(quoted[argIndex], components, nistDensity)&&ownDensity)
+        {
+            // BuildMaterialWithNewDensity() gives the new density third, without it the copy keeps the density of the material
+            SplitArguments(statement, args);
+            if((argIndex==0)||(args.size()<3)||!ReadQuantity(args[2], original, density)||(density<=0.))
+                density = nistDensity;
+        }
+    }
+
+    if(components.empty())
+    {
+        cout << "\nError: " << name << " is built by G4NistManager from a material or element that is not in the built-in table,"
+             << " its isotopes have to be added by hand\n" << endl;
+        return;
+    }
+
+    for(int i=0; i<int(components.size()); i++)
+    {
+        AddNaturalIsotopes(isoTable, components[i].Z, matTemp, (density<0.) ? -1. : density*components[i].fraction);
+    }
+}
+
+//AddNaturalIsotopes
+//adds the naturally occuring isotopes of the element with the given Z to the isotope table, returns false if the element isn't
+//in the natural abundance table, the element's mass density (in g/cm3, negative if unknown) is split between them
+bool AddNaturalIsotopes(IsotopeTable &isoTable, int Z, double matTemp, double density)
+{
+    int numIsotopes;
+    double totalMass=0.;
+    const NistIsotope *isotopes = NistTable::GetIsotopes(Z, numIsotopes);
+    for(int i=0; i<numIsotopes; i++)
+    {
+        totalMass+=isotopes[i].abundance*isotopes[i].A;
+    }
+
+    for(int i=0; i<numIsotopes; i++)
+    {
+        std::stringstream numConv;
+        string zNum, massNum;
+        numConv << Z << ' ' << isotopes[i].A;
+        numConv >> zNum >> massNum;
+        AddIsotopeLabel(isoTable, Z, zNum, massNum, matTemp,
+                        ((density>=0.)&&(totalMass>0.)) ? density*avogadro*isotopes[i].abundance/totalMass : -1.);
+    }
+    return (numIsotopes>0);
+}
+
+//NumberDensity
+//turns the mass density of an isotope or element in g/cm3 into its number of atoms per cm3, negative if either isn't known
+double NumberDensity(double density, double molarMass)
+{
+    if((density<0.)||(molarMass<=0.))
+        return -1.;
+    return density*avogadro/molarMass;
+}
+
+//FindElementDensities
+//works out the share of the material's density that each of its elements has from the mass fractions or the numbers of atoms
+//given to AddElement(), the atoms are weighed with the molar masses of the elements, a share that can't be worked out is -1
+//elements that are made inside of the AddElement() call aren't weighed, which can only make the other elements' shares larger
+void FindElementDensities(std::stringstream& stream, double matDensity, const std::vector<NameHandle> &elemNameList, const std::vector<string> &amountList,
+                          std::vector<double> &densityList, std::stringstream *original)
+{
+    std::vector<double> amounts(amountList.size(), -1.);
+    bool byAtoms=false;
+    double total=0.;
+
+    densityList.assign(amountList.size(), -1.);
+    if(matDensity<0.)
+        return;
+
+    // Geant4 takes a whole number as a number of atoms and anything else as a mass fraction, a mass fraction of 1 is the same either way
+    for(int i=0; i<int(amountList.size()); i++)
+    {
+        if(!ReadQuantity(amountList[i], original, amounts[i])||(amounts[i]<0.))
+            return;
+        if((amounts[i]>=1.)&&(amounts[i]==floor(amounts[i])))
+            byAtoms=true;
+    }
+
+    if(byAtoms)
+    {
+        for(int i=0; i<int(amounts.size()); i++)
+        {
+            double molarMass = FindMolarMass(stream, StringPool::GetName(elemNameList[i]), original);
+            if(molarMass<=0.)
+                return;
+            amounts[i]*=molarMass;
+            total+=amounts[i];
+        }
+        if(total<=0.)
+            return;
+    }
+
+    for(int i=0; i<int(amounts.size()); i++)
+    {
+        densityList[i] = matDensity*(byAtoms ? amounts[i]/total : amounts[i]);
+    }
+}
+
+//FindMolarMass
+//finds the molar mass in g/mole of the element with the given name from its constructor, an element made of isotopes has the
+//mass numbers of its isotopes averaged by their abundance, returns -1 if the molar mass can't be worked out
+double FindMolarMass(std::stringstream& stream, string elemName, std::stringstream *original)
+{
+    string statement, name, amount;
+    std::vector<string> args, isoNames;
+    std::vector<double> abundances;
+    double molarMass=-1., abundance, totalMass=0., total=0.;
+
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+    if(MovePastWord(stream, elemName+" ="))
+    {
+        getline(stream, statement, ';');
+        SplitArguments(statement, args);
+        if(statement.find("FindOrBuildElement")!=std::string::npos)
+        {
+            const NistElement *element=NULL;
+            if((args.size()>0)&&(args[0].find('"')!=std::string::npos))
+                element = NistTable::FindElement(args[0].substr(args[0].find('"')+1, args[0].rfind('"')-args[0].find('"')-1));
+            else if(args.size()>0)
+                element = NistTable::FindElement(int(strtol(args[0].c_str(), NULL, 10)));
+            if(element!=NULL)
+                molarMass = element->atomicWeight;
+        }
+        else if((args.size()==4)&&!ReadQuantity(args[3], original, molarMass))
+        {
+            molarMass=-1.;
+        }
+        else if(args.size()==3)
+        {
+            // the isotopes are added to the element after it is made
+            stream.clear();
+            stream.seekg(0, std::ios::beg);
+            while(MovePastWord(stream, elemName+" ->"))
+            {
+                name=ExtractString(stream, '(', int(characters));
+                stream.get();
+                if(name!="AddIsotope")
+                    continue;
+                name=ExtractString(stream, ',', int(characters+numbers));
+                stream.get();
+                ReadArgument(stream, amount);
+                isoNames.push_back(name);
+                abundances.push_back(ReadQuantity(amount, original, abundance) ? abundance : -1.);
+            }
+
+            for(int i=0; i<int(isoNames.size()); i++)
+            {
+                double massNum;
+                stream.clear();
+                stream.seekg(0, std::ios::beg);
+                if((abundances[i]<0.)||!MovePastWord(stream, isoNames[i]+" ="))
+                {
+                    total=0.;
+                    break;
+                }
+                getline(stream, statement, ';');
+                SplitArguments(statement, args);
+                if((args.size()<3)||!ReadQuantity(args[2], original, massNum))
+                {
+                    total=0.;
+                    break;
+                }
+                totalMass+=abundances[i]*massNum;
+                total+=abundances[i];
+            }
+            if(total>0.)
+                molarMass = totalMass/total;
+        }
+    }
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+    return molarMass;
+}
+
+//ReadDensity
+//reads the density given by the argument that is skip arguments on from the position of the stream, in g/cm3, the stream is left
+//where it was, returns -1 if the density can't be worked out
+double ReadDensity(std::stringstream& stream, int skip, std::stringstream *original)
+{
+    string argument;
+    double density;
+    int pos = stream.tellg();
+    if(pos<0)
+        return -1.;
+
+    for(int i=0; i<=skip; i++)
+    {
+        if((ReadArgument(stream, argument)!=',')&&(i<skip))
+        {
+            argument="";
+            break;
+        }
+    }
+    stream.clear();
+    stream.seekg(pos, std::ios::beg);
+
+    if(!ReadQuantity(argument, original, density)||(density<=0.))
+        return -1.;
+    return density;
+}
+
+//ReadArgument
+//reads the text of a function argument up to the comma or closing bracket that ends it, commas inside of brackets or quotes are
+//part of the argument, returns the character that ended it (',', ')' or ';') or '\0' at the end of the stream
+char ReadArgument(std::stringstream& stream, string &argument)
+{
+    int depth=0;
+    bool quoted=false;
+    char letter;
+
+    argument.clear();
+    while(stream.get(letter))
+    {
+        if(quoted)
+        {
+            if(letter=='"')
+                quoted=false;
+        }
+        else if(letter=='"')
+        {
+            quoted=true;
+        }
+        else if(letter=='(')
+        {
+            depth++;
+        }
+        else if((letter==')')&&(depth>0))
+        {
+            depth--;
+        }
+        else if((depth==0)&&((letter==',')||(letter==')')||(letter==';')))
+        {
+            return letter;
+        }
+        argument+=letter;
+    }
+    return '\0';
+}
+
+//SplitArguments
+//splits the arguments of the first call in the statement into the list
+void SplitArguments(const string &statement, std::vector<string> &args)
+{
+    std::stringstream stream;
+    string argument;
+    size_t pos = statement.find('(');
+
+    args.clear();
+    if(pos==std::string::npos)
+        return;
+    stream.str(statement.substr(pos+1));
+    while(ReadArgument(stream, argument)==',')
+    {
+        args.push_back(argument);
+    }
+    args.push_back(argument);
+}
+
+//ReadQuantity
+//works out the value of a product of numbers, Geant4 units and variables such as 10.4*g/cm3 or fuelDensity*perCent, variables are
+//looked up in original, returns false if the text has anything else in it
+bool ReadQuantity(string text, std::stringstream *original, double &value, int depth)
+{
+    size_t pos=0, end;
+    char op='*', *stop;
+    double factor;
+
+    text.erase(std::remove_if(text.begin(), text.end(), ::isspace), text.end());
+    while((text.length()>=2)&&(text[0]=='(')&&(text[text.length()-1]==')')&&(text.find_first_of("()", 1)==text.length()-1))
+    {
+        text = text.substr(1, text.length()-2);
+    }
+    if((text=="")||(text.find_first_of("()")!=std::string::npos))
+        return false;
+
+    value=1.;
+    while(true)
+    {
+        end = text.find_first_of("*/", pos);
+        if(end==std::string::npos)
+            end=text.length();
+        string part = text.substr(pos, end-pos);
+        if(part=="")
+            return false;
+
+        factor = strtod(part.c_str(), &stop);
+        if(*stop!='\0')
+        {
+            int i, numUnits = int(sizeof(unitSymbols)/sizeof(UnitSymbol));
+            for(i=0; (i<numUnits)&&(part!=unitSymbols[i].symbol); i++);
+            if(i<numUnits)
+            {
+                factor = unitSymbols[i].value;
+            }
+            else
+            {
+                if((original==NULL)||(depth>=maxQuantityDepth)||!(isalpha(part[0])||(part[0]=='_'))
+                    ||(part.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_")!=std::string::npos))
+                    return false;
+
+                string definition;
+                original->clear();
+                original->seekg(0, std::ios::beg);
+                if(!MovePastWord(*original, part+" ="))
+                    return false;
+                getline(*original, definition, ';');
+                if(!ReadQuantity(definition, original, factor, depth+1))
+                    return false;
+            }
+        }
+
+        if(op=='*')
+            value*=factor;
+        else if(factor!=0.)
+            value/=factor;
+        else
+            return false;
+
+        if(end==text.length())
+            break;
+        op=text[end];
+        pos=end+1;
+    }
+    return true;
+}
+
+//CreateMacroName
+//Generates the name for the macro file based off the geometry file name and the output directory
+string CreateMacroName(string geoFileName, string outDirName)
+{
+    geoFileName = CompressedInput::StripExtension(geoFileName);
+    if((geoFileName.substr(geoFileName.length()-3,3))==".cc")
+    {
+        geoFileName=geoFileName.substr(0,geoFileName.length()-3);
+    }
+    else if((geoFileName.length()>5)&&(geoFileName.substr(geoFileName.length()-5,5)==".gdml"))
+    {
+        geoFileName=geoFileName.substr(0,geoFileName.length()-5);
+    }
+    size_t pos = geoFileName.find_last_of('/');
+    size_t pos2 = std::string::npos;
+    if(pos == std::string::npos)
+        pos=0;
+    else
+        pos++;
+
+    if(geoFileName.length()>11)
+    {
+        string test = geoFileName.substr(geoFileName.length()-11, 11);
+        if((test=="Constructor")||(test=="constructor"))
+        {
+            pos2 = geoFileName.length()-11;
+        }
+    }
+
+    return (outDirName+"DoppBroadMacro"+geoFileName.substr(pos, pos2-pos)+".txt");
+}
+
+//SetDataStream
+//opens the file with the given name and stores the information contianed by the data stream inside of it
+void SetDataStream( string macroFileName, std::stringstream& ss)
+{
+  std::ofstream out( macroFileName.c_str() , std::ios::out | std::ios::trunc );
+  if ( ss.good() )
+  {
+     ss.seekg( 0 , std::ios::end );
+     int file_size = ss.tellg();
+     ss.seekg( 0 , std::ios::beg );
+     char* filedata = new char[ file_size ];
+
+     while ( ss )
+     {
+        ss.read( filedata , file_size );
+        if(!file_size)
+        {
+            cout << "\n #### Error the size of the stringstream is invalid ###" << endl;
+            break;
+        }
+     }
+
+     out.write(filedata, file_size);
+     if (out.fail())
+    {
+        cout << endl << "writing the ascii data to the output file " << macroFileName << " failed" << endl
+             << " may not have permission to delete an older version of the file" << endl;
+    }
+     out.close();
+     delete [] filedata;
+  }
+  else
+  {
+// found no data file
+//                 set error bit to the stream
+     ss.setstate( std::ios::badbit );
+
+     cout << endl << "### failed to write to ascii file " << macroFileName << " ###" << endl;
+  }
+   ss.str("");
+}
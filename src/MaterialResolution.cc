@@ -0,0 +1,122 @@
+#include "MaterialResolution.hh"
+#include "ScanFilter.hh"
+#include "ScanWatchdog.hh"
+#include <sstream>
+#include <memory>
+
+using namespace std;
+
+static std::atomic<long> nextResolutionId(1);
+
+// the copy of the material and symbol text of the resolution that the thread worked on last, the streams are moved around by
+// every search so a thread can't share them, a worker that keeps taking materials of the same geometry only copies the text once
+struct ThreadStreams
+{
+    long id;
+    std::stringstream stream, original;
+};
+
+static thread_local std::unique_ptr<ThreadStreams> threadStreams;
+
+MaterialResolution::MaterialResolution(const string &matText, const string &originalText, const std::vector<MaterialTask> &tasks, int numWorkers,
+                                       ScanWatchdog *watchdog)
+    : matText(matText), originalText(originalText), taskList(tasks), collector(numWorkers), watchdog(watchdog)
+{
+    matFilter = std::make_shared<ScanFilter>(matText);
+    originalFilter = std::make_shared<ScanFilter>(originalText);
+    waveStart=0;
+    waveEnd=0;
+    numRemaining=0;
+    scheduler=NULL;
+    id=nextResolutionId++;
+}
+
+MaterialResolution::~MaterialResolution()
+{
+    //dtor
+}
+
+//Start
+//spawns the tasks of the first wave onto the given worker, with no materials the done function is run right away
+void MaterialResolution::Start(TaskScheduler &sched, int worker, std::function<void(int)> done)
+{
+    scheduler=&sched;
+    onDone=done;
+    StartWave(worker);
+}
+
+void MaterialResolution::StartWave(int worker)
+{
+    waveEnd = uint32_t(taskList.size());
+    if(waveStart==waveEnd)
+    {
+        // the done function is allowed to delete the resolution so it is run from a copy
+        std::function<void(int)> done = onDone;
+        done(worker);
+        return;
+    }
+
+    nestedLists.assign(waveEnd-waveStart, std::vector<MaterialTask>());
+    numRemaining = int(waveEnd-waveStart);
+
+    // the materials are spawned last first so the worker that owns them takes them in order while the thieves take the last ones
+    for(uint32_t i=waveEnd; i>waveStart; i--)
+    {
+        uint32_t index=i-1;
+        scheduler->Spawn(worker, [this, index](int runner){ RunMaterial(runner, index); });
+    }
+}
+
+//RunMaterial
+//resolves the material at index in the material list, the worker that resolves the last material of a wave starts the next one
+void MaterialResolution::RunMaterial(int worker, uint32_t index)
+{
+    IsotopeTable matTable;
+
+    if((!threadStreams)||(threadStreams->id!=id))
+    {
+        // the filters of the last resolution are let go along with its text
+        if(threadStreams)
+        {
+            ScanFilter::Detach(threadStreams->stream);
+            ScanFilter::Detach(threadStreams->original);
+        }
+        threadStreams.reset(new ThreadStreams);
+        threadStreams->id=id;
+        threadStreams->stream.str(matText);
+        threadStreams->original.str(originalText);
+        ScanFilter::Attach(threadStreams->stream, matFilter);
+        ScanFilter::Attach(threadStreams->original, originalFilter);
+    }
+
+    // which materials a thread gets differs from run to run, so every material starts from the same stream state
+    threadStreams->stream.clear();
+    threadStreams->stream.seekg(0, std::ios::beg);
+    threadStreams->original.clear();
+    threadStreams->original.seekg(0, std::ios::beg);
+
+    // the materials left once the geometry has used up its budget are only counted off
+    ScanWatchdog *previous = ScanWatchdog::GetActive();
+    ScanWatchdog::SetActive(watchdog);
+    if(!ScanWatchdog::Tripped())
+        ResolveMaterial(threadStreams->stream, threadStreams->original, taskList[index], matTable, nestedLists[index-waveStart]);
+    ScanWatchdog::SetActive(previous);
+    collector.Insert(worker, index, matTable);
+
+    if(--numRemaining==0)
+    {
+        for(int i=0; i<int(nestedLists.size()); i++)
+        {
+            taskList.insert(taskList.end(), nestedLists[i].begin(), nestedLists[i].end());
+        }
+        waveStart=waveEnd;
+        StartWave(worker);
+    }
+}
+
+//Drain
+//adds the isotopes of every material to the table in the order that GetIsotopeList() would have added them
+void MaterialResolution::Drain(IsotopeTable &isoTable)
+{
+    collector.Drain(isoTable);
+}
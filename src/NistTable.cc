@@ -0,0 +1,356 @@
+#include "NistTable.hh"
+#include <unordered_map>
+
+using namespace std;
+
+// the stable isotopes of each element and their abundances in atom percent, ordered by Z and then A
+// the elements without stable isotopes are given their longest lived or most common isotope
+static const NistIsotope isotopeTable[] =
+{
+    {1, 1, 99.9885}, {1, 2, 0.0115},
+    {2, 3, 0.000134}, {2, 4, 99.999866},
+    {3, 6, 7.59}, {3, 7, 92.41},
+    {4, 9, 100},
+    {5, 10, 19.9}, {5, 11, 80.1},
+    {6, 12, 98.93}, {6, 13, 1.07},
+    {7, 14, 99.636}, {7, 15, 0.364},
+    {8, 16, 99.757}, {8, 17, 0.038}, {8, 18, 0.205},
+    {9, 19, 100},
+    {10, 20, 90.48}, {10, 21, 0.27}, {10, 22, 9.25},
+    {11, 23, 100},
+    {12, 24, 78.99}, {12, 25, 10.00}, {12, 26, 11.01},
+    {13, 27, 100},
+    {14, 28, 92.223}, {14, 29, 4.685}, {14, 30, 3.092},
+    {15, 31, 100},
+    {16, 32, 94.99}, {16, 33, 0.75}, {16, 34, 4.25}, {16, 36, 0.01},
+    {17, 35, 75.76}, {17, 37, 24.24},
+    {18, 36, 0.3336}, {18, 38, 0.0629}, {18, 40, 99.6035},
+    {19, 39, 93.2581}, {19, 40, 0.0117}, {19, 41, 6.7302},
+    {20, 40, 96.941}, {20, 42, 0.647}, {20, 43, 0.135}, {20, 44, 2.086}, {20, 46, 0.004},
+    {20, 48, 0.187},
+    {21, 45, 100},
+    {22, 46, 8.25}, {22, 47, 7.44}, {22, 48, 73.72}, {22, 49, 5.41}, {22, 50, 5.18},
+    {23, 50, 0.250}, {23, 51, 99.750},
+    {24, 50, 4.345}, {24, 52, 83.789}, {24, 53, 9.501}, {24, 54, 2.365},
+    {25, 55, 100},
+    {26, 54, 5.845}, {26, 56, 91.754}, {26, 57, 2.119}, {26, 58, 0.282},
+    {27, 59, 100},
+    {28, 58, 68.077}, {28, 60, 26.223}, {28, 61, 1.1399}, {28, 62, 3.6346}, {28, 64, 0.9255},
+    {29, 63, 69.15}, {29, 65, 30.85},
+    {30, 64, 49.17}, {30, 66, 27.73}, {30, 67, 4.04}, {30, 68, 18.45}, {30, 70, 0.61},
+    {31, 69, 60.108}, {31, 71, 39.892},
+    {32, 70, 20.57}, {32, 72, 27.45}, {32, 73, 7.75}, {32, 74, 36.50}, {32, 76, 7.73},
+    {33, 75, 100},
+    {34, 74, 0.89}, {34, 76, 9.37}, {34, 77, 7.63}, {34, 78, 23.77}, {34, 80, 49.61},
+    {34, 82, 8.73},
+    {35, 79, 50.69}, {35, 81, 49.31},
+    {36, 78, 0.355}, {36, 80, 2.286}, {36, 82, 11.593}, {36, 83, 11.500}, {36, 84, 56.987},
+    {36, 86, 17.279},
+    {37, 85, 72.17}, {37, 87, 27.83},
+    {38, 84, 0.56}, {38, 86, 9.86}, {38, 87, 7.00}, {38, 88, 82.58},
+    {39, 89, 100},
+    {40, 90, 51.45}, {40, 91, 11.22}, {40, 92, 17.15}, {40, 94, 17.38}, {40, 96, 2.80},
+    {41, 93, 100},
+    {42, 92, 14.53}, {42, 94, 9.15}, {42, 95, 15.84}, {42, 96, 16.67}, {42, 97, 9.60},
+    {42, 98, 24.39}, {42, 100, 9.82},
+    {43, 98, 100},
+    {44, 96, 5.54}, {44, 98, 1.87}, {44, 99, 12.76}, {44, 100, 12.60}, {44, 101, 17.06},
+    {44, 102, 31.55}, {44, 104, 18.62},
+    {45, 103, 100},
+    {46, 102, 1.02}, {46, 104, 11.14}, {46, 105, 22.33}, {46, 106, 27.33}, {46, 108, 26.46},
+    {46, 110, 11.72},
+    {47, 107, 51.839}, {47, 109, 48.161},
+    {48, 106, 1.25}, {48, 108, 0.89}, {48, 110, 12.49}, {48, 111, 12.80}, {48, 112, 24.13},
+    {48, 113, 12.22}, {48, 114, 28.73}, {48, 116, 7.49},
+    {49, 113, 4.29}, {49, 115, 95.71},
+    {50, 112, 0.97}, {50, 114, 0.66}, {50, 115, 0.34}, {50, 116, 14.54}, {50, 117, 7.68},
+    {50, 118, 24.22}, {50, 119, 8.59}, {50, 120, 32.58}, {50, 122, 4.63}, {50, 124, 5.79},
+    {51, 121, 57.21}, {51, 123, 42.79},
+    {52, 120, 0.09}, {52, 122, 2.55}, {52, 123, 0.89}, {52, 124, 4.74}, {52, 125, 7.07},
+    {52, 126, 18.84}, {52, 128, 31.74}, {52, 130, 34.08},
+    {53, 127, 100},
+    {54, 124, 0.0952}, {54, 126, 0.0890}, {54, 128, 1.9102}, {54, 129, 26.4006}, {54, 130, 4.0710},
+    {54, 131, 21.2324}, {54, 132, 26.9086}, {54, 134, 10.4357}, {54, 136, 8.8573},
+    {55, 133, 100},
+    {56, 130, 0.106}, {56, 132, 0.101}, {56, 134, 2.417}, {56, 135, 6.592}, {56, 136, 7.854},
+    {56, 137, 11.232}, {56, 138, 71.698},
+    {57, 138, 0.08881}, {57, 139, 99.91119},
+    {58, 136, 0.185}, {58, 138, 0.251}, {58, 140, 88.450}, {58, 142, 11.114},
+    {59, 141, 100},
+    {60, 142, 27.152}, {60, 143, 12.174}, {60, 144, 23.798}, {60, 145, 8.293}, {60, 146, 17.189},
+    {60, 148, 5.756}, {60, 150, 5.638},
+    {61, 145, 100},
+    {62, 144, 3.07}, {62, 147, 14.99}, {62, 148, 11.24}, {62, 149, 13.82}, {62, 150, 7.38},
+    {62, 152, 26.75}, {62, 154, 22.75},
+    {63, 151, 47.81}, {63, 153, 52.19},
+    {64, 152, 0.20}, {64, 154, 2.18}, {64, 155, 14.80}, {64, 156, 20.47}, {64, 157, 15.65},
+    {64, 158, 24.84}, {64, 160, 21.86},
+    {65, 159, 100},
+    {66, 156, 0.056}, {66, 158, 0.095}, {66, 160, 2.329}, {66, 161, 18.889}, {66, 162, 25.475},
+    {66, 163, 24.896}, {66, 164, 28.260},
+    {67, 165, 100},
+    {68, 162, 0.139}, {68, 164, 1.601}, {68, 166, 33.503}, {68, 167, 22.869}, {68, 168, 26.978},
+    {68, 170, 14.910},
+    {69, 169, 100},
+    {70, 168, 0.123}, {70, 170, 2.982}, {70, 171, 14.09}, {70, 172, 21.68}, {70, 173, 16.103},
+    {70, 174, 32.026}, {70, 176, 12.996},
+    {71, 175, 97.401}, {71, 176, 2.599},
+    {72, 174, 0.16}, {72, 176, 5.26}, {72, 177, 18.60}, {72, 178, 27.28}, {72, 179, 13.62},
+    {72, 180, 35.08},
+    {73, 180, 0.01201}, {73, 181, 99.98799},
+    {74, 180, 0.12}, {74, 182, 26.50}, {74, 183, 14.31}, {74, 184, 30.64}, {74, 186, 28.43},
+    {75, 185, 37.40}, {75, 187, 62.60},
+    {76, 184, 0.02}, {76, 186, 1.59}, {76, 187, 1.96}, {76, 188, 13.24}, {76, 189, 16.15},
+    {76, 190, 26.26}, {76, 192, 40.78},
+    {77, 191, 37.3}, {77, 193, 62.7},
+    {78, 190, 0.012}, {78, 192, 0.782}, {78, 194, 32.86}, {78, 195, 33.78}, {78, 196, 25.21},
+    {78, 198, 7.356},
+    {79, 197, 100},
+    {80, 196, 0.15}, {80, 198, 9.97}, {80, 199, 16.87}, {80, 200, 23.10}, {80, 201, 13.18},
+    {80, 202, 29.86}, {80, 204, 6.87},
+    {81, 203, 29.52}, {81, 205, 70.48},
+    {82, 204, 1.4}, {82, 206, 24.1}, {82, 207, 22.1}, {82, 208, 52.4},
+    {83, 209, 100},
+    {84, 209, 100},
+    {85, 210, 100},
+    {86, 222, 100},
+    {87, 223, 100},
+    {88, 226, 100},
+    {89, 227, 100},
+    {90, 232, 100},
+    {91, 231, 100},
+    {92, 234, 0.0054}, {92, 235, 0.7204}, {92, 238, 99.2742}
+};
+
+// the elements by Z, with their standard atomic weight in g/mole and the density of their NIST material in g/cm3
+static const NistElement elementTable[] =
+{
+    {1, "H", 1.008, 8.3748e-05}, {2, "He", 4.002602, 0.000166322}, {3, "Li", 6.94, 0.534},
+    {4, "Be", 9.0121831, 1.848}, {5, "B", 10.81, 2.37}, {6, "C", 12.011, 2.0},
+    {7, "N", 14.007, 0.0011652}, {8, "O", 15.999, 0.00133151}, {9, "F", 18.998403163, 0.00158029},
+    {10, "Ne", 20.1797, 0.000838505}, {11, "Na", 22.98976928, 0.971}, {12, "Mg", 24.305, 1.74},
+    {13, "Al", 26.9815385, 2.699}, {14, "Si", 28.085, 2.33}, {15, "P", 30.973761998, 2.2},
+    {16, "S", 32.06, 2.0}, {17, "Cl", 35.45, 0.00299473}, {18, "Ar", 39.948, 0.00166201},
+    {19, "K", 39.0983, 0.862}, {20, "Ca", 40.078, 1.55}, {21, "Sc", 44.955908, 2.989},
+    {22, "Ti", 47.867, 4.54}, {23, "V", 50.9415, 6.11}, {24, "Cr", 51.9961, 7.18},
+    {25, "Mn", 54.938044, 7.44}, {26, "Fe", 55.845, 7.874}, {27, "Co", 58.933194, 8.9},
+    {28, "Ni", 58.6934, 8.902}, {29, "Cu", 63.546, 8.96}, {30, "Zn", 65.38, 7.133},
+    {31, "Ga", 69.723, 5.904}, {32, "Ge", 72.630, 5.323}, {33, "As", 74.921595, 5.73},
+    {34, "Se", 78.971, 4.5}, {35, "Br", 79.904, 0.0070721}, {36, "Kr", 83.798, 0.00347832},
+    {37, "Rb", 85.4678, 1.532}, {38, "Sr", 87.62, 2.54}, {39, "Y", 88.90584, 4.469},
+    {40, "Zr", 91.224, 6.506}, {41, "Nb", 92.90637, 8.57}, {42, "Mo", 95.95, 10.22},
+    {43, "Tc", 98, 11.5}, {44, "Ru", 101.07, 12.41}, {45, "Rh", 102.90550, 12.41},
+    {46, "Pd", 106.42, 12.02}, {47, "Ag", 107.8682, 10.5}, {48, "Cd", 112.414, 8.65},
+    {49, "In", 114.818, 7.31}, {50, "Sn", 118.710, 7.31}, {51, "Sb", 121.760, 6.691},
+    {52, "Te", 127.60, 6.24}, {53, "I", 126.90447, 4.93}, {54, "Xe", 131.293, 0.00548536},
+    {55, "Cs", 132.90545196, 1.873}, {56, "Ba", 137.327, 3.5}, {57, "La", 138.90547, 6.154},
+    {58, "Ce", 140.116, 6.657}, {59, "Pr", 140.90766, 6.71}, {60, "Nd", 144.242, 6.9},
+    {61, "Pm", 145, 7.22}, {62, "Sm", 150.36, 7.46}, {63, "Eu", 151.964, 5.243},
+    {64, "Gd", 157.25, 7.9004}, {65, "Tb", 158.92535, 8.229}, {66, "Dy", 162.500, 8.55},
+    {67, "Ho", 164.93033, 8.795}, {68, "Er", 167.259, 9.066}, {69, "Tm", 168.93422, 9.321},
+    {70, "Yb", 173.045, 6.73}, {71, "Lu", 174.9668, 9.84}, {72, "Hf", 178.49, 13.31},
+    {73, "Ta", 180.94788, 16.654}, {74, "W", 183.84, 19.3}, {75, "Re", 186.207, 21.02},
+    {76, "Os", 190.23, 22.57}, {77, "Ir", 192.217, 22.42}, {78, "Pt", 195.084, 21.45},
+    {79, "Au", 196.966569, 19.32}, {80, "Hg", 200.592, 13.546}, {81, "Tl", 204.38, 11.72},
+    {82, "Pb", 207.2, 11.35}, {83, "Bi", 208.98040, 9.747}, {84, "Po", 209, 9.32},
+    {85, "At", 210, 9.32}, {86, "Rn", 222, 0.00900662}, {87, "Fr", 223, 1.0},
+    {88, "Ra", 226, 5.0}, {89, "Ac", 227, 10.07}, {90, "Th", 232.0377, 11.72},
+    {91, "Pa", 231.03588, 15.37}, {92, "U", 238.02891, 18.95}
+};
+
+// the compounds and mixtures, the components are atoms per molecule when byAtoms is set and mass fractions otherwise
+static const NistMaterial materialTable[] =
+{
+    {"G4_WATER", 1.0, true, {{1, 2}, {8, 1}}},
+    {"G4_WATER_VAPOR", 7.56182e-04, true, {{1, 2}, {8, 1}}},
+    {"G4_AIR", 1.20479e-03, false, {{6, 0.000124}, {7, 0.755268}, {8, 0.231781}, {18, 0.012827}}},
+    {"G4_Galactic", 1.0e-25, true, {{1, 1}}},
+    {"G4_CONCRETE", 2.3, false, {{1, 0.01}, {6, 0.001}, {8, 0.529107}, {11, 0.016}, {12, 0.002}, {13, 0.033872}, {14, 0.337021},
+                                 {19, 0.013}, {20, 0.044}, {26, 0.014}}},
+    {"G4_STAINLESS-STEEL", 8.0, true, {{26, 74}, {24, 18}, {28, 8}}},
+    {"G4_BRASS", 8.52, false, {{29, 0.62}, {30, 0.35}, {82, 0.03}}},
+    {"G4_BRONZE", 8.82, false, {{29, 0.89}, {30, 0.09}, {82, 0.02}}},
+    {"G4_GRAPHITE", 2.21, true, {{6, 1}}},
+    {"G4_lH2", 0.0708, true, {{1, 1}}},
+    {"G4_lN2", 0.807, true, {{7, 1}}},
+    {"G4_lO2", 1.141, true, {{8, 1}}},
+    {"G4_lAr", 1.396, true, {{18, 1}}},
+    {"G4_POLYETHYLENE", 0.94, true, {{1, 4}, {6, 2}}},
+    {"G4_POLYPROPYLENE", 0.9, true, {{1, 6}, {6, 3}}},
+    {"G4_POLYSTYRENE", 1.06, true, {{1, 8}, {6, 8}}},
+    {"G4_PLEXIGLASS", 1.19, true, {{1, 8}, {6, 5}, {8, 2}}},
+    {"G4_LUCITE", 1.19, true, {{1, 8}, {6, 5}, {8, 2}}},
+    {"G4_POLYCARBONATE", 1.2, true, {{1, 14}, {6, 16}, {8, 3}}},
+    {"G4_POLYVINYL_CHLORIDE", 1.3, true, {{1, 3}, {6, 2}, {17, 1}}},
+    {"G4_NYLON-6-6", 1.14, true, {{1, 22}, {6, 12}, {7, 2}, {8, 2}}},
+    {"G4_KAPTON", 1.42, true, {{1, 10}, {6, 22}, {7, 2}, {8, 5}}},
+    {"G4_MYLAR", 1.4, true, {{1, 8}, {6, 10}, {8, 4}}},
+    {"G4_TEFLON", 2.2, true, {{6, 2}, {9, 4}}},
+    {"G4_PARAFFIN", 0.93, true, {{1, 52}, {6, 25}}},
+    {"G4_CELLULOSE_CELLOPHANE", 1.42, true, {{1, 10}, {6, 6}, {8, 5}}},
+    {"G4_PLASTIC_SC_VINYLTOLUENE", 1.032, true, {{1, 10}, {6, 9}}},
+    {"G4_ETHYL_ALCOHOL", 0.7893, true, {{1, 6}, {6, 2}, {8, 1}}},
+    {"G4_METHANE", 6.67151e-04, true, {{1, 4}, {6, 1}}},
+    {"G4_PROPANE", 1.87939e-03, true, {{1, 8}, {6, 3}}},
+    {"G4_BUTANE", 2.49343e-03, true, {{1, 10}, {6, 4}}},
+    {"G4_CARBON_DIOXIDE", 1.84212e-03, true, {{6, 1}, {8, 2}}},
+    {"G4_SILICON_DIOXIDE", 2.32, true, {{14, 1}, {8, 2}}},
+    {"G4_GLASS_PLATE", 2.4, false, {{8, 0.4598}, {11, 0.0964}, {14, 0.3365}, {20, 0.1072}}},
+    {"G4_Pyrex_Glass", 2.23, false, {{5, 0.040064}, {8, 0.539562}, {11, 0.028191}, {13, 0.011644}, {14, 0.37722}, {19, 0.003321}}},
+    {"G4_ALUMINUM_OXIDE", 3.97, true, {{13, 2}, {8, 3}}},
+    {"G4_MAGNESIUM_OXIDE", 3.58, true, {{12, 1}, {8, 1}}},
+    {"G4_FERRIC_OXIDE", 5.2, true, {{26, 2}, {8, 3}}},
+    {"G4_LEAD_OXIDE", 9.53, true, {{82, 1}, {8, 1}}},
+    {"G4_BORON_CARBIDE", 2.52, true, {{5, 4}, {6, 1}}},
+    {"G4_BORON_OXIDE", 1.812, true, {{5, 2}, {8, 3}}},
+    {"G4_LITHIUM_FLUORIDE", 2.635, true, {{3, 1}, {9, 1}}},
+    {"G4_LITHIUM_HYDRIDE", 0.82, true, {{3, 1}, {1, 1}}},
+    {"G4_LITHIUM_CARBONATE", 2.11, true, {{3, 2}, {6, 1}, {8, 3}}},
+    {"G4_LITHIUM_TETRABORATE", 2.44, true, {{3, 2}, {5, 4}, {8, 7}}},
+    {"G4_CALCIUM_FLUORIDE", 3.18, true, {{20, 1}, {9, 2}}},
+    {"G4_BARIUM_FLUORIDE", 4.89, true, {{56, 1}, {9, 2}}},
+    {"G4_SODIUM_IODIDE", 3.667, true, {{11, 1}, {53, 1}}},
+    {"G4_CESIUM_IODIDE", 4.51, true, {{55, 1}, {53, 1}}},
+    {"G4_BGO", 7.13, true, {{83, 4}, {32, 3}, {8, 12}}},
+    {"G4_PbWO4", 8.28, true, {{82, 1}, {74, 1}, {8, 4}}},
+    {"G4_CADMIUM_TUNGSTATE", 7.9, true, {{48, 1}, {74, 1}, {8, 4}}},
+    {"G4_GADOLINIUM_OXYSULFIDE", 7.44, true, {{64, 2}, {8, 2}, {16, 1}}},
+    {"G4_URANIUM_OXIDE", 10.96, true, {{92, 1}, {8, 2}}},
+    {"G4_URANIUM_MONOCARBIDE", 13.63, true, {{92, 1}, {6, 1}}},
+    {"G4_URANIUM_DICARBIDE", 11.28, true, {{92, 1}, {6, 2}}},
+    {"G4_BONE_COMPACT_ICRU", 1.85, false, {{1, 0.064}, {6, 0.278}, {7, 0.027}, {8, 0.41}, {12, 0.002}, {15, 0.07}, {16, 0.002},
+                                          {20, 0.147}}},
+    {"G4_MUSCLE_STRIATED_ICRU", 1.04, false, {{1, 0.102}, {6, 0.123}, {7, 0.035}, {8, 0.729}, {11, 0.0008}, {12, 0.0002},
+                                             {15, 0.002}, {16, 0.005}, {19, 0.003}}},
+    {"G4_TISSUE_SOFT_ICRP", 1.03, false, {{1, 0.104472}, {6, 0.23219}, {7, 0.02488}, {8, 0.630238}, {11, 0.00113}, {12, 0.00013},
+                                         {15, 0.00133}, {16, 0.00199}, {17, 0.00134}, {19, 0.00199}, {20, 0.00023}, {26, 0.00005},
+                                         {30, 0.00003}}}
+};
+
+static const int numIsotopes = int(sizeof(isotopeTable)/sizeof(NistIsotope));
+static const int numElements = int(sizeof(elementTable)/sizeof(NistElement));
+static const int numMaterials = int(sizeof(materialTable)/sizeof(NistMaterial));
+
+// where the isotopes of each element start in the isotope table and how many it has, indexed by Z
+struct IsotopeRange
+{
+    int first, count;
+};
+
+// the lookup maps of the table, they are made from the constant tables the first time that one of them is needed
+struct NistIndex
+{
+    std::unordered_map<string, int> elements, materials;
+    IsotopeRange isotopes[numElements+1];
+
+    NistIndex()
+    {
+        for(int i=0; i<numElements; i++)
+        {
+            elements[elementTable[i].symbol] = i;
+        }
+        for(int i=0; i<numMaterials; i++)
+        {
+            materials[materialTable[i].name] = i;
+        }
+        for(int Z=0; Z<=numElements; Z++)
+        {
+            isotopes[Z].first=0;
+            isotopes[Z].count=0;
+        }
+        for(int i=numIsotopes-1; i>=0; i--)
+        {
+            isotopes[isotopeTable[i].Z].first=i;
+            isotopes[isotopeTable[i].Z].count++;
+        }
+    }
+};
+
+static const NistIndex& GetIndex()
+{
+    // made once even when several threads ask for it at the same time
+    static const NistIndex index;
+    return index;
+}
+
+NistTable::NistTable()
+{
+    //ctor
+}
+
+NistTable::~NistTable()
+{
+    //dtor
+}
+
+//FindElement
+//finds an element by its chemical symbol (H, Fe, ...), returns NULL if it is not in the table
+const NistElement* NistTable::FindElement(const string &symbol)
+{
+    const NistIndex &index = GetIndex();
+    std::unordered_map<string, int>::const_iterator it = index.elements.find(symbol);
+    if(it==index.elements.end())
+        return NULL;
+    return &elementTable[it->second];
+}
+
+const NistElement* NistTable::FindElement(int Z)
+{
+    if((Z<1)||(Z>numElements))
+        return NULL;
+    return &elementTable[Z-1];
+}
+
+//GetIsotopes
+//returns the natural isotopes of the element with the given Z, numIsotopes is set to 0 if the element is not in the table
+const NistIsotope* NistTable::GetIsotopes(int Z, int &numIsotopes)
+{
+    numIsotopes=0;
+    if((Z<1)||(Z>numElements))
+        return NULL;
+
+    const IsotopeRange &range = GetIndex().isotopes[Z];
+    numIsotopes = range.count;
+    return isotopeTable+range.first;
+}
+
+//GetComposition
+//finds the elements of the NIST material with the given name (G4_WATER, G4_Fe, ...) and their mass fractions, which add up to 1,
+//along with the density of the material in g/cm3, returns false if the material is not in the table
+bool NistTable::GetComposition(const string &materialName, std::vector<NistComponent> &massFractions, double &density)
+{
+    const NistIndex &index = GetIndex();
+    massFractions.clear();
+
+    std::unordered_map<string, int>::const_iterator it = index.materials.find(materialName);
+    if(it==index.materials.end())
+    {
+        // the single element materials are named after the symbol of their element
+        const NistElement *element = (materialName.substr(0,3)=="G4_") ? FindElement(materialName.substr(3)) : NULL;
+        if(element==NULL)
+            return false;
+
+        NistComponent component = {element->Z, 1.};
+        massFractions.push_back(component);
+        density = element->density;
+        return true;
+    }
+
+    const NistMaterial &material = materialTable[it->second];
+    double total=0.;
+    for(int i=0; (i<maxNistComponents)&&(material.components[i].Z!=0); i++)
+    {
+        NistComponent component = material.components[i];
+        // atom counts are turned into mass fractions with the atomic weight of the element
+        if(material.byAtoms)
+            component.fraction *= elementTable[component.Z-1].atomicWeight;
+        total+=component.fraction;
+        massFractions.push_back(component);
+    }
+    for(int i=0; i<int(massFractions.size()); i++)
+    {
+        massFractions[i].fraction/=total;
+    }
+    density = material.density;
+    return true;
+}
@@ -0,0 +1,436 @@
+#include "Preprocessor.hh"
+#include "MacroCreator.hh"
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+// the deepest chain of nested #includes that is followed, this also stops files that include each other
+const int maxIncludeDepth = 32;
+
+static bool IsIdentChar(char letter)
+{
+    return (isalnum((unsigned char)letter)||(letter=='_'));
+}
+
+static string Trim(const string &text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    if(first==std::string::npos)
+        return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last-first+1);
+}
+
+// CondParser
+// recursive descent evaluation of the integer expressions allowed in #if and #elif
+// identifiers that are not defined as numbers evaluate to 0 just like they do in the real preprocessor
+class CondParser
+{
+    public:
+        CondParser(const string &text, std::map<string,string> &defs) : expr(text), macros(defs), pos(0) {}
+        long ParseOr()
+        {
+            long value = ParseAnd();
+            while(Match("||"))
+            {
+                long rhs = ParseAnd();
+                value = (value||rhs);
+            }
+            return value;
+        }
+    protected:
+        long ParseAnd()
+        {
+            long value = ParseEquality();
+            while(Match("&&"))
+            {
+                long rhs = ParseEquality();
+                value = (value&&rhs);
+            }
+            return value;
+        }
+        long ParseEquality()
+        {
+            long value = ParseRelational();
+            while(true)
+            {
+                if(Match("=="))
+                    value = (value==ParseRelational());
+                else if(Match("!="))
+                    value = (value!=ParseRelational());
+                else
+                    return value;
+            }
+        }
+        long ParseRelational()
+        {
+            long value = ParseUnary();
+            while(true)
+            {
+                if(Match("<="))
+                    value = (value<=ParseUnary());
+                else if(Match(">="))
+                    value = (value>=ParseUnary());
+                else if(Match("<"))
+                    value = (value<ParseUnary());
+                else if(Match(">"))
+                    value = (value>ParseUnary());
+                else
+                    return value;
+            }
+        }
+        long ParseUnary()
+        {
+            if(Match("!"))
+                return !ParseUnary();
+            if(Match("-"))
+                return -ParseUnary();
+            if(Match("("))
+            {
+                long value = ParseOr();
+                Match(")");
+                return value;
+            }
+            SkipSpace();
+            if((pos<expr.length())&&isdigit((unsigned char)expr[pos]))
+            {
+                char *end;
+                long value = strtol(expr.c_str()+pos, &end, 0);
+                pos = end-expr.c_str();
+                while((pos<expr.length())&&IsIdentChar(expr[pos]))
+                    pos++;
+                return value;
+            }
+            string name = ParseIdent();
+            if(name=="defined")
+            {
+                bool paren = Match("(");
+                name = ParseIdent();
+                if(paren)
+                    Match(")");
+                return (macros.count(name)>0);
+            }
+            if((name!="")&&(macros.count(name)>0))
+            {
+                return atol(Trim(macros[name]).c_str());
+            }
+            if(name=="")
+                pos = expr.length();
+            return 0;
+        }
+        string ParseIdent()
+        {
+            SkipSpace();
+            size_t start=pos;
+            while((pos<expr.length())&&IsIdentChar(expr[pos]))
+                pos++;
+            return expr.substr(start, pos-start);
+        }
+        bool Match(const char *token)
+        {
+            SkipSpace();
+            string tok = token;
+            if(expr.compare(pos, tok.length(), tok)==0)
+            {
+                pos+=tok.length();
+                return true;
+            }
+            return false;
+        }
+        void SkipSpace()
+        {
+            while((pos<expr.length())&&isspace((unsigned char)expr[pos]))
+                pos++;
+        }
+    private:
+        string expr;
+        std::map<string,string> &macros;
+        size_t pos;
+};
+
+Preprocessor::Preprocessor()
+{
+    //ctor
+}
+
+Preprocessor::~Preprocessor()
+{
+    std::map<string, std::vector<string>*>::iterator it;
+    for(it=fileCache.begin(); it!=fileCache.end(); it++)
+    {
+        delete it->second;
+    }
+}
+
+void Preprocessor::AddIncludePath(string dirName)
+{
+    if((dirName!="")&&(dirName[dirName.length()-1]!='/'))
+        dirName+='/';
+    includePaths.push_back(dirName);
+}
+
+void Preprocessor::Define(string name, string value)
+{
+    predefined[name]=value;
+}
+
+//Expand
+//replaces the contents of the stream with the preprocessed version of it, fileName is used to find the files it includes
+void Preprocessor::Expand(std::stringstream &stream, string fileName)
+{
+    std::vector<string> lines;
+    std::map<string,string> macros(predefined);
+    std::stringstream out;
+
+    SplitLines(stream.str(), lines);
+    ExpandLines(lines, fileName, macros, out, 0);
+
+    stream.str(out.str());
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+}
+
+//LoadFile
+//returns the lines of the given file reading it the first time it is asked for, NULL if the file doesn't exist
+const std::vector<string>* Preprocessor::LoadFile(string fileName)
+{
+    std::map<string, std::vector<string>*>::iterator it = fileCache.find(fileName);
+    if(it!=fileCache.end())
+        return it->second;
+
+    std::stringstream data;
+    std::vector<string> *lines = NULL;
+    GetDataStream(fileName, data);
+    if(data.good())
+    {
+        lines = new std::vector<string>;
+        SplitLines(data.str(), *lines);
+    }
+    fileCache[fileName]=lines;
+    return lines;
+}
+
+//ResolveInclude
+//looks for the included file first in the directory of the including file and then in each of the include paths
+bool Preprocessor::ResolveInclude(string name, string currentDir, string &path)
+{
+    if((name!="")&&(name[0]=='/'))
+    {
+        path=name;
+        return (LoadFile(path)!=NULL);
+    }
+
+    path=currentDir+name;
+    if(LoadFile(path)!=NULL)
+        return true;
+
+    for(int i=0; i<int(includePaths.size()); i++)
+    {
+        path=includePaths[i]+name;
+        if(LoadFile(path)!=NULL)
+            return true;
+    }
+    return false;
+}
+
+//ExpandLines
+//writes the lines that are active under the current conditionals to the out stream with their macros expanded and their includes inserted
+//directive lines are replaced with blank lines so that the line numbers of the file itself are kept
+void Preprocessor::ExpandLines(const std::vector<string> &lines, string fileName, std::map<string,string> &macros, std::stringstream &out, int depth)
+{
+    std::vector<CondState> condStack;
+    std::set<string> active;
+    string currentDir;
+    bool isActive=true;
+
+    size_t slash = fileName.find_last_of('/');
+    if(slash!=std::string::npos)
+        currentDir = fileName.substr(0, slash+1);
+
+    for(int i=0; i<int(lines.size()); i++)
+    {
+        string line = lines[i];
+
+        // joins lines that are continued with a backslash
+        while((line!="")&&(line[line.length()-1]=='\\')&&(i+1<int(lines.size())))
+        {
+            line = line.substr(0, line.length()-1)+lines[++i];
+            out << '\n';
+        }
+
+        string text = Trim(line);
+        if((text=="")||(text[0]!='#'))
+        {
+            if(isActive)
+                out << ExpandMacros(line, macros, active);
+            out << '\n';
+            continue;
+        }
+
+        text = Trim(text.substr(1));
+        size_t end=0;
+        while((end<text.length())&&IsIdentChar(text[end]))
+            end++;
+        string directive = text.substr(0, end), rest = Trim(text.substr(end));
+
+        // removes a trailing line comment from the directive
+        size_t comment = rest.find("//");
+        if(comment!=std::string::npos)
+            rest = Trim(rest.substr(0, comment));
+
+        if((directive=="ifdef")||(directive=="ifndef")||(directive=="if"))
+        {
+            CondState state;
+            state.parentActive=isActive;
+            if(directive=="if")
+                state.active = isActive&&(EvalCondition(rest, macros)!=0);
+            else
+                state.active = isActive&&((macros.count(rest)>0)==(directive=="ifdef"));
+            state.taken=state.active;
+            condStack.push_back(state);
+            isActive=state.active;
+        }
+        else if((directive=="elif")&&!condStack.empty())
+        {
+            CondState &state = condStack.back();
+            state.active = state.parentActive&&!state.taken&&(EvalCondition(rest, macros)!=0);
+            state.taken = state.taken||state.active;
+            isActive=state.active;
+        }
+        else if((directive=="else")&&!condStack.empty())
+        {
+            CondState &state = condStack.back();
+            state.active = state.parentActive&&!state.taken;
+            state.taken = true;
+            isActive=state.active;
+        }
+        else if((directive=="endif")&&!condStack.empty())
+        {
+            isActive = condStack.back().parentActive;
+            condStack.pop_back();
+        }
+        else if(!isActive)
+        {
+        }
+        else if(directive=="define")
+        {
+            end=0;
+            while((end<rest.length())&&IsIdentChar(rest[end]))
+                end++;
+            // function-like macros are not expanded
+            if((end<rest.length())&&(rest[end]=='('))
+                macros.erase(rest.substr(0, end));
+            else if(end>0)
+                macros[rest.substr(0, end)] = Trim(rest.substr(end));
+        }
+        else if(directive=="undef")
+        {
+            macros.erase(rest);
+        }
+        else if((directive=="include")&&(rest.length()>1)&&(rest[0]=='"'))
+        {
+            string name = rest.substr(1, rest.find('"', 1)-1), path;
+            if((depth<maxIncludeDepth)&&ResolveInclude(name, currentDir, path))
+            {
+                ExpandLines(*LoadFile(path), path, macros, out, depth+1);
+            }
+        }
+        out << '\n';
+    }
+
+    if(!condStack.empty())
+    {
+        cout << "\nError: missing #endif in " << fileName << endl;
+    }
+}
+
+//ExpandMacros
+//replaces every identifier in the line that names an object-like macro with the expanded macro body
+//string and character literals and line comments are copied unchanged, active holds the macros being expanded to stop recursion
+string Preprocessor::ExpandMacros(const string &line, std::map<string,string> &macros, std::set<string> &active)
+{
+    string result;
+    size_t i=0;
+
+    if(macros.empty())
+        return line;
+
+    while(i<line.length())
+    {
+        char letter = line[i];
+        if((letter=='"')||(letter=='\''))
+        {
+            size_t end=i+1;
+            while((end<line.length())&&(line[end]!=letter))
+            {
+                if(line[end]=='\\')
+                    end++;
+                end++;
+            }
+            end = (end<line.length()) ? end+1 : line.length();
+            result+=line.substr(i, end-i);
+            i=end;
+        }
+        else if((letter=='/')&&(i+1<line.length())&&(line[i+1]=='/'))
+        {
+            result+=line.substr(i);
+            break;
+        }
+        else if(IsIdentChar(letter))
+        {
+            size_t end=i;
+            while((end<line.length())&&IsIdentChar(line[end]))
+                end++;
+            string name = line.substr(i, end-i);
+            std::map<string,string>::iterator it = macros.find(name);
+
+            if(isalpha((unsigned char)letter)||(letter=='_'))
+            {
+                if((it!=macros.end())&&(active.count(name)==0))
+                {
+                    active.insert(name);
+                    result+=ExpandMacros(it->second, macros, active);
+                    active.erase(name);
+                }
+                else
+                {
+                    result+=name;
+                }
+            }
+            else
+            {
+                result+=name;
+            }
+            i=end;
+        }
+        else
+        {
+            result+=letter;
+            i++;
+        }
+    }
+    return result;
+}
+
+//EvalCondition
+//evaluates the expression of an #if or #elif directive
+long Preprocessor::EvalCondition(string expr, std::map<string,string> &macros)
+{
+    CondParser parser(expr, macros);
+    return parser.ParseOr();
+}
+
+void Preprocessor::SplitLines(const string &text, std::vector<string> &lines)
+{
+    size_t start=0, end;
+    while(start<text.length())
+    {
+        end = text.find('\n', start);
+        if(end==std::string::npos)
+            end=text.length();
+        lines.push_back(text.substr(start, end-start));
+        start=end+1;
+    }
+}
@@ -0,0 +1,254 @@
+#include "ProvenanceReport.hh"
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+thread_local ProvenanceReport *ProvenanceReport::active = NULL;
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+ProvenanceReport::ProvenanceReport()
+{
+    current=-1;
+    matStream=NULL;
+}
+
+ProvenanceReport::~ProvenanceReport()
+{
+    if(active==this)
+        active=NULL;
+}
+
+//SetActive
+//makes the given report the one that the parser running on this thread reports to, NULL turns the reporting off
+void ProvenanceReport::SetActive(ProvenanceReport *report)
+{
+    active=report;
+}
+
+void ProvenanceReport::BeginGeometry(string sourceName, string headerName, bool fromSnapshot)
+{
+    GeometryRecord record;
+    record.sourceName=sourceName;
+    record.headerName=headerName;
+    record.fromSnapshot=fromSnapshot;
+    record.seconds=0.;
+    record.scans=0;
+    record.lookups=0;
+    geometries.push_back(record);
+
+    current=-1;
+    matStream=NULL;
+    lineStarts.clear();
+    lineMarks.clear();
+    geoStart=std::chrono::steady_clock::now();
+}
+
+void ProvenanceReport::EndGeometry()
+{
+    if(!geometries.empty())
+        geometries.back().seconds=SecondsSince(geoStart);
+    current=-1;
+    matStream=NULL;
+}
+
+//BeginMaterial
+//starts the record of the material from the material list, nested is set for the materials that were only found through AddMaterial()
+void ProvenanceReport::BeginMaterial(NameHandle material, bool nested)
+{
+    if((active==NULL)||active->geometries.empty())
+        return;
+
+    MaterialRecord record;
+    record.name=material;
+    record.nested=nested;
+    record.seconds=0.;
+    record.scans=0;
+    record.lookups=0;
+
+    std::vector<MaterialRecord> &materials = active->geometries.back().materials;
+    materials.push_back(record);
+    active->current=int(materials.size())-1;
+    active->matStart=std::chrono::steady_clock::now();
+}
+
+void ProvenanceReport::EndMaterial()
+{
+    if((active==NULL)||(active->current<0))
+        return;
+    active->geometries.back().materials[active->current].seconds=SecondsSince(active->matStart);
+    active->current=-1;
+}
+
+//MapLines
+//sets the stream that the materials are searched in, the line marks give the lines of the source file that the lines of the stream came from
+void ProvenanceReport::MapLines(std::stringstream &stream, const std::vector<LineMark> &marks)
+{
+    if(active==NULL)
+        return;
+
+    const string text = stream.str();
+    active->matStream=&stream;
+    active->lineMarks=marks;
+    active->lineStarts.assign(1, 0);
+    for(size_t i=0; i<text.length(); i++)
+    {
+        if(text[i]=='\n')
+            active->lineStarts.push_back(long(i+1));
+    }
+}
+
+//CountScan
+//counts a search of the stream, when the search found what it was looking for in the material stream the source line it ended on is kept
+void ProvenanceReport::CountScan(std::stringstream &stream, bool found)
+{
+    if((active==NULL)||active->geometries.empty())
+        return;
+
+    active->geometries.back().scans++;
+    if(active->current<0)
+        return;
+
+    MaterialRecord &record = active->geometries.back().materials[active->current];
+    record.scans++;
+    if(found&&(&stream==active->matStream))
+    {
+        long offset = stream.tellg();
+        if(offset>=0)
+            record.lines.push_back(active->SourceLine(offset));
+    }
+}
+
+void ProvenanceReport::CountLookup()
+{
+    if((active==NULL)||active->geometries.empty())
+        return;
+
+    active->geometries.back().lookups++;
+    if(active->current>=0)
+        active->geometries.back().materials[active->current].lookups++;
+}
+
+void ProvenanceReport::AddIsotope(NameHandle label, double temperature)
+{
+    if((active==NULL)||(active->current<0))
+        return;
+
+    MaterialRecord &record = active->geometries.back().materials[active->current];
+    record.isoLabels.push_back(label);
+    record.isoTemps.push_back(temperature);
+}
+
+//SourceLine
+//converts an offset into the material stream into the line of the source file it was copied from
+long ProvenanceReport::SourceLine(long offset)
+{
+    long textLine = long(std::upper_bound(lineStarts.begin(), lineStarts.end(), offset)-lineStarts.begin());
+
+    for(int i=int(lineMarks.size())-1; i>=0; i--)
+    {
+        if(lineMarks[i].textLine<=textLine)
+            return lineMarks[i].sourceLine+(textLine-lineMarks[i].textLine);
+    }
+    return textLine;
+}
+
+//Write
+//stores the report as a JSON document, returns false if the file could not be written
+bool ProvenanceReport::Write(string fileName)
+{
+    std::ofstream out(fileName.c_str(), std::ios::out | std::ios::trunc);
+    if(!out.good())
+        return false;
+
+    out << std::setprecision(9) << "{\n  \"geometries\": [";
+    for(int i=0; i<int(geometries.size()); i++)
+    {
+        const GeometryRecord &geo = geometries[i];
+        out << ((i>0) ? ",\n" : "\n") << "    {\n      \"source\": ";
+        WriteString(out, geo.sourceName);
+        out << ",\n      \"header\": ";
+        WriteString(out, geo.headerName);
+        out << ",\n      \"snapshot\": " << (geo.fromSnapshot ? "true" : "false") << ",\n      \"seconds\": " << geo.seconds
+            << ",\n      \"scans\": " << geo.scans << ",\n      \"lookups\": " << geo.lookups << ",\n      \"materials\": [";
+
+        for(int j=0; j<int(geo.materials.size()); j++)
+        {
+            const MaterialRecord &mat = geo.materials[j];
+            out << ((j>0) ? ",\n" : "\n") << "        {\"name\": ";
+            WriteString(out, StringPool::GetName(mat.name));
+            out << ", \"index\": " << j << ", \"nested\": " << (mat.nested ? "true" : "false") << ", \"seconds\": " << mat.seconds
+                << ", \"scans\": " << mat.scans << ", \"lookups\": " << mat.lookups << ",\n         \"lines\": ";
+            WriteLineRanges(out, mat.lines);
+            out << ",\n         \"isotopes\": [";
+            for(int k=0; k<int(mat.isoLabels.size()); k++)
+            {
+                out << ((k>0) ? ", " : "") << "{\"label\": ";
+                WriteString(out, StringPool::GetName(mat.isoLabels[k]));
+                out << ", \"temperature\": ";
+                if(std::isfinite(mat.isoTemps[k]))
+                    out << mat.isoTemps[k];
+                else
+                    out << "null";
+                out << "}";
+            }
+            out << "]}";
+        }
+        out << ((geo.materials.empty()) ? "]\n    }" : "\n      ]\n    }");
+    }
+    out << ((geometries.empty()) ? "]\n}\n" : "\n  ]\n}\n");
+
+    return out.good();
+}
+
+//WriteString
+//writes the text as a quoted JSON string
+void ProvenanceReport::WriteString(std::ostream &out, const string &text)
+{
+    char code[8];
+    out << '"';
+    for(size_t i=0; i<text.length(); i++)
+    {
+        unsigned char letter = text[i];
+        if((letter=='"')||(letter=='\\'))
+        {
+            out << '\\' << letter;
+        }
+        else if(letter<0x20)
+        {
+            snprintf(code, sizeof(code), "\\u%04x", letter);
+            out << code;
+        }
+        else
+        {
+            out << letter;
+        }
+    }
+    out << '"';
+}
+
+//WriteLineRanges
+//writes the lines as a list of [first, last] ranges of consecutive lines
+void ProvenanceReport::WriteLineRanges(std::ostream &out, std::vector<long> lines)
+{
+    std::sort(lines.begin(), lines.end());
+    lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+    out << "[";
+    for(int i=0; i<int(lines.size()); i++)
+    {
+        int last=i;
+        while((last+1<int(lines.size()))&&(lines[last+1]==lines[last]+1))
+            last++;
+        out << ((i>0) ? ", " : "") << "[" << lines[i] << ", " << lines[last] << "]";
+        i=last;
+    }
+    out << "]";
+}
@@ -0,0 +1,147 @@
+#include "ScanFilter.hh"
+#include <cstring>
+
+using namespace std;
+
+thread_local std::vector<ScanFilter::Attachment> ScanFilter::attachments;
+
+// the Bloom filter has about this many bits for every letter of the text, which keeps the false positives under one percent
+const size_t bitsPerLetter = 8;
+const size_t minTripleBits = size_t(1)<<12, maxTripleBits = size_t(1)<<24;
+
+static uint64_t HashTriple(uint32_t triple)
+{
+    return uint64_t(triple)*0x9e3779b97f4a7c15ULL;
+}
+
+ScanFilter::ScanFilter(const string &text)
+{
+    size_t numBits = minTripleBits;
+    while((numBits<maxTripleBits)&&(numBits<text.length()*bitsPerLetter))
+        numBits<<=1;
+    tripleBits.assign(numBits/64, 0);
+    tripleMask = numBits-1;
+    memset(pairBits, 0, sizeof(pairBits));
+    memset(letterBits, 0, sizeof(letterBits));
+
+    uint32_t pair=0, triple=0;
+    for(size_t i=0; i<text.length(); i++)
+    {
+        uint32_t letter = (unsigned char)text[i];
+        letterBits[letter>>6] |= uint64_t(1)<<(letter&63);
+        pair = ((pair<<8)|letter)&0xffff;
+        triple = ((triple<<8)|letter)&0xffffff;
+        if(i>=1)
+            pairBits[pair>>6] |= uint64_t(1)<<(pair&63);
+        if(i>=2)
+            AddTriple(triple);
+    }
+}
+
+ScanFilter::~ScanFilter()
+{
+    //dtor
+}
+
+//MayContain
+//returns false only if the part is certainly not somewhere in the text
+bool ScanFilter::MayContain(const string &part) const
+{
+    uint32_t pair=0, triple=0;
+    for(size_t i=0; i<part.length(); i++)
+    {
+        uint32_t letter = (unsigned char)part[i];
+        if(!(letterBits[letter>>6]&(uint64_t(1)<<(letter&63))))
+            return false;
+        pair = ((pair<<8)|letter)&0xffff;
+        triple = ((triple<<8)|letter)&0xffffff;
+        if((i>=1)&&!(pairBits[pair>>6]&(uint64_t(1)<<(pair&63))))
+            return false;
+        if((i>=2)&&!HasTriple(triple))
+            return false;
+    }
+    return true;
+}
+
+// each sequence sets two bits, taken from the two halves of its hash
+void ScanFilter::AddTriple(uint32_t triple)
+{
+    uint64_t hash = HashTriple(triple);
+    uint64_t bit1 = (hash>>40)&tripleMask, bit2 = (hash>>16)&tripleMask;
+    tripleBits[bit1>>6] |= uint64_t(1)<<(bit1&63);
+    tripleBits[bit2>>6] |= uint64_t(1)<<(bit2&63);
+}
+
+bool ScanFilter::HasTriple(uint32_t triple) const
+{
+    uint64_t hash = HashTriple(triple);
+    uint64_t bit1 = (hash>>40)&tripleMask, bit2 = (hash>>16)&tripleMask;
+    return ((tripleBits[bit1>>6]&(uint64_t(1)<<(bit1&63)))&&(tripleBits[bit2>>6]&(uint64_t(1)<<(bit2&63))));
+}
+
+//Attach
+//uses the filter for the searches made in the stream on this thread until it is detached, the stream must keep the text the
+//filter was made from until then, attaching a new filter to a stream drops the searches remembered for the old one
+void ScanFilter::Attach(std::stringstream &stream, std::shared_ptr<const ScanFilter> filter)
+{
+    Attachment *attachment = FindAttachment(stream);
+    if(attachment==NULL)
+    {
+        attachments.push_back(Attachment());
+        attachment = &attachments.back();
+        attachment->stream = &stream;
+    }
+    attachment->filter = filter;
+    attachment->misses.clear();
+}
+
+void ScanFilter::Detach(std::stringstream &stream)
+{
+    for(int i=0; i<int(attachments.size()); i++)
+    {
+        if(attachments[i].stream==&stream)
+        {
+            attachments.erase(attachments.begin()+i);
+            break;
+        }
+    }
+}
+
+//RulesOut
+//checks whether a search for the word starting at start in the stream is certain to fail, either because the word's first part
+//isn't in the text or because the same search has already failed
+//only the first part is checked since MovePastWord() counts a match whose later part meets a token shorter than it as a match
+bool ScanFilter::RulesOut(std::stringstream &stream, int start, const string &word, const std::vector<string> &wordParts)
+{
+    Attachment *attachment = FindAttachment(stream);
+    if((attachment==NULL)||(start<0))
+        return false;
+
+    if(!attachment->filter->MayContain(wordParts[0]))
+        return true;
+    return (attachment->misses.count(MissKey(start, word))>0);
+}
+
+void ScanFilter::AddMiss(std::stringstream &stream, int start, const string &word)
+{
+    Attachment *attachment = FindAttachment(stream);
+    if((attachment!=NULL)&&(start>=0))
+        attachment->misses.insert(MissKey(start, word));
+}
+
+ScanFilter::Attachment* ScanFilter::FindAttachment(std::stringstream &stream)
+{
+    for(int i=0; i<int(attachments.size()); i++)
+    {
+        if(attachments[i].stream==&stream)
+            return &attachments[i];
+    }
+    return NULL;
+}
+
+string ScanFilter::MissKey(int start, const string &word)
+{
+    std::stringstream key;
+    key << word << '\0' << start;
+    return key.str();
+}
@@ -0,0 +1,110 @@
+#include "ScanWatchdog.hh"
+#include <sstream>
+
+using namespace std;
+
+thread_local ScanWatchdog *ScanWatchdog::active = NULL;
+thread_local long ScanWatchdog::pendingSteps = 0;
+
+// the number of steps a thread takes before adding them to the watchdog and checking the budget
+const long stepBatch = 256;
+
+ScanWatchdog::ScanWatchdog()
+{
+    stepLimit=0;
+    timeLimit=0.;
+    numSteps=0;
+    tripped=false;
+    startTime=std::chrono::steady_clock::now();
+}
+
+ScanWatchdog::~ScanWatchdog()
+{
+    if(active==this)
+        active=NULL;
+}
+
+//Start
+//starts the budget of the geometry from now, a limit of 0 (or less) leaves the steps or the time unlimited
+void ScanWatchdog::Start(long maxSteps, double maxSeconds)
+{
+    stepLimit=maxSteps;
+    timeLimit=maxSeconds;
+    numSteps=0;
+    tripped=false;
+    reason="";
+    startTime=std::chrono::steady_clock::now();
+}
+
+double ScanWatchdog::GetSeconds() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-startTime).count();
+}
+
+//SetActive
+//makes the given watchdog the one that counts the steps of the parser running on this thread, NULL leaves the steps uncounted
+void ScanWatchdog::SetActive(ScanWatchdog *watchdog)
+{
+    if((active!=NULL)&&(pendingSteps>0))
+        active->AddSteps(pendingSteps);
+    pendingSteps=0;
+    active=watchdog;
+}
+
+//Step
+//counts one step of a scanning loop, returns false once the budget of the active watchdog has been spent
+bool ScanWatchdog::Step()
+{
+    if(active==NULL)
+        return true;
+    if(++pendingSteps<stepBatch)
+        return !active->tripped.load(std::memory_order_relaxed);
+
+    long steps=pendingSteps;
+    pendingSteps=0;
+    return active->AddSteps(steps);
+}
+
+//Step
+//counts one step of a loop that reads the stream until it finds a delimiter, returns false if the budget has been spent or if the
+//stream has no text left, which trips the active watchdog since the delimiter is missing
+bool ScanWatchdog::Step(std::istream &stream)
+{
+    if(stream.peek()==std::char_traits<char>::eof())
+    {
+        if(active!=NULL)
+            active->Trip("ran into the end of the text while looking for the end of a statement");
+        return false;
+    }
+    return Step();
+}
+
+bool ScanWatchdog::AddSteps(long steps)
+{
+    long total = (numSteps+=steps);
+    if(tripped)
+        return false;
+
+    if((stepLimit>0)&&(total>stepLimit))
+    {
+        std::stringstream why;
+        why << "used up its budget of " << stepLimit << " scanning steps";
+        Trip(why.str());
+    }
+    else if((timeLimit>0.)&&(GetSeconds()>timeLimit))
+    {
+        std::stringstream why;
+        why << "used up its budget of " << timeLimit << " seconds";
+        Trip(why.str());
+    }
+    return !tripped;
+}
+
+//Trip
+//stops the parsing of the geometry, only the reason of the first trip is kept
+void ScanWatchdog::Trip(const string &why)
+{
+    bool expected=false;
+    if(tripped.compare_exchange_strong(expected, true))
+        reason=why;
+}
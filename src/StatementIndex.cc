@@ -0,0 +1,387 @@
+#include "StatementIndex.hh"
+#include "CompressedInput.hh"
+#include <cctype>
+
+using namespace std;
+
+// the number of characters read from a geometry file at a time
+const int streamChunkSize = 65536;
+
+// the token that starts the material section of the source, see GetGeoIsotopes()
+static const string materialMarker = "::ConstructMaterials()";
+
+// the kinds of text the scanner can be inside of
+enum ScanState {code=0, lineComment, blockComment, stringLiteral, charLiteral};
+
+// removes the comments and the contents of the string literals from a statement so that only its code is tested
+static string CodeOf(const string &text)
+{
+    string result;
+    size_t i=0;
+    while(i<text.length())
+    {
+        if((text[i]=='/')&&(i+1<text.length())&&(text[i+1]=='/'))
+        {
+            i = text.find('\n', i);
+            if(i==std::string::npos)
+                break;
+        }
+        else if((text[i]=='/')&&(i+1<text.length())&&(text[i+1]=='*'))
+        {
+            i = text.find("*/", i+2);
+            if(i==std::string::npos)
+                break;
+            i+=2;
+            result+=' ';
+        }
+        else if((text[i]=='"')||(text[i]=='\''))
+        {
+            char quote=text[i];
+            result+=quote;
+            for(i++; (i<text.length())&&(text[i]!=quote); i++)
+            {
+                if(text[i]=='\\')
+                    i++;
+            }
+            result+=quote;
+            i++;
+        }
+        else
+        {
+            result+=text[i];
+            i++;
+        }
+    }
+    return result;
+}
+
+StatementIndex::StatementIndex()
+{
+    Clear();
+}
+
+StatementIndex::~StatementIndex()
+{
+    //dtor
+}
+
+void StatementIndex::Clear()
+{
+    materialText.clear();
+    lineMarks.clear();
+    materialLines=0;
+    symbolHeader.clear();
+    symbolSource.clear();
+    statement.clear();
+    token.clear();
+    inMaterials=false;
+    exactMarker=false;
+    materialsEnded=false;
+    braceDepth=0;
+    keepTail=false;
+    line=1;
+    statementLine=1;
+    bytesScanned=0;
+    longestStatement=0;
+}
+
+//ScanFile
+//reads the given file into the index a chunk at a time, decompressing it if needed, returns false if the file can't be opened
+bool StatementIndex::ScanFile(string fileName, bool isSource)
+{
+    CompressedInput file(fileName);
+    if(!file.IsOpen())
+        return false;
+    Scan(file, isSource);
+    return true;
+}
+
+//Scan
+//splits the text read from the stream into statements and keeps the ones that the material search needs
+//the header of a geometry must be scanned before its source so that the symbols are searched in the same order as in GetGeoIsotopes()
+void StatementIndex::Scan(std::istream &in, bool isSource)
+{
+    char buffer[streamChunkSize];
+    int state=code;
+    char prev='\0';
+
+    statement.clear();
+    token.clear();
+    line=1;
+
+    while(in.good())
+    {
+        in.read(buffer, streamChunkSize);
+        long numRead = in.gcount();
+        bytesScanned+=numRead;
+
+        for(long i=0; i<numRead; i++)
+        {
+            char letter = buffer[i];
+            if(statement.empty())
+                statementLine=line;
+            statement+=letter;
+            if(letter=='\n')
+                line++;
+
+            switch(state)
+            {
+                case lineComment:
+                    if(letter=='\n')
+                        state=code;
+                    break;
+                case blockComment:
+                    if((prev=='*')&&(letter=='/'))
+                    {
+                        state=code;
+                        letter='\0';
+                    }
+                    break;
+                case stringLiteral:
+                case charLiteral:
+                    token+=letter;
+                    if(prev=='\\')
+                    {
+                        // the escaped character can't close the literal or escape the one after it
+                        letter='\0';
+                    }
+                    else if(letter==((state==stringLiteral) ? '"' : '\''))
+                    {
+                        state=code;
+                    }
+                    break;
+                default:
+                    if((prev=='/')&&((letter=='/')||(letter=='*')))
+                    {
+                        // the '/' that started the comment is not part of the token
+                        token.erase(token.length()-1);
+                        EndToken(isSource);
+                        state = (letter=='/') ? lineComment : blockComment;
+                        letter='\0';
+                    }
+                    else if(isspace((unsigned char)letter))
+                    {
+                        EndToken(isSource);
+                    }
+                    else
+                    {
+                        token+=letter;
+                        if(letter=='"')
+                            state=stringLiteral;
+                        else if(letter=='\'')
+                            state=charLiteral;
+                        else if(letter==';')
+                            EndStatement(isSource);
+                        else if(isSource&&inMaterials&&!materialsEnded)
+                            CountBrace(letter, isSource);
+                    }
+                    break;
+            }
+            prev=letter;
+        }
+    }
+
+    EndToken(isSource);
+    EndStatement(isSource);
+    statement.clear();
+    token.clear();
+}
+
+//EndToken
+//checks if the whitespace delimited token that was just read is the start of the material section
+//like MovePastWord() an exact match is used over a token that only starts or ends with the marker no matter which comes first
+void StatementIndex::EndToken(bool isSource)
+{
+    if(isSource&&!exactMarker&&(token.length()>=materialMarker.length()))
+    {
+        bool exact = (token==materialMarker);
+        bool fuzzy = (token.compare(0, materialMarker.length(), materialMarker)==0)||
+                        (token.compare(token.length()-materialMarker.length(), materialMarker.length(), materialMarker)==0);
+
+        if(exact||(fuzzy&&!inMaterials))
+        {
+            // the part of the statement in front of the marker is filed on its own and the material section restarts after it
+            EndStatement(isSource);
+            materialText.clear();
+            lineMarks.clear();
+            materialLines=0;
+            keepTail=false;
+            inMaterials=true;
+            exactMarker=exact;
+            materialsEnded=false;
+            braceDepth=0;
+
+            // MovePastWord() leaves the stream right after the marker, so the braces that follow it in the token are counted
+            if(!exact&&(token.compare(0, materialMarker.length(), materialMarker)==0))
+            {
+                char quote='\0';
+                for(size_t i=materialMarker.length(); (i<token.length())&&!materialsEnded; i++)
+                {
+                    if(quote!='\0')
+                    {
+                        if(token[i]=='\\')
+                            i++;
+                        else if(token[i]==quote)
+                            quote='\0';
+                    }
+                    else if((token[i]=='"')||(token[i]=='\''))
+                    {
+                        quote=token[i];
+                    }
+                    else
+                    {
+                        CountBrace(token[i], isSource);
+                    }
+                }
+            }
+        }
+    }
+    token.clear();
+}
+
+//CountBrace
+//follows the braces of the material section, the section ends with the '}' that closes the first block opened after the marker
+//like the cropping in CropMaterialSection(), the statement up to that brace is filed and nothing after it is added to the material index
+void StatementIndex::CountBrace(char letter, bool isSource)
+{
+    if(letter=='{')
+    {
+        braceDepth++;
+    }
+    else if((letter=='}')&&(braceDepth>0))
+    {
+        braceDepth--;
+        if(braceDepth==0)
+        {
+            EndStatement(isSource);
+            keepTail=false;
+            materialsEnded=true;
+        }
+    }
+}
+
+//EndStatement
+//files the statement that was just read into the material and symbol indexes it belongs in and drops it otherwise
+//until the material section is found every source statement is indexed as a material statement, if the section is never
+//found the whole source is searched just like it is when MovePastWord() fails to find it
+void StatementIndex::EndStatement(bool isSource)
+{
+    if(statement.empty())
+        return;
+
+    if(long(statement.length())>longestStatement)
+        longestStatement=long(statement.length());
+
+    string codeText = CodeOf(statement);
+    bool assignment = IsAssignment(codeText)&&!CreatesOtherObject(codeText);
+    bool material = UsesMaterial(codeText);
+
+    // only the symbols are taken from the statements after the end of the material section
+    bool inSection = isSource&&!materialsEnded;
+
+    if(inSection&&(material||assignment||keepTail))
+    {
+        LineMark mark = {materialLines+1, statementLine};
+        lineMarks.push_back(mark);
+        for(size_t i=0; i<statement.length(); i++)
+        {
+            if(statement[i]=='\n')
+                materialLines++;
+        }
+    }
+
+    if(inSection&&(material||assignment))
+    {
+        materialText+=statement;
+        keepTail=true;
+        tailComma=false;
+        tailAssign=false;
+    }
+    else if(inSection&&keepTail)
+    {
+        // ExtractString() can read past the end of a statement, the mass of a natural element is read up to the next ','
+        // and a material map entry up to the next '=' and then the next ';', so the dropped statements that such a read
+        // could reach are kept to give the same result
+        materialText+=statement;
+        tailComma = tailComma||(statement.find(',')!=std::string::npos);
+        tailAssign = tailAssign||(statement.find('=')!=std::string::npos);
+        keepTail = !(tailComma&&tailAssign);
+    }
+
+    // findDouble() only ever looks for the value assigned to a temperature variable
+    if(assignment&&!material)
+    {
+        if(isSource)
+            symbolSource+=statement;
+        else
+            symbolHeader+=statement;
+    }
+    statement.clear();
+}
+
+//GetMaterialStream
+//replaces the contents of the stream with the material statements, this takes the place of the cropped source stream
+void StatementIndex::GetMaterialStream(std::stringstream &stream)
+{
+    stream.str(materialText+'\n');
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+}
+
+//GetSymbolStream
+//replaces the contents of the stream with the assignments from the header followed by the ones from the source
+void StatementIndex::GetSymbolStream(std::stringstream &stream)
+{
+    stream.str(symbolHeader+symbolSource+'\n');
+    stream.clear();
+    stream.seekg(0, std::ios::beg);
+}
+
+//IsAssignment
+//checks if the code contains a plain '=' that is not part of a comparison or a compound assignment
+bool StatementIndex::IsAssignment(const string &text)
+{
+    size_t pos = text.find('=');
+    while(pos!=std::string::npos)
+    {
+        char before = (pos>0) ? text[pos-1] : ' ';
+        char after = (pos+1<text.length()) ? text[pos+1] : ' ';
+        if((after!='=')&&(string("=!<>+-*/%&|^").find(before)==std::string::npos))
+            return true;
+        pos = text.find('=', (after=='=') ? pos+2 : pos+1);
+    }
+    return false;
+}
+
+//CreatesOtherObject
+//checks if the code creates an object that is not a material, element or isotope such as a volume or a visualization attribute
+bool StatementIndex::CreatesOtherObject(const string &text)
+{
+    size_t pos = text.find("new");
+    while(pos!=std::string::npos)
+    {
+        size_t end = pos+3;
+        bool isWord = ((pos==0)||!(isalnum((unsigned char)text[pos-1])||(text[pos-1]=='_')))&&(end<text.length())&&isspace((unsigned char)text[end]);
+        if(isWord)
+        {
+            while((end<text.length())&&isspace((unsigned char)text[end]))
+                end++;
+            size_t start=end;
+            while((end<text.length())&&(isalnum((unsigned char)text[end])||(text[end]=='_')))
+                end++;
+            string type = text.substr(start, end-start);
+            if((type!="G4Material")&&(type!="G4Element")&&(type!="G4Isotope"))
+                return true;
+        }
+        pos = text.find("new", pos+3);
+    }
+    return false;
+}
+
+//UsesMaterial
+//checks if the code builds, fills or stores a material, element or isotope
+bool StatementIndex::UsesMaterial(const string &text)
+{
+    return (text.find("matMap[")!=std::string::npos)||(text.find("->Add")!=std::string::npos)||(text.find("G4Material")!=std::string::npos)||
+            (text.find("G4Element")!=std::string::npos)||(text.find("G4Isotope")!=std::string::npos)||(text.find("FindOrBuild")!=std::string::npos);
+}
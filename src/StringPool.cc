@@ -0,0 +1,66 @@
+#include "StringPool.hh"
+
+std::deque<string>* StringPool::names=NULL;
+std::unordered_map<string, NameHandle>* StringPool::handles=NULL;
+std::mutex StringPool::poolMutex;
+
+using namespace std;
+
+StringPool::StringPool()
+{
+    //ctor
+}
+
+StringPool::~StringPool()
+{
+    //dtor
+}
+
+void StringPool::ClearStore()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    delete names;
+    delete handles;
+    names=NULL;
+    handles=NULL;
+}
+
+//Intern
+//returns the handle of the given name adding it to the pool the first time it is seen
+NameHandle StringPool::Intern(const string &name)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if(names==NULL)
+    {
+        names = new std::deque<string>;
+        handles = new std::unordered_map<string, NameHandle>;
+        names->push_back("");
+        (*handles)[""]=0;
+    }
+
+    std::unordered_map<string, NameHandle>::iterator it = handles->find(name);
+    if(it!=handles->end())
+        return it->second;
+
+    NameHandle handle = NameHandle(names->size());
+    names->push_back(name);
+    (*handles)[name]=handle;
+    return handle;
+}
+
+//GetName
+//the deque never moves its elements so the returned reference stays valid until the store is cleared
+const string& StringPool::GetName(NameHandle handle)
+{
+    static const string empty="";
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if((names==NULL)||(handle>=names->size()))
+        return empty;
+    return (*names)[handle];
+}
+
+int StringPool::GetSize()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return (names==NULL) ? 0 : int(names->size());
+}
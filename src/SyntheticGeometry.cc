@@ -0,0 +1,258 @@
+#include "SyntheticGeometry.hh"
+#include <fstream>
+#include <iomanip>
+
+using namespace std;
+
+// the nuclides that the generated elements are built from, grouped by element
+struct SynthNuclide
+{
+    int Z, A;
+    double mass;
+    const char *symbol;
+};
+
+static const SynthNuclide synthNuclides[] =
+{
+    {1, 1, 1.00782503, "H"}, {1, 2, 2.01410178, "H"},
+    {5, 10, 10.0129370, "B"}, {5, 11, 11.0093054, "B"},
+    {6, 12, 12.0000000, "C"}, {6, 13, 13.0033548, "C"},
+    {7, 14, 14.0030740, "N"}, {7, 15, 15.0001089, "N"},
+    {8, 16, 15.9949146, "O"}, {8, 17, 16.9991317, "O"}, {8, 18, 17.9991596, "O"},
+    {13, 27, 26.9815385, "Al"},
+    {26, 54, 53.9396090, "Fe"}, {26, 56, 55.9349363, "Fe"}, {26, 57, 56.9353928, "Fe"}, {26, 58, 57.9332744, "Fe"},
+    {40, 90, 89.9046977, "Zr"}, {40, 91, 90.9056396, "Zr"}, {40, 92, 91.9050347, "Zr"}, {40, 94, 93.9063108, "Zr"}, {40, 96, 95.9082714, "Zr"},
+    {64, 155, 154.922629, "Gd"}, {64, 157, 156.923967, "Gd"},
+    {92, 234, 234.040952, "U"}, {92, 235, 235.043930, "U"}, {92, 238, 238.050788, "U"},
+    {94, 239, 239.052163, "Pu"}, {94, 240, 240.053814, "Pu"}, {94, 241, 241.056852, "Pu"}
+};
+
+static const int numSynthNuclides = int(sizeof(synthNuclides)/sizeof(SynthNuclide));
+
+SyntheticGeometry::SyntheticGeometry(unsigned int seed)
+{
+    rng.seed(seed);
+    width=4;
+}
+
+SyntheticGeometry::~SyntheticGeometry()
+{
+    //dtor
+}
+
+void SyntheticGeometry::SetSeed(unsigned int seed)
+{
+    rng.seed(seed);
+}
+
+int SyntheticGeometry::RandInt(int low, int high)
+{
+    std::uniform_int_distribution<int> dist(low, high);
+    return dist(rng);
+}
+
+double SyntheticGeometry::RandDouble(double low, double high)
+{
+    std::uniform_real_distribution<double> dist(low, high);
+    return dist(rng);
+}
+
+//Label
+//creates a fixed width identifier so that no generated name is the prefix or suffix of another one
+string SyntheticGeometry::Label(string prefix, int index)
+{
+    std::stringstream label;
+    label << prefix << std::setw(width) << std::setfill('0') << index;
+    return label.str();
+}
+
+//Generate
+//fills the source and header streams with a G4Stork geometry constructor that defines and stores numMaterials materials in its material map
+void SyntheticGeometry::Generate(string className, int numMaterials, std::stringstream &source, std::stringstream &header)
+{
+    if(numMaterials<1)
+        numMaterials=1;
+
+    int numElements = numMaterials/3+2, numTemps = numMaterials/4+1, numIsotopes=0;
+    std::vector<int> groupStart;
+    std::stringstream digits;
+
+    digits << (numMaterials+6*numElements+numTemps);
+    width = (int(digits.str().length())>4) ? int(digits.str().length()) : 4;
+
+    // finds the start of each element group in the nuclide table
+    for(int i=0; i<numSynthNuclides; i++)
+    {
+        if((i==0)||(synthNuclides[i].Z!=synthNuclides[i-1].Z))
+            groupStart.push_back(i);
+    }
+    groupStart.push_back(numSynthNuclides);
+
+    header.str("");
+    header.clear();
+    source.str("");
+    source.clear();
+    source << std::fixed;
+
+    header << "#ifndef " << className << "_H\n" << "#define " << className << "_H\n\n" << "#include \"StorkVWorldConstructor.hh\"\n\n"
+           << "class " << className << " : public StorkVWorldConstructor\n{\n" << "    public:\n"
+           << "        " << className << "();\n" << "        virtual ~" << className << "();\n\n" << "    protected:\n"
+           << "        virtual G4VPhysicalVolume* ConstructWorld();\n" << "        virtual void ConstructMaterials();\n"
+           << "        void ConstructVisAttributes();\n\n";
+    for(int i=0; i<numTemps; i++)
+    {
+        header << "        G4double " << Label("Temp", i) << ";\n";
+    }
+    header << "};\n\n#endif\n";
+
+    // the constructor sets the temperature variables, some of them refer to each other or are given in celsius
+    source << "#include \"" << className << ".hh\"\n\n" << className << "::" << className << "()\n: StorkVWorldConstructor()\n{\n";
+    for(int i=0; i<numTemps; i++)
+    {
+        int form = RandInt(0, 9);
+        source << "    " << Label("Temp", i) << " = ";
+        if((form<2)&&(i>0))
+            source << Label("Temp", RandInt(0, i-1)) << ";\n";
+        else if(form<4)
+            source << std::setprecision(1) << RandDouble(0., 400.) << "*celsius;\n";
+        else
+            source << std::setprecision(2) << RandDouble(250., 1500.) << ";\n";
+    }
+    source << "}\n\n" << className << "::~" << className << "()\n{\n}\n\n";
+
+    source << "G4VPhysicalVolume* " << className << "::ConstructWorld()\n{\n"
+           << "    G4Box *worldBox = new G4Box(\"worldBox\", 1.*m, 1.*m, 1.*m);\n"
+           << "    worldLogical = new G4LogicalVolume(worldBox, matMap[\"" << Label("Mat", 0) << "\"], \"worldLogical\");\n"
+           << "    worldPhysical = new G4PVPlacement(0, G4ThreeVector(0., 0., 0.), worldLogical, \"worldPhysical\", 0, false, 0);\n\n"
+           << "    return worldPhysical;\n}\n\n";
+
+    source << "void " << className << "::ConstructMaterials()\n{\n" << "    // Elements, isotopes and materials\n";
+
+    // each element is built either from its own isotopes or from its natural Z and A
+    for(int i=0; i<numElements; i++)
+    {
+        int group = RandInt(0, int(groupStart.size())-2);
+        int first = groupStart[group], last = groupStart[group+1];
+        string elemName = Label("Elem", i);
+        const SynthNuclide &lead = synthNuclides[first];
+
+        if(RandInt(0, 4)==0)
+        {
+            source << std::setprecision(4) << "    " << elemName << " = new G4Element(\"" << elemName << "\", \"" << lead.symbol << "\", "
+                   << lead.Z << ".0, " << RandDouble(lead.mass, synthNuclides[last-1].mass) << "*g/mole);\n\n";
+            continue;
+        }
+
+        std::vector<int> picked;
+        for(int j=first; j<last; j++)
+        {
+            if(RandInt(0, 2)!=0)
+                picked.push_back(j);
+        }
+        if(picked.empty())
+            picked.push_back(RandInt(first, last-1));
+
+        int firstIsotope = numIsotopes;
+        for(int j=0; j<int(picked.size()); j++)
+        {
+            const SynthNuclide &nuc = synthNuclides[picked[j]];
+            string isoName = Label("Iso", numIsotopes++);
+            source << std::setprecision(7) << "    " << isoName << " = new G4Isotope(\"" << isoName << "\", "
+                   << nuc.Z << ", " << nuc.A << ", " << nuc.mass << "*g/mole);\n";
+        }
+        source << "    /* " << lead.symbol << " with " << picked.size() << " isotopes */\n";
+        source << "    " << elemName << " = new G4Element(\"" << elemName << "\", \"" << lead.symbol << "\", " << picked.size() << ");\n";
+
+        double remaining = 100.;
+        for(int j=0; j<int(picked.size()); j++)
+        {
+            double abundance = (j==int(picked.size())-1) ? remaining : RandDouble(0., remaining);
+            remaining -= abundance;
+            source << std::setprecision(3) << "    " << elemName << "->AddIsotope(" << Label("Iso", firstIsotope+j) << ", " << abundance << "*perCent);\n";
+        }
+        source << "\n";
+    }
+
+    // materials are compounds of elements, single element materials or mixtures of the materials defined before them
+    std::vector<bool> inMap(numMaterials, false);
+    for(int i=0; i<numMaterials; i++)
+    {
+        string matName = Label("Mat", i), tempArg;
+        int kind = RandInt(0, 19), tempForm = RandInt(0, 9);
+
+        std::stringstream temp;
+        temp << std::fixed;
+        if(tempForm<4)
+            temp << ", " << Label("Temp", RandInt(0, numTemps-1));
+        else if(tempForm<7)
+            temp << std::setprecision(1) << ", " << RandDouble(250., 1500.) << "*kelvin";
+        else if(tempForm<8)
+            temp << std::setprecision(1) << ", " << RandDouble(0., 400.) << "*celsius";
+        else if(tempForm<9)
+            temp << std::setprecision(1) << ", " << RandDouble(250., 1500.);
+        tempArg = temp.str();
+
+        if(kind<3)
+        {
+            const SynthNuclide &nuc = synthNuclides[RandInt(0, numSynthNuclides-1)];
+            source << std::setprecision(2) << "    " << matName << " = new G4Material(\"" << matName << "\", " << nuc.Z << ".0, "
+                   << nuc.mass << "*g/mole, " << RandDouble(0.5, 20.) << "*g/cm3, kStateSolid" << tempArg << ");\n";
+        }
+        else
+        {
+            int numComp = RandInt(1, 4);
+            bool mixture = (i>1)&&(kind>14);
+
+            source << std::setprecision(3) << "    " << matName << " = new G4Material(\"" << matName << "\", " << RandDouble(0.001, 20.)
+                   << "*g/cm3, " << numComp;
+            if(tempArg!="")
+                source << ", kStateSolid" << tempArg;
+            source << ");\n";
+
+            for(int j=0; j<numComp; j++)
+            {
+                if(mixture&&(RandInt(0, 1)==0))
+                    source << "    " << matName << "->AddMaterial(" << Label("Mat", RandInt(0, i-1)) << ", " << std::setprecision(3) << 1./numComp << ");\n";
+                else
+                    source << "    " << matName << "->AddElement(" << Label("Elem", RandInt(0, numElements-1)) << ", " << RandInt(1, 4) << ");\n";
+            }
+        }
+        source << "\n";
+
+        inMap[i] = (RandInt(0, 9)!=0)||(i==0);
+    }
+
+    for(int i=0; i<numMaterials; i++)
+    {
+        if(inMap[i])
+            source << "    matMap[\"" << Label("Mat", i) << "\"] = " << Label("Mat", i) << ";\n";
+    }
+    source << "\n    matChanged = false;\n\n    return;\n}\n\n";
+
+    // code that follows the material definitions in most geometries
+    source << "void " << className << "::ConstructVisAttributes()\n{\n";
+    for(int i=0; i<numMaterials; i+=8)
+    {
+        source << std::setprecision(2) << "    G4VisAttributes *visAtt" << i << " = new G4VisAttributes(G4Colour(" << RandDouble(0., 1.) << ", "
+               << RandDouble(0., 1.) << ", " << RandDouble(0., 1.) << "));\n" << "    visAtt" << i << "->SetVisibility(true);\n";
+    }
+    source << "}\n";
+}
+
+//WriteFiles
+//generates a geometry and stores it into the source and header file dirName/className.cc and dirName/className.hh
+bool SyntheticGeometry::WriteFiles(string dirName, string className, int numMaterials)
+{
+    std::stringstream source, header;
+    Generate(className, numMaterials, source, header);
+
+    if((dirName!="")&&(dirName[dirName.length()-1]!='/'))
+        dirName+='/';
+
+    std::ofstream sourceFile((dirName+className+".cc").c_str(), std::ios::out | std::ios::trunc);
+    std::ofstream headerFile((dirName+className+".hh").c_str(), std::ios::out | std::ios::trunc);
+    sourceFile << source.str();
+    headerFile << header.str();
+
+    return (sourceFile.good()&&headerFile.good());
+}
@@ -0,0 +1,147 @@
+#include "TaskScheduler.hh"
+
+using namespace std;
+
+TaskScheduler::TaskScheduler(int numWorkers)
+{
+    if(numWorkers<1)
+        numWorkers=1;
+
+    nextWorker=0;
+    numPending=0;
+    numSteals=0;
+    generation=0;
+    stopping=false;
+
+    for(int i=0; i<numWorkers; i++)
+    {
+        workers.push_back(new Worker);
+    }
+    for(int i=0; i<numWorkers; i++)
+    {
+        threads.push_back(std::thread(&TaskScheduler::WorkerLoop, this, i));
+    }
+}
+
+//~TaskScheduler
+//finishes every task that has been given to the scheduler and then stops the workers
+TaskScheduler::~TaskScheduler()
+{
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping=true;
+    }
+    taskAdded.notify_all();
+
+    // the other workers may still look into a deque until they have all stopped
+    for(int i=0; i<int(threads.size()); i++)
+    {
+        threads[i].join();
+    }
+    for(int i=0; i<int(workers.size()); i++)
+    {
+        delete workers[i];
+    }
+}
+
+//Submit
+//adds a task from outside of the scheduler, the tasks are dealt out to the workers in turn
+void TaskScheduler::Submit(SchedTask task)
+{
+    Spawn(int(nextWorker++%workers.size()), task);
+}
+
+//Spawn
+//adds a task to the back of the given worker's deque, tasks call this with their own worker index to split up their work
+void TaskScheduler::Spawn(int worker, SchedTask task)
+{
+    numPending++;
+    {
+        std::lock_guard<std::mutex> lock(workers[worker]->dequeMutex);
+        workers[worker]->tasks.push_back(task);
+    }
+    Notify();
+}
+
+//Wait
+//blocks until every task that was submitted or spawned has finished
+void TaskScheduler::Wait()
+{
+    std::unique_lock<std::mutex> lock(idleMutex);
+    allDone.wait(lock, [this]{ return (numPending==0); });
+}
+
+void TaskScheduler::Notify()
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        generation++;
+    }
+    taskAdded.notify_one();
+}
+
+//FindTask
+//takes the newest task of the worker's own deque or, if it has none, steals the oldest task of the first other worker that has one
+bool TaskScheduler::FindTask(int worker, SchedTask &task)
+{
+    int numWorkers = int(workers.size());
+
+    {
+        Worker &own = *workers[worker];
+        std::lock_guard<std::mutex> lock(own.dequeMutex);
+        if(!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for(int i=1; i<numWorkers; i++)
+    {
+        Worker &victim = *workers[(worker+i)%numWorkers];
+        std::lock_guard<std::mutex> lock(victim.dequeMutex);
+        if(!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            numSteals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::WorkerLoop(int worker)
+{
+    SchedTask task;
+    unsigned long seen;
+
+    while(true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            if(stopping)
+                return;
+            seen=generation;
+        }
+
+        if(FindTask(worker, task))
+        {
+            task(worker);
+            task = SchedTask();
+
+            if(--numPending==0)
+            {
+                std::lock_guard<std::mutex> lock(idleMutex);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        // sleeps unless a task was added after the deques were checked
+        std::unique_lock<std::mutex> lock(idleMutex);
+        taskAdded.wait(lock, [this, seen]{ return (stopping||(generation!=seen)); });
+    }
+}